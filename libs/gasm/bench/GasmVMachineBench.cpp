@@ -0,0 +1,321 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        GasmVMachineBench.cpp
+// Project:     sgpLib
+// Purpose:     Benchmark of vmachine execution engines.
+// Author:
+// Modified by:
+// Created:     17/10/2026
+/////////////////////////////////////////////////////////////////////////////
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file GasmVMachineBench.cpp
+///
+/// Standalone program which runs the same programs on the same inputs
+/// using different execution engines of vmachine and reports instructions/sec.
+/// Outputs of all engines are compared with output of the first engine.
+/// Returns non-zero exit code if outputs are different.
+///
+/// Benchmarks:
+/// - run() with and without ggfThreadedRun
+/// - regression workload: run() vs runNumeric() with features of fitness function
+
+// ----------------------------------------------------------------------------
+// Headers
+// ----------------------------------------------------------------------------
+//std
+#include <iostream>
+#include <cmath>
+#include <vector>
+
+//sc
+#include "sc/defs.h"
+#include "sc/utils.h"
+
+//sgp
+#include "sgp/GasmVMachine.h"
+#include "sgp/GasmFunLib.h"
+#include "sgp/GasmFunLibCore.h"
+#include "sgp/GasmAssembler.h"
+
+using namespace dtp;
+
+// ----------------------------------------------------------------------------
+// Simple type definitions
+// ----------------------------------------------------------------------------
+struct sgpBenchEngine {
+  const char *name;
+  uint features;  ///<-- features added to vmachine defaults
+  bool numeric;   ///<-- use runNumeric instead of run
+};
+
+// ----------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------
+// the same sample count as in regression fitness function
+const uint BENCH_SAMPLE_COUNT = 200;
+const uint BENCH_REPEAT_COUNT = 200;
+const uint BENCH_INSTR_LIMIT = 10000;
+
+// features used by fitness function for numeric programs (code optimization is off by default)
+const uint BENCH_FITNESS_FEATURES = ggfTypedRegsEnabled | ggfThreadedRun | ggfNativeRun;
+
+const sgpBenchEngine BENCH_ENGINES_THREADED[] = {
+  {"run", 0, false},
+  {"threaded", ggfThreadedRun, false}
+};
+const uint BENCH_ENGINES_THREADED_COUNT = 2;
+
+// runNumeric falls back to run() if block cannot be executed natively
+const sgpBenchEngine BENCH_ENGINES_NUMERIC[] = {
+  {"run", BENCH_FITNESS_FEATURES, false},
+  {"numeric", BENCH_FITNESS_FEATURES | ggfNumericProfile, true}
+};
+const uint BENCH_ENGINES_NUMERIC_COUNT = 2;
+
+// loop with control flow on each iteration
+const char *BENCH_PRG_LOOP[] = {
+  ".block",
+  ".input double",
+  ".output double",
+  "  move #52, #1",
+  "  move #53, 0.0D",
+  "  move #34, 50I",
+  ":loop add.double #53, #53, #52",
+  "  mult.double #54, #52, 0.5D",
+  "  sub.double #52, #52, #54",
+  "  add.double #52, #52, 1.0D",
+  "  repnz.back #34, @loop",
+  "  move #0, #53",
+  ".end",
+  SC_NULL
+};
+
+// straight-line arithmetic
+const char *BENCH_PRG_SEQ[] = {
+  ".block",
+  ".input double",
+  ".output double",
+  "  mult.double #52, #1, #1",
+  "  mult.double #53, #52, #1",
+  "  mult.double #54, #53, 0.25D",
+  "  add.double #54, #54, #52",
+  "  sub.double #54, #54, #1",
+  "  mult.double #53, #54, #54",
+  "  div.double #52, #53, 3.0D",
+  "  add.double #52, #52, #54",
+  "  neg.double #53, #52",
+  "  abs.double #54, #53",
+  "  add.double #54, #54, 0.5D",
+  "  mult.double #52, #54, #1",
+  "  sub.double #52, #52, #53",
+  "  move #0, #52",
+  ".end",
+  SC_NULL
+};
+
+// regression, single input: f(x) = g + g / (|g| + 1), g = x^3 / 4 + x^2 - x
+const char *BENCH_PRG_REGR1[] = {
+  ".block",
+  ".input float",
+  ".output float",
+  "  mult.float #49, #1, #1",
+  "  mult.float #50, #49, #1",
+  "  mult.float #50, #50, 0.25F",
+  "  add.float #50, #50, #49",
+  "  sub.float #50, #50, #1",
+  "  abs.float #51, #50",
+  "  add.float #51, #51, 1.0F",
+  "  div.float #51, #50, #51",
+  "  add.float #50, #50, #51",
+  "  move #0, #50",
+  ".end",
+  SC_NULL
+};
+
+// regression, two inputs: f(x1, x2) = x1 * x2 + x1^2 / 2
+const char *BENCH_PRG_REGR2[] = {
+  ".block",
+  ".input float, float",
+  ".output float",
+  "  mult.float #49, #1, #2",
+  "  mult.float #50, #1, #1",
+  "  div.float #50, #50, 2.0F",
+  "  add.float #49, #49, #50",
+  "  sub.float #51, #2, #1",
+  "  mult.float #51, #51, 0.5F",
+  "  sub.float #51, #51, #51",
+  "  add.float #49, #49, #51",
+  "  move #0, #49",
+  ".end",
+  SC_NULL
+};
+
+// ----------------------------------------------------------------------------
+// Helper functions
+// ----------------------------------------------------------------------------
+void benchAssemble(const char *lines[], const sgpFunctionMapColn &functions, scDataNode &code)
+{
+  scStringList textLines;
+  sgpAssembler assembler;
+
+  for(uint i = 0; lines[i] != SC_NULL; i++)
+    textLines.push_back(lines[i]);
+
+  assembler.setFunctionList(functions);
+  if (!assembler.parseText(textLines, code))
+    throw scError("Benchmark program cannot be assembled");
+}
+
+void benchInitVMachine(sgpVMachine &vmachine, const sgpFunctionMapColn &functions, uint extraFeatures)
+{
+  vmachine.setFunctionList(functions);
+  // the same configuration as in fitness function: no refs, no error log
+  if ((vmachine.getSupportedArgTypes() & gatfRef) != 0)
+    vmachine.setSupportedArgTypes(vmachine.getSupportedArgTypes() ^ gatfRef);
+  if ((vmachine.getFeatures() & ggfLogErrors) != 0)
+    vmachine.setFeatures(vmachine.getFeatures() ^ ggfLogErrors);
+  vmachine.setFeatures(vmachine.getFeatures() | extraFeatures);
+}
+
+// input rows: <inputCount> values for each sample, in range [-10, 10)
+void benchPrepareInputs(uint inputCount, std::vector<double> &inputs)
+{
+  inputs.resize(BENCH_SAMPLE_COUNT * inputCount);
+  for(uint i = 0; i != BENCH_SAMPLE_COUNT; i++)
+    for(uint j = 0; j != inputCount; j++)
+      inputs[i * inputCount + j] =
+        -10.0 + 20.0 * double((i * (j + 1)) % BENCH_SAMPLE_COUNT) / double(BENCH_SAMPLE_COUNT);
+}
+
+// returns output value for each sample, instruction count & time of all runs
+void benchRun(sgpVMachine &vmachine, bool numeric, const std::vector<double> &inputs, uint inputCount,
+  uint inputDataType, std::vector<double> &outputs, ulong64 &instrCount, ulong64 &timeMs)
+{
+  scDataNode input, element, output;
+  uint sampleCount = inputs.size() / inputCount;
+
+  outputs.resize(sampleCount);
+  instrCount = 0;
+
+  ulong64 startTime = cpu_time_ms();
+
+  for(uint r = 0; r != BENCH_REPEAT_COUNT; r++)
+    for(uint i = 0; i != sampleCount; i++) {
+      if (numeric) {
+        vmachine.runNumeric(&inputs[i * inputCount], inputCount, inputDataType, 0, output, BENCH_INSTR_LIMIT);
+      } else {
+        // the same input preparation as in fallback of runNumeric
+        input.clear();
+        for(uint j = 0; j != inputCount; j++) {
+          sgpBatchLanes::buildValue(sgpBatchLanes::castValue(inputs[i * inputCount + j], inputDataType),
+            inputDataType, element);
+          input.addChild(new scDataNode(element));
+        }
+        vmachine.resetWarmWay();
+        vmachine.setInput(input);
+        vmachine.run(BENCH_INSTR_LIMIT);
+        if (r == 0)
+          output = vmachine.getOutput();
+      }
+      instrCount += vmachine.getInstrCount();
+      if (r == 0)
+        outputs[i] = output.getAsDouble();
+    }
+
+  timeMs = cpu_time_ms() - startTime;
+}
+
+void benchReport(const scString &prgName, const scString &engineName, ulong64 instrCount, ulong64 timeMs,
+  ulong64 baseTimeMs)
+{
+  double instrPerSec = (timeMs > 0) ? (1000.0 * double(instrCount) / double(timeMs)) : 0.0;
+  double speedUp = (timeMs > 0) ? (double(baseTimeMs) / double(timeMs)) : 0.0;
+
+  std::cout << prgName << "\t" << engineName << "\t"
+    << instrCount << " instr\t" << timeMs << " ms\t"
+    << instrPerSec << " instr/s\tx" << speedUp << std::endl;
+}
+
+bool benchSameOutputs(const std::vector<double> &expected, const std::vector<double> &actual)
+{
+  for(uint i = 0, epos = expected.size(); i != epos; i++)
+    if ((expected[i] != actual[i]) && !(isnan(expected[i]) && isnan(actual[i])))
+      return false;
+  return true;
+}
+
+// run program with each of given engines, first engine is a base for comparison
+bool benchProgram(const scString &prgName, const char *lines[], uint inputCount, uint inputDataType,
+  const sgpBenchEngine engines[], uint engineCount, const sgpFunctionMapColn &functions)
+{
+  bool res = true;
+  scDataNode code;
+  std::vector<double> inputs, baseOutputs, outputs;
+  ulong64 instrCount, timeMs, baseTimeMs = 0;
+
+  benchAssemble(lines, functions, code);
+  benchPrepareInputs(inputCount, inputs);
+
+  for(uint i = 0; i != engineCount; i++) {
+    sgpVMachine vmachine;
+    benchInitVMachine(vmachine, functions, engines[i].features);
+    vmachine.setCompiledProgram(vmachine.compileProgram(code));
+
+    benchRun(vmachine, engines[i].numeric, inputs, inputCount, inputDataType, outputs, instrCount, timeMs);
+
+    if (i == 0) {
+      baseOutputs = outputs;
+      baseTimeMs = timeMs;
+    } else if (!benchSameOutputs(baseOutputs, outputs)) {
+      std::cout << prgName << "\t" << engines[i].name << "\toutput differs from " << engines[0].name << std::endl;
+      res = false;
+    }
+
+    benchReport(prgName, engines[i].name, instrCount, timeMs, baseTimeMs);
+  }
+
+  return res;
+}
+
+// ----------------------------------------------------------------------------
+// Main
+// ----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  bool res = true;
+  sgpFunLib mainLib;
+  sgpFunctionMapColn functions;
+
+  try {
+    mainLib.addLib(new sgpFunLibCore());
+    sgpFunLib::prepareFuncList(scStringList(), scStringList(), functions);
+
+    // threaded engine vs run()
+    if (!benchProgram("loop", BENCH_PRG_LOOP, 1, gdtfDouble,
+          BENCH_ENGINES_THREADED, BENCH_ENGINES_THREADED_COUNT, functions))
+      res = false;
+    if (!benchProgram("seq", BENCH_PRG_SEQ, 1, gdtfDouble,
+          BENCH_ENGINES_THREADED, BENCH_ENGINES_THREADED_COUNT, functions))
+      res = false;
+
+    // regression workload: runNumeric vs run()
+    if (!benchProgram("regr-1", BENCH_PRG_REGR1, 1, gdtfFloat,
+          BENCH_ENGINES_NUMERIC, BENCH_ENGINES_NUMERIC_COUNT, functions))
+      res = false;
+    if (!benchProgram("regr-2", BENCH_PRG_REGR2, 2, gdtfFloat,
+          BENCH_ENGINES_NUMERIC, BENCH_ENGINES_NUMERIC_COUNT, functions))
+      res = false;
+  }
+  catch(scError &excp) {
+    std::cout << "Exception (scError): " << excp.what() << ", details: " << excp.getDetails() << std::endl;
+    res = false;
+  }
+  catch(const std::exception& e) {
+    std::cout << "Exception (std): " << e.what() << std::endl;
+    res = false;
+  }
+
+  return res ? 0 : 1;
+}
@@ -123,18 +123,15 @@
 // stl
 #include <map>
 #include <set>
+#include <vector>
 #include <iostream>
 
-// TR1
-//#include <unordered_set>
-
 // boost
 #include "boost/intrusive_ptr.hpp"
+#include "boost/shared_ptr.hpp"
 #include "boost/ptr_container/ptr_map.hpp"
-#include "boost/unordered_set.hpp"
+#include "boost/ptr_container/ptr_vector.hpp"
 
-// other
-#include "LRUCache.h"
 // sc
 #include "sc/dtypes.h"
 
@@ -161,7 +158,13 @@ enum sgpGvmFeatures {
   ggfNotesEnabled = 256, ///<-- world-scope values
   ggfTraceEnabled = 512, ///<-- world-scope values
   ggfLogErrors = 1024,
-  ggfRecurrenceEnabled = 2048
+  ggfRecurrenceEnabled = 2048,
+  ggfTypedRegsEnabled = 4096, ///<-- keep typed accumulators unboxed (used only if refs are disabled)
+  ggfThreadedRun = 8192, ///<-- threaded engine, block end checked on control flow changes only
+  ggfNativeRun = 16384, ///<-- run statically typed blocks as compiled chain of native functions
+  ggfOptimizeCode = 32768, ///<-- fold constants & simplify instructions on code prepare (copy of code only),
+                           ///    total cost is the cost of simplified code, lower than cost of original code
+  ggfNumericProfile = 65536 ///<-- numeric programs: compiled blocks run directly on raw input values (runNumeric)
 };
 
 /// flags of supported argument types
@@ -260,6 +263,7 @@ const uint SGP_DEF_DYNAMIC_REGS_LIMIT = 512;
 const uint SGP_DEF_MAX_STACK_DEPTH = 255;
 const uint SGP_DEF_MAX_ACCESS_PATH_LEN = 32;
 const uint SGP_MAX_INSTR_ARG_COUNT = 31;
+const uint SGP_MAX_INSTR_CODE = 0x7ff;
 const uint SGP_DEF_ITEM_LIMIT = 100000;
 const uint SGP_DEF_INSTR_CACHE_SIZE = 1000;
 const uint SGP_MAX_REG_NO = 1000;
@@ -316,7 +320,44 @@ const uint GASM_ARG_META_DATA_TYPE = 2;
 // sgpProgramState
 // ----------------------------------------------------------------------------    
 typedef std::map<uint, scDataNode> sgpRegReferences;
-typedef boost::unordered_set<uint> sgpRegUSet;
+
+const uint SGP_TYPED_REG_COUNT = SGP_REGB_VARIANTS - SGP_REGB_ACCUMS;
+
+/// Unboxed value of a single typed accumulator
+union sgpTypedRegValue {
+  int asInt;
+  long64 asInt64;
+  byte asByte;
+  uint asUInt;
+  ulong64 asUInt64;
+  float asFloat;
+  double asDouble;
+  xdouble asXDouble;
+  bool asBool;
+};
+
+/// Unboxed storage for typed accumulators (#34..#60).
+/// Data type of each register is fixed when file is loaded from boxed registers,
+/// registers with non-scalar type are left boxed (gdtfVariant).
+struct sgpTypedRegFile {
+  sgpTypedRegValue values[SGP_TYPED_REG_COUNT];
+  uint dataTypes[SGP_TYPED_REG_COUNT];
+
+  void clear();
+  void loadFrom(const scDataNode &regs);
+  void storeTo(scDataNode &regs) const;
+  void getValue(uint regNo, scDataNode &output) const;
+  void setValue(uint regNo, const scDataNode &value);
+  static void getUnboxedValue(const sgpTypedRegValue &reg, uint dataType, scDataNode &output);
+  static void setUnboxedValue(sgpTypedRegValue &reg, uint dataType, const scDataNode &value);
+  static void setUnboxedValue(sgpTypedRegValue &reg, uint dataType, double value);
+  bool isUnboxed(uint regNo) const {
+    return 
+      (regNo >= SGP_REGB_ACCUMS) && (regNo < SGP_REGB_VARIANTS)
+      &&
+      (dataTypes[regNo - SGP_REGB_ACCUMS] != gdtfVariant);
+  }
+};
  
 /// Full program state (like processor + memory snapshot)
 struct sgpProgramState {
@@ -325,9 +366,11 @@ struct sgpProgramState {
   cell_size_t activeCellNo;
   cell_size_t nextCellNo;
   uint flags;
-  sgpRegUSet modifiedRegs;
+  std::vector<uint> regEpochs; ///<-- epoch of last write for each register, 0 if not modified
+  uint regEpoch;               ///<-- current epoch, incremented on register restore
   scDataNode activeRegs;  ///<-- build-in, vmachine-generated registers
   scDataNode definedRegs; ///<-- registers defined dynamically
+  sgpTypedRegFile typedRegs; ///<-- unboxed accumulators, valid if ggfTypedRegsEnabled is active
   sgpRegReferences references;
   scDataNode callStack;
   scDataNode valueStack;
@@ -335,19 +378,62 @@ struct sgpProgramState {
   scDataNode notes;
   scDataNode reserve;
   
+  sgpProgramState(): regEpoch(1) {}
   void reset();
   void resetWarmWay();
   void clearRegisters();
   void restoreRegisters(const scDataNode &src);
-  void markRegAsModified(uint regNo);
+  void restoreRegister(uint regNo, const scDataNode &src);
+  void syncRegisters(const scDataNode &src);
+  void touchRegisters();
+  void markRegAsModified(uint regNo) {
+    if (regNo < regEpochs.size())
+      regEpochs[regNo] = regEpoch;
+  }
+  // register modified before last restore has to be restored before value is used
+  void syncRegister(uint regNo, const scDataNode &src) {
+    if ((regNo < regEpochs.size()) && (regEpochs[regNo] != 0) && (regEpochs[regNo] != regEpoch))
+      restoreRegister(regNo, src);
+  }
+  void loadTypedRegisters();
+  void storeTypedRegisters();
+  void boxTypedRegister(uint regNo);
 };
 
 typedef std::set<uint> sgpGasmRegSet;
 
+class sgpFunction;
+
+/// instruction prepared for liveness analysis of block
+struct sgpLivenessInstr {
+  cell_size_t offset;
+  cell_size_t size;
+  uint code;
+  sgpFunction *functor;
+  scDataNode args;
+  bool changed;   ///<-- code & args replaced by optimizer
+  sgpGasmRegSet uses;
+  sgpGasmRegSet defs;
+  sgpGasmRegSet kills;  ///<-- registers overwritten as a whole
+  sgpGasmRegSet liveIn;
+  std::vector<uint> jumpArgNos;
+  std::vector<cell_size_t> jumpTargetOffsets;
+  std::vector<uint> jumpTargets; ///<-- index of target instruction, instruction count = block end
+  bool fixed;     ///<-- instruction is always effective
+  bool effective;
+};
+
+typedef std::vector<sgpLivenessInstr> sgpLivenessInstrVector;
+
 // ----------------------------------------------------------------------------
 // Class definitions
 // ----------------------------------------------------------------------------
 class sgpProgramCode;
+class sgpBatchLanes;
+struct sgpNativeInstr;
+
+/// native function with operands bound on compile, returns sgpNativeFuncResult
+typedef uint (*sgpNativeFunc)(const sgpNativeInstr &instr);
 
 // ----------------------------------------------------------------------------
 // sgpFunction
@@ -370,6 +456,14 @@ public:
   // -- execution
   virtual bool execute(const scDataNode &args) const = 0;
   virtual bool execute(const scDataNode &args, uint &execCost) const;
+  // returns <true> if function can be executed for all lanes of batch at once
+  virtual bool hasBatchKernel() const;
+  virtual bool executeBatch(sgpBatchLanes &lanes) const;
+  virtual bool executeBatch(sgpBatchLanes &lanes, uint &execCost) const;
+  // returns native function for given static argument types or NULL if not supported,
+  // gdtfVariant is used for output register which type is not known yet
+  virtual sgpNativeFunc getNativeFunc(const uint *argTypes, uint argCount, uint &outputType) const;
+  virtual sgpNativeFunc getNativeFunc(const uint *argTypes, uint argCount, uint &outputType, uint &execCost) const;
   // returns <true> if function changes current execution point
   virtual bool isJumpAction();
   // returns <true> if function can be stripped on code prepare
@@ -380,6 +474,16 @@ public:
   virtual void prepare();
   // returns <true> if arguments cannot be auto-generated basing on meta info
   virtual bool hasDynamicArgs() const; 
+  // returns <true> if function changes machine state other than output arguments (stack, code, flags)
+  virtual bool hasSideEffects() const;
+  // returns <false> if function with valid arguments always writes output
+  virtual bool canFail() const;
+  // returns <true> if output value can be calculated on code prepare (all inputs are constants)
+  virtual bool foldConstArgs(const scDataNode &args, scDataNode &output) const;
+  // returns number of input argument which is returned unchanged (e.g. x*1) or -1 
+  virtual int getIdentityArgNo(const scDataNode &args) const;
+  // returns <true> if f(f(x)) = x (e.g. neg)
+  virtual bool isInvolution() const;
 protected:
   virtual uint getFunctionCost() const;
   void addArgMeta(uint ioMode, uint argTypeMask, uint dataTypeMask, scDataNode &output) const;
@@ -408,7 +512,45 @@ public:
 };
 
 typedef boost::intrusive_ptr<sgpFunction> sgpFunctionTransporter;
-typedef std::map<uint,sgpFunctionTransporter> sgpFunctionMapColn;
+
+/// Function list with lookup by raw instruction code.
+/// Functions are kept in map (code order), codes up to SGP_MAX_INSTR_CODE 
+/// are also stored in dense table, so lookup is a single indexed load.
+/// Note: functors must not be replaced using iterators.
+class sgpFunctionMapColn {
+public:
+  typedef std::map<uint, sgpFunctionTransporter> sgpFunctionMap;
+  typedef sgpFunctionMap::value_type value_type;
+  typedef sgpFunctionMap::size_type size_type;
+  typedef sgpFunctionMap::iterator iterator;
+  typedef sgpFunctionMap::const_iterator const_iterator;
+  
+  iterator begin() { return m_items.begin(); }
+  iterator end() { return m_items.end(); }
+  const_iterator begin() const { return m_items.begin(); }
+  const_iterator end() const { return m_items.end(); }
+  iterator find(uint instrCode) { return m_items.find(instrCode); }
+  const_iterator find(uint instrCode) const { return m_items.find(instrCode); }
+  size_type size() const { return m_items.size(); }
+  bool empty() const { return m_items.empty(); }
+  std::pair<iterator, bool> insert(const value_type &value);
+  void clear();
+  // returns functor for raw instruction code or SC_NULL if code is unknown
+  sgpFunction *getFunctor(uint instrCode) const {
+    if (instrCode < m_index.size())
+      return m_index[instrCode];
+    else if (instrCode > SGP_MAX_INSTR_CODE)
+      return findFunctor(instrCode);
+    else
+      return SC_NULL;    
+  }
+protected:
+  sgpFunction *findFunctor(uint instrCode) const;
+protected:
+  sgpFunctionMap m_items;
+  std::vector<sgpFunction *> m_index;
+};
+
 typedef std::set<ulong64> sgpValidationCacheSet;
 
 void addFunctionToList(uint instrCode, sgpFunction *funct, sgpFunctionMapColn &list);
@@ -432,6 +574,7 @@ public:
   // public methods
   void clear();
   scDataNode &getFullCode();
+  const scDataNode &getFullCode() const;
   void setFullCode(const scDataNode &code);
   cell_size_t getBlockLength(uint blockNo) const; 
   /// returns size of code for all blocks in total
@@ -464,37 +607,280 @@ protected:
   scDataNode m_code;
   cell_size_t m_maxBlockLength;
 };
+
+// ----------------------------------------------------------------------------
+// sgpCompiledProgram
+// ----------------------------------------------------------------------------    
+/// Program code expanded & prepared for execution. Object is not modified after 
+/// compile, so it can be shared by many vmachines (execution contexts), also 
+/// running in different threads. Code is decoded by each vmachine separately 
+/// since functors are bound to vmachine which executes them.
+/// Program can be executed only by vmachines with the same configuration 
+/// (features, function list, supported types) as compiling one.
+class sgpCompiledProgram {
+public:
+  sgpCompiledProgram();
+  virtual ~sgpCompiledProgram();
+  const sgpProgramCode &getCode() const { return m_code; }
+  cell_size_t getInstrCount() const { return m_instrCount; }
+  cell_size_t getEffInstrCount() const { return m_effInstrCount; }
+  /// returns number of leading cells of block equal in both programs, meta info is skipped
+  cell_size_t getCommonCodeLength(const sgpCompiledProgram &other, uint blockNo) const;
+protected:
+  friend class sgpVMachine;
+  sgpProgramCode m_code;
+  cell_size_t m_instrCount;    ///<-- instructions before preparation
+  cell_size_t m_effInstrCount; ///<-- instructions after preparation
+};
+
+typedef boost::shared_ptr<const sgpCompiledProgram> sgpCompiledProgramTransporter;
   
 typedef std::auto_ptr<scDataNode> sgpArgsGuard;
      
-class sgpInstructionInfo {
+typedef std::vector<uint> sgpDataTypeVector;
+       
+sgpFunction *getFunctorForInstrCode(const sgpFunctionMapColn &functions, 
+  uint instrCodeRaw);
+
+// ----------------------------------------------------------------------------
+// sgpDecodedProgram
+// ----------------------------------------------------------------------------    
+/// status of pre-decoded instruction
+enum sgpDecodedInstrStatus {
+  gdisOk = 0,
+  gdisUnknownInstr = 1,
+  gdisWrongArgCount = 2
+};
+
+/// result of argument validation on load
+enum sgpDecodedArgCheck {
+  gdacDynamic = 0, ///<-- arguments are validated on run
+  gdacStatic = 1,  ///<-- arguments are valid, static types only
+  gdacProven = 2   ///<-- arguments are valid if block was entered with inferred register types
+};
+
+const int SGP_DECODED_BLOCK_END = -1;
+const int SGP_DECODED_NOT_LINKED = -2;
+
+/// pre-classified instruction argument
+struct sgpDecodedArg {
+  uint argType; ///<-- gatfConst, gatfRegister, gatfRef or gatfNull
+  uint value;   ///<-- register number (gatfRegister) or index in constant pool (gatfConst)
+};
+
+/// single pre-decoded instruction
+struct sgpDecodedInstr {
+  sgpFunction *functor;
+  const scDataNode *args;     ///<-- argument cells, owned by sgpDecodedProgram
+  uint instrCode;             ///<-- raw instruction code
+  uint encodedCode;           ///<-- instruction cell as stored in code
+  uint argCount;
+  uint firstArg;              ///<-- index of first sgpDecodedArg
+  cell_size_t nextCellOffset; ///<-- distance to next instruction
+  int nextInstr;              ///<-- index of next instruction in code order or SGP_DECODED_*
+  uint status;                ///<-- sgpDecodedInstrStatus
+  uint argCheck;              ///<-- sgpDecodedArgCheck
+};
+
+typedef std::vector<sgpDecodedInstr> sgpDecodedInstrVector;
+typedef std::vector<sgpDecodedArg> sgpDecodedArgVector;
+typedef std::vector<int> sgpDecodedCellIndex;
+
+/// decoded instructions of a single block
+struct sgpDecodedBlock {
+  sgpDecodedInstrVector instrs;
+  sgpDecodedCellIndex cellIndex; ///<-- cell no -> index in instrs, -1 if not decoded yet
+  bool typesInferred;
+  bool typesProvable;            ///<-- <false> if control flow of block cannot be analysed
+  std::vector<uint> entryRegs;   ///<-- dynamic registers used by block
+  std::vector<uint> entryTypes;  ///<-- data types of entryRegs assumed on block entry
+  sgpDecodedBlock(): typesInferred(false), typesProvable(false) {}
+};
+
+typedef std::vector<sgpDecodedBlock> sgpDecodedBlockVector;
+
+/// Program code decoded into flat arrays of instructions, one array per block.
+/// Instructions are decoded in code order on compile, cells reached by 
+/// irregular jumps are decoded on demand. 
+class sgpDecodedProgram {
 public:
-  sgpInstructionInfo(uint instrCode, uint argCount, scDataNode* args, sgpFunction *functor): 
-    m_instrCode(instrCode), m_argCount(argCount), m_args(args), m_functor(functor) {};
-  virtual ~sgpInstructionInfo() {
-  };
-  void getActiveInstr(uint &instrCode, uint &argCount, scDataNode* &args, sgpFunction* &functor) {
-    instrCode = m_instrCode;
-    argCount = m_argCount;
-    args = m_args.get();
-    functor = m_functor;
+  sgpDecodedProgram();
+  virtual ~sgpDecodedProgram();
+  void clear();
+  bool empty() const;
+  void compile(sgpProgramCode &code, const sgpFunctionMapColn &functions);
+  void compileBlock(sgpProgramCode &code, const sgpFunctionMapColn &functions, uint blockNo);
+  const sgpDecodedInstr *getInstr(sgpProgramCode &code, const sgpFunctionMapColn &functions, 
+    uint blockNo, cell_size_t cellNo, bool &decoded);
+  const sgpDecodedInstr *getLinkedInstr(uint blockNo, int instrIndex) const { 
+    return &(m_blocks[blockNo].instrs[instrIndex]); 
+  }
+  const sgpDecodedArg &getArg(uint argIndex) const { return m_args[argIndex]; }
+  sgpDecodedBlock *getBlock(uint blockNo) { 
+    return (blockNo < m_blocks.size()) ? &m_blocks[blockNo] : SC_NULL; 
   }
-  size_t size() { return 1; }
+  void clearArgChecks();
+  const scDataNode &getConstPool() const { return m_constPool; }
+protected:
+  sgpDecodedBlock &prepareBlock(sgpProgramCode &code, uint blockNo);
+  int decodeCell(sgpProgramCode &code, const sgpFunctionMapColn &functions, 
+    sgpDecodedBlock &block, uint blockNo, cell_size_t cellNo);
+protected:
+  sgpDecodedBlockVector m_blocks;
+  sgpDecodedArgVector m_args;
+  boost::ptr_vector<scDataNode> m_argLists;
+  scDataNode m_constPool;
+};
+
+// ----------------------------------------------------------------------------
+// sgpBatchLanes
+// ----------------------------------------------------------------------------
+/// state of single lane (sample) of batch run
+enum sgpBatchLaneState {
+  gblsRunning = 0,
+  gblsFinished = 1, ///<-- stopped by error limit
+  gblsScalar = 2    ///<-- lane has to be executed again in scalar mode
+};
+
+/// instruction argument prepared for batch run
+struct sgpBatchArg {
+  uint argType;      ///<-- gatfConst, gatfRegister or gatfNull
+  uint slot;         ///<-- register slot (gatfRegister)
+  uint regType;      ///<-- default data type of register, gdtfVariant for dynamic registers
+  double constValue; ///<-- value of constant (gatfConst)
+  uint constType;    ///<-- data type of constant (gatfConst)
+  uint evalCost;     ///<-- cost of evaluateArg
+  uint laneTypeMask; ///<-- allowed data types of dynamic register value, 0 if not validated
+};
+
+/// instruction prepared for batch run
+struct sgpBatchInstr {
+  const sgpDecodedInstr *instr;
+  cell_size_t cellNo;
+  uint firstArg;     ///<-- index of first sgpBatchArg
+  uint validateCost; ///<-- cost of argument validation
+};
+
+typedef std::vector<sgpBatchArg> sgpBatchArgVector;
+typedef std::vector<sgpBatchInstr> sgpBatchInstrVector;
+typedef std::vector<ulong64> sgpBatchCostVector;
+typedef std::vector<double> sgpBatchInputVector;
+
+/// Structure-of-arrays register file for batch run - one lane per sample.
+/// Values of all supported types (int, uint, byte, float, double, bool) are
+/// stored as double (exact for each of them), data type is stored per lane.
+/// Lane executes instruction only if it's resume cell is not behind instruction
+/// cell, so only forward skips are supported.
+class sgpBatchLanes {
+public:
+  sgpBatchLanes();
+  virtual ~sgpBatchLanes();
+  // -- run control
+  void init(uint laneCount, uint slotCount, cell_size_t blockLength, uint errorLimit);
+  void setSlotValue(uint slot, uint lane, double value, uint dataType);
+  void setInstrCell(cell_size_t cellNo);
+  uint beginInstr(const sgpBatchInstr &instr, const sgpBatchArg *args);
+  void endInstr(uint execCost);
+  uint getLaneState(uint lane) const { return m_states[lane]; }
+  ulong64 getLaneCost(uint lane) const { return m_costs[lane]; }
+  void getSlotValue(uint slot, uint lane, scDataNode &output) const;
+  static bool isNumericType(uint dataType);
+  static double castValue(double value, uint dataType);
+  static void buildValue(double value, uint dataType, scDataNode &output);
+  // -- used by batch kernels
+  uint getLaneCount() const { return m_laneCount; }
+  bool isActive(uint lane) const { return (m_active[lane] != 0); }
+  double *getResultBuffer() { return &m_result[0]; }
+  void evaluateArg(uint argNo, const double *&values, const uint *&dataTypes);
+  void setLValue(uint argNo, uint lane, double value, uint dataType);
+  void skipCells(uint lane, ulong64 cellCount);
+  void failLane(uint lane);
+  void abortLane(uint lane);
+protected:
+  void checkLaneArgs(uint lane);
 protected:
-  uint m_instrCode;
+  uint m_laneCount;
+  uint m_errorLimit;
+  cell_size_t m_blockLength;
+  std::vector<double> m_values;   ///<-- slot-major: [slot * laneCount + lane]
+  std::vector<uint> m_types;
+  std::vector<double> m_constValues; ///<-- constant arguments broadcasted to all lanes
+  std::vector<uint> m_constTypes;
+  std::vector<double> m_result;
+  std::vector<cell_size_t> m_resumeCells;
+  std::vector<uint> m_states;
+  std::vector<uint> m_errorCounts;
+  std::vector<ulong64> m_costs;
+  std::vector<char> m_active;
+  std::vector<char> m_failed;
+  std::vector<char> m_skipped;
+  std::vector<char> m_instrCells;  ///<-- cells where instructions begin
+  const sgpBatchArg *m_args;
   uint m_argCount;
-  sgpArgsGuard m_args;
-  sgpFunction *m_functor;
+  cell_size_t m_nextCellNo;
 };
 
-typedef boost::shared_ptr<sgpInstructionInfo> sgpInstructionInfoTransporter;
-typedef std::vector<uint> sgpDataTypeVector;
+// ----------------------------------------------------------------------------
+// sgpNativeProgram
+// ----------------------------------------------------------------------------
+/// result of native function
+enum sgpNativeFuncResult {
+  gnfrNext = 0,  ///<-- continue with next instruction
+  gnfrJump = 1,  ///<-- continue with jump target
+  gnfrFailed = 2 ///<-- function reported error & failed
+};
+
+const uint SGP_NATIVE_MAX_ARG_COUNT = 3;
+
+/// instruction compiled to native function
+struct sgpNativeInstr {
+  sgpNativeFunc func;
+  sgpTypedRegValue *args[SGP_NATIVE_MAX_ARG_COUNT]; ///<-- unboxed registers or constants
+  uint jumpTarget;      ///<-- index of instruction executed after gnfrJump
+  cell_size_t cellNo;
+  uint cost;            ///<-- cost of successful execution
+  uint failCost;        ///<-- cost of gnfrFailed
+  bool writesOutput;
+};
+
+typedef std::vector<sgpNativeInstr> sgpNativeInstrVector;
+typedef std::vector<sgpTypedRegValue> sgpNativeValueVector;
+
+/// Block compiled to a chain of native functions. Operands are bound to unboxed
+/// typed registers, constants & I/O registers of vmachine, so program can be 
+/// executed only if all registers have static types (I/O register types are 
+/// fixed on compile). Only forward skips with constant size are supported.
+struct sgpNativeProgram {
+  bool compiled;                ///<-- compilation was performed, result is in "valid"
+  bool valid;
+  uint blockNo;
+  cell_size_t blockLength;
+  uint outputType;              ///<-- data type of output register after write
+  sgpNativeInstrVector instrs;
+  sgpNativeValueVector consts;
+  std::vector<uint> inputRegs;  ///<-- input registers used by program
+  sgpDataTypeVector inputTypes; ///<-- data types of input registers expected on run
+  
+  sgpNativeProgram() { clear(); }
+  void clear();
+};
+
+/// State of numeric run before instruction of compiled block. Program with the same 
+/// code before this instruction can resume run from it instead of running block
+/// from the beginning. Only unboxed registers are stored, other state is not 
+/// modified by native run.
+struct sgpNumericCheckpoint {
+  cell_size_t cellNo;           ///<-- cell of next instruction
+  cell_size_t instrCount;       ///<-- instructions executed before checkpoint
+  ulong64 cost;
+  uint errorCount;
+  bool outputWritten;
+  sgpTypedRegValue outputValue;
+  sgpTypedRegValue regs[SGP_TYPED_REG_COUNT];
+};
+
+typedef std::vector<sgpNumericCheckpoint> sgpNumericCheckpointVector;
 
-typedef LRUCache<ulong64,sgpInstructionInfo> sgpInstrCache;
-       
-sgpFunction *getFunctorForInstrCode(const sgpFunctionMapColn &functions, 
-  uint instrCodeRaw);
-       
 // ----------------------------------------------------------------------------
 // sgpVMachine
 // ----------------------------------------------------------------------------    
@@ -516,12 +902,24 @@ public:
   void setInput(const scDataNode &value);
   void setOutput(const scDataNode &value);
   void forceInstrCache();
+  void runBatch(const double *inputs, uint laneCount, uint inputCount, uint inputDataType,
+    scDataNode &outputs, sgpBatchCostVector &costs, uint instrLimit = 0);
+  void runNumeric(const double *inputs, uint inputCount, uint inputDataType, uint blockNo, 
+    scDataNode &output, uint instrLimit = 0);
+  void runNumeric(const double *inputs, uint inputCount, uint inputDataType, uint blockNo, 
+    scDataNode &output, uint instrLimit, uint checkpointCount, sgpNumericCheckpointVector &checkpoints);
+  bool resumeNumeric(const sgpNumericCheckpoint &checkpoint, const double *inputs, uint inputCount, 
+    uint inputDataType, uint blockNo, scDataNode &output, uint instrLimit, 
+    uint checkpointCount, sgpNumericCheckpointVector &checkpoints);
   void getCounters(scDataNode &output);
   void resetCounters();
 
   // helper functions
   void prepareCode(sgpProgramCode &code) const;
+  void prepareCode(sgpProgramCode &code, cell_size_t &instrCount, cell_size_t &effInstrCount) const;
+  cell_size_t countInstructions(const sgpProgramCode &code) const;
   void expandCode(sgpProgramCode &code, uint firstBlockNo = 0, bool validateOrder = true) const;
+  sgpCompiledProgramTransporter compileProgram(const scDataNode &code) const;
   void getArgValue(const scDataNode &argInfo, scDataNode &output);
   void setArgValue(const scDataNode &argInfo, const scDataNode &value);
 
@@ -531,9 +929,11 @@ public:
   static uint getArgMetaParamUInt(const scDataNode &meta, uint argNo, uint argMetaId);
   static void buildFunctionArgMeta(scDataNode &output, uint ioMode, uint argTypes, uint dataTypes);
   static bool isRegisterNo(uint value);
+  static bool isNumericProfileSupported(const sgpFunctionMapColn &functions, uint dataTypes);
   static uint getRegisterNo(const scDataNode &lvalue);
   static uint getRegisterNo(const scDataNodeValue &lvalue);
   static scDataNodeValueType castGasmToDataNodeType(sgpGvmDataTypeFlag a_type);
+  static uint getOperCostById(uint a_subOperCostId);
 
   void prepareRegisterSet(sgpGasmRegSet &regSet, uint allowedDataTypes, uint ioMode) const;
 
@@ -550,6 +950,7 @@ public:
   void getProgramState(sgpProgramState &state) const;
   void setProgramCode(const sgpProgramCode &code);
   void getProgramCode(sgpProgramCode &code) const;
+  void setCompiledProgram(const sgpCompiledProgramTransporter &program);
   void setFunctionList(const sgpFunctionMapColn &functions);
   uint getFeatures();
   void setFeatures(uint features);
@@ -602,6 +1003,7 @@ public:
   virtual void setReferencedValue(const scDataNode &ref, const scDataNode &value, bool forceCast = false);
   bool argValidationEnabled();
   void evaluateArg(const scDataNode &input, scDataNode &output);
+  const scDataNode &evaluateArgRef(const scDataNode &input, scDataNode &temp);
   bool isRefInRegister(uint regNo);
   void addRef(uint outputRegNo, uint inputRegNo, int elementNo = -1, const scString &elementName = "");
   void defineVar(uint outputRegNo, sgpGvmDataTypeFlag a_dataType);
@@ -699,6 +1101,9 @@ protected:
   virtual void initRegisters();
   virtual void initRegisterTemplate();
   void addRegisterTplBlock(sgpGvmDataTypeFlag a_type, uint a_size);
+  void restoreRegisters();
+  bool isTypedRegsEnabled();
+  void updateRegisterBackend();
   scDataNode buildRegisterValue(sgpGvmDataTypeFlag a_type);  
   void releaseRef(uint refRegNo, const scDataNode &ref);
 
@@ -714,12 +1119,49 @@ protected:
   void clearTrace();
   void prepareRun();
   void intRun();
+  void intRunThreaded();
+  bool intRunThreadedSteps();
+  bool finishThreadedInstr();
+  bool checkThreadedRunState();
   bool getActiveInstrForLog(uint &instrCode, uint &argCount, scString &name);
-  bool getActiveInstr(uint &instrCode, uint &argCount, scDataNode &args, sgpFunction *&functor);
-  bool getActiveInstrFromCache(uint &instrCode, uint &argCount, scDataNode *&args, sgpFunction *&functor);
+  const sgpDecodedInstr *getActiveDecodedInstr();
+  void handleDecodedInstrError(const sgpDecodedInstr &instr);
   void intRunInstr(uint code, const scDataNode &args, sgpFunction *functor);
+  void runDecodedInstr(const sgpDecodedInstr &instr, bool validateArgs);
+  bool checkInstrArgs(uint code, const scDataNode &args, sgpFunction *functor);
+  void updateArgTypesProven(uint blockNo);
+  bool checkEntryArgTypes(uint blockNo);
+  uint getActualArgType(uint regNo);
+  bool inferArgTypes(uint blockNo, sgpDecodedBlock &block);
+  void inferInstrArgTypes(const sgpDecodedInstr &instr, const std::vector<int> &regSlots, 
+    std::vector<uint> &regTypes);
+  uint checkArgsOnLoad(const sgpDecodedInstr &instr, const std::vector<int> &regSlots, 
+    const std::vector<uint> &regTypes);
+  uint getArgTypeOnLoad(const scDataNode &argCell, const std::vector<int> &regSlots, 
+    const std::vector<uint> &regTypes);
+  void execInstr(uint code, const scDataNode &args, sgpFunction *functor);
   void addOperCost(ulong64 a_cost);
   void addOperCostById(uint a_subOperCostId, uint mult = 1);
+  bool prepareBatchPlan(uint blockNo, uint instrLimit);
+  bool prepareBatchArg(const scDataNode &argCell, const scDataNode *argMeta, uint argNo, 
+    bool validateArgs, sgpBatchArg &output, bool &staticTypes);
+  bool isBatchRegisterSupported(uint regNo) const;
+  void runBatchLaneScalar(const double *inputs, uint inputCount, uint inputDataType, uint blockNo, 
+    uint instrLimit, scDataNode &output, ulong64 &cost);
+  bool prepareNativeRun();
+  bool compileNative(uint blockNo, sgpNativeProgram &output);
+  bool prepareNativeArg(const scDataNode &argCell, const scDataNode *argMeta, uint argNo, 
+    bool validateArgs, sgpNativeProgram &program, sgpTypedRegValue *&argPtr, uint &argType, 
+    uint &evalCost, uint &allowedTypes, bool &staticTypes);
+  void intRunNative();
+  cell_size_t runNativeChain(bool &outputWritten);
+  cell_size_t runNativeChain(uint instrIdx, uint checkpointStep, sgpNumericCheckpointVector *checkpoints, 
+    bool &outputWritten);
+  void intRunNumeric(const double *inputs, uint inputDataType, const sgpNumericCheckpoint *checkpoint, 
+    uint instrIdx, uint checkpointCount, sgpNumericCheckpointVector *checkpoints, scDataNode &output);
+  void addNumericCheckpoint(uint instrIdx, ulong64 cost, bool outputWritten, 
+    sgpNumericCheckpointVector &checkpoints) const;
+  bool prepareNumericRun(uint inputCount, uint inputDataType, uint blockNo, uint instrLimit);
   scString getCurrentAddressCtx();
   scString getCurrentCtx();
   scString formatErrorMsg(uint msgCode, const scString &msgText);
@@ -745,8 +1187,18 @@ protected:
   void clearArgValidCache();
   void clearInstrCache();
   ulong64 calcActiveInstrCacheKey();
-  void addInstrToCache(ulong64 keyNum, uint instrCode, uint argCount, scDataNode *args, sgpFunction *functor);
   void stripUnusedCodeAfterLastOutWrite(sgpProgramCode &code) const;
+  void stripNonEffectiveCode(sgpProgramCode &code) const;
+  bool prepareLivenessInstrs(const scDataNode &blockCode, sgpLivenessInstrVector &instrs) const;
+  bool prepareLivenessArgs(sgpLivenessInstr &instr) const;
+  void optimizeInstrs(sgpLivenessInstrVector &instrs) const;
+  bool isOptimizableOutput(const scDataNode &arg) const;
+  static bool isSameRegister(const scDataNode &arg1, const scDataNode &arg2);
+  bool isExactRegisterPass(const sgpLivenessInstr &instr, uint inputArgNo, const scDataNode &outputArg) const;
+  bool isValidOnPrepare(sgpFunction *functor, const scDataNode &args) const;
+  bool findFunctionCode(const scString &name, uint &instrCodeRaw) const;
+  static void calcLiveness(sgpLivenessInstrVector &instrs);
+  static bool stripNonEffectiveInstrs(const sgpLivenessInstrVector &instrs, scDataNode &blockCode);
   void macroReplaceInputRegsWithArgs(const scDataNode &macroInputMeta, const scDataNode &args, scDataNode &code);
   bool macroReplaceArgRegInCode(uint oldRegNo, const scDataNode &newValue, uint searchIoMode, 
     cell_size_t instrOffset, scDataNode &blockCode);
@@ -772,8 +1224,11 @@ protected:
   sgpFunctionMapColn m_functions;
 // vmachine state
   sgpProgramCode m_programCode;
+  sgpCompiledProgramTransporter m_compiledProgram; ///<-- source of m_programCode if set using compiled program
   sgpProgramState m_programState;
   scDataNode m_registerTemplate;
+  sgpTypedRegFile m_typedRegTemplate;
+  bool m_typedRegsActive;
   uint m_registerTemplateSize;
   sgpDataTypeVector m_registerDataTypes;
   cell_size_t m_instrCount;
@@ -783,8 +1238,20 @@ protected:
   mutable uint m_readRegErrorLock;
   scDataNode m_notes;
   sgpValidationCacheSet m_validArgCache;
-  sgpInstrCache m_instrCache;
+  sgpDecodedProgram m_decodedProgram;
   bool m_instrCacheRequired;
+  bool m_instrCacheInvalid;
+  const sgpDecodedInstr *m_activeInstr;
+  bool m_argTypesProven;      ///<-- register types of active block match inferred ones
+  int m_provenBlockNo;
+  uint m_provenCallDepth;
+  sgpBatchInstrVector m_batchInstrs;
+  sgpBatchArgVector m_batchArgs;
+  std::vector<int> m_batchRegSlots; ///<-- register no -> slot in batch lanes, -1 if not used
+  std::vector<uint> m_batchSlotRegs;
+  sgpBatchLanes m_batchLanes;
+  sgpNativeProgram m_nativeProgram;
+  sgpTypedRegValue m_nativeIoRegs[SGP_REGB_ACCUMS]; ///<-- unboxed I/O registers for native run
 #ifdef GVM_USE_COUNTERS  
   perf::LocalCounter m_counters;
 #endif
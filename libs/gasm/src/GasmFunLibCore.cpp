@@ -27,6 +27,106 @@
 
 using namespace dtp;
 
+// returns <true> if static type of output argument matches result of native function,
+// gdtfVariant is used for output register which type is not known yet
+static bool isNativeOutputType(uint argType, uint dataType)
+{
+  return (argType == dataType) || (argType == gdtfVariant);
+}
+
+// returns <true> if argument is a simple constant which can be used on code prepare
+static bool isFoldableConstArg(const scDataNode &arg)
+{
+  return !arg.isParent() && (sgpVMachine::getArgType(arg) == gatfConst);
+}
+
+// ----------------------------------------------------------------------------
+// typed kernels
+// ----------------------------------------------------------------------------
+// Value access for kernels generated from templates, one specialization 
+// for each scalar data type supported by typed registers.
+// batchEnabled: batch lanes (double) can hold each value of type without loss
+// isInteger: value has no signed zero, so x+0 == x 
+template<uint DataType> struct sgpKernelType {};
+
+template<> struct sgpKernelType<gdtfInt> {
+  typedef int value_type;
+  enum { batchEnabled = 0, isInteger = 1 };
+  static value_type getValue(const scDataNode &value) { return value.getAsInt(); }
+  static value_type getValue(const sgpTypedRegValue &reg) { return reg.asInt; }
+  static value_type &getRef(sgpTypedRegValue &reg) { return reg.asInt; }
+  static bool isEqual(value_type a, value_type b) { return (a == b); }
+};
+
+template<> struct sgpKernelType<gdtfInt64> {
+  typedef long64 value_type;
+  enum { batchEnabled = 0, isInteger = 1 };
+  static value_type getValue(const scDataNode &value) { return value.getAsInt64(); }
+  static value_type getValue(const sgpTypedRegValue &reg) { return reg.asInt64; }
+  static value_type &getRef(sgpTypedRegValue &reg) { return reg.asInt64; }
+  static bool isEqual(value_type a, value_type b) { return (a == b); }
+};
+
+template<> struct sgpKernelType<gdtfByte> {
+  typedef byte value_type;
+  enum { batchEnabled = 0, isInteger = 1 };
+  static value_type getValue(const scDataNode &value) { return value.getAsByte(); }
+  static value_type getValue(const sgpTypedRegValue &reg) { return reg.asByte; }
+  static value_type &getRef(sgpTypedRegValue &reg) { return reg.asByte; }
+  static bool isEqual(value_type a, value_type b) { return (a == b); }
+};
+
+template<> struct sgpKernelType<gdtfUInt> {
+  typedef uint value_type;
+  enum { batchEnabled = 0, isInteger = 1 };
+  static value_type getValue(const scDataNode &value) { return value.getAsUInt(); }
+  static value_type getValue(const sgpTypedRegValue &reg) { return reg.asUInt; }
+  static value_type &getRef(sgpTypedRegValue &reg) { return reg.asUInt; }
+  static bool isEqual(value_type a, value_type b) { return (a == b); }
+};
+
+template<> struct sgpKernelType<gdtfUInt64> {
+  typedef ulong64 value_type;
+  enum { batchEnabled = 0, isInteger = 1 };
+  static value_type getValue(const scDataNode &value) { return value.getAsUInt64(); }
+  static value_type getValue(const sgpTypedRegValue &reg) { return reg.asUInt64; }
+  static value_type &getRef(sgpTypedRegValue &reg) { return reg.asUInt64; }
+  static bool isEqual(value_type a, value_type b) { return (a == b); }
+};
+
+template<> struct sgpKernelType<gdtfFloat> {
+  typedef float value_type;
+  enum { batchEnabled = 1, isInteger = 0 };
+  static value_type getValue(const scDataNode &value) { return value.getAsFloat(); }
+  static value_type getValue(const sgpTypedRegValue &reg) { return reg.asFloat; }
+  static value_type &getRef(sgpTypedRegValue &reg) { return reg.asFloat; }
+  static bool isEqual(value_type a, value_type b) { 
+    return (std::fabs(a - b) < std::numeric_limits<float>::epsilon()); 
+  }
+};
+
+template<> struct sgpKernelType<gdtfDouble> {
+  typedef double value_type;
+  enum { batchEnabled = 1, isInteger = 0 };
+  static value_type getValue(const scDataNode &value) { return value.getAsDouble(); }
+  static value_type getValue(const sgpTypedRegValue &reg) { return reg.asDouble; }
+  static value_type &getRef(sgpTypedRegValue &reg) { return reg.asDouble; }
+  static bool isEqual(value_type a, value_type b) { 
+    return (std::fabs(a - b) < std::numeric_limits<double>::epsilon()); 
+  }
+};
+
+template<> struct sgpKernelType<gdtfXDouble> {
+  typedef xdouble value_type;
+  enum { batchEnabled = 0, isInteger = 0 };
+  static value_type getValue(const scDataNode &value) { return value.getAsXDouble(); }
+  static value_type getValue(const sgpTypedRegValue &reg) { return reg.asXDouble; }
+  static value_type &getRef(sgpTypedRegValue &reg) { return reg.asXDouble; }
+  static bool isEqual(value_type a, value_type b) { 
+    return (std::fabs(a - b) < std::numeric_limits<long double>::epsilon()); 
+  }
+};
+
 // ----------------------------------------------------------------------------
 // functions
 // ----------------------------------------------------------------------------
@@ -69,6 +169,37 @@ public:
     m_machine->setLValue(args[0], arg1);
     return true;
   }
+
+  virtual bool hasBatchKernel() const { return true; }
+
+  virtual bool executeBatch(sgpBatchLanes &lanes) const {
+    const double *values;
+    const uint *dataTypes;
+
+    lanes.evaluateArg(1, values, dataTypes);
+    for(uint i=0, epos = lanes.getLaneCount(); i != epos; i++)
+      if (lanes.isActive(i))
+        lanes.setLValue(0, i, values[i], dataTypes[i]);
+    return true;
+  }
+
+  virtual sgpNativeFunc getNativeFunc(const uint *argTypes, uint argCount, uint &outputType) const {
+    if (!isNativeOutputType(argTypes[0], argTypes[1]))
+      return SC_NULL;
+    outputType = argTypes[1];  
+    return &nativeMove;
+  }
+  
+  static uint nativeMove(const sgpNativeInstr &instr) {
+    *instr.args[0] = *instr.args[1];
+    return gnfrNext;
+  }
+
+  virtual int getIdentityArgNo(const scDataNode &args) const { 
+    return 1; 
+  }
+
+  virtual bool canFail() const { return false; }
 };
 
 // init #out : initialize register using zero/empty value 
@@ -246,6 +377,11 @@ class sgpFuncPushNextResult: public sgpFunction {
 public:
   virtual scString getName() const { return "push_next_result"; };
   
+  virtual bool hasSideEffects() const
+  {
+    return true;
+  }
+  
   virtual void getArgCount(uint &a_min, uint &a_max) const { a_min = 0; a_max = 0; }
 
   virtual bool getArgMeta(scDataNode &output) const
@@ -264,6 +400,11 @@ class sgpFuncPush: public sgpFunction {
 public:
   virtual scString getName() const { return "push"; };
 
+  virtual bool hasSideEffects() const
+  {
+    return true;
+  }
+  
 #ifdef ALLOW_INTERBLOCK_DATA_STACK
   virtual bool isStrippable() {
     return false;
@@ -291,6 +432,11 @@ class sgpFuncPop: public sgpFunction {
 public:
   virtual scString getName() const { return "pop"; };
   
+  virtual bool hasSideEffects() const
+  {
+    return true;
+  }
+  
 #ifdef ALLOW_INTERBLOCK_DATA_STACK
   virtual bool isStrippable() {
     return false; // leave pop even the instruction reads something unused
@@ -401,6 +547,11 @@ class sgpFuncDefine: public sgpFunction {
 public:
   virtual scString getName() const { return "define"; };
   
+  virtual bool hasSideEffects() const
+  {
+    return true;
+  }
+  
   virtual void getArgCount(uint &a_min, uint &a_max) const { a_min = 2; a_max = 2; }
 
   virtual bool getArgMeta(scDataNode &output) const
@@ -569,10 +720,10 @@ public:
   }
   
   virtual bool execute(const scDataNode &args) const {
-    scDataNode arg1, arg2;
+    scDataNode temp1, temp2;
     
-    m_machine->evaluateArg(args[1], arg1);
-    m_machine->evaluateArg(args[2], arg2);
+    const scDataNode &arg1 = m_machine->evaluateArgRef(args[1], temp1);
+    const scDataNode &arg2 = m_machine->evaluateArgRef(args[2], temp2);
 
     bool outValue = (arg1.getAsBool() && arg2.getAsBool());
     
@@ -598,10 +749,10 @@ public:
   }
   
   virtual bool execute(const scDataNode &args) const {
-    scDataNode arg1, arg2;
+    scDataNode temp1, temp2;
     
-    m_machine->evaluateArg(args[1], arg1);
-    m_machine->evaluateArg(args[2], arg2);
+    const scDataNode &arg1 = m_machine->evaluateArgRef(args[1], temp1);
+    const scDataNode &arg2 = m_machine->evaluateArgRef(args[2], temp2);
 
     bool outValue = (arg1.getAsBool() || arg2.getAsBool());
     
@@ -627,10 +778,10 @@ public:
   }
   
   virtual bool execute(const scDataNode &args) const {
-    scDataNode arg1, arg2;
+    scDataNode temp1, temp2;
     
-    m_machine->evaluateArg(args[1], arg1);
-    m_machine->evaluateArg(args[2], arg2);
+    const scDataNode &arg1 = m_machine->evaluateArgRef(args[1], temp1);
+    const scDataNode &arg2 = m_machine->evaluateArgRef(args[2], temp2);
 
     bool p = arg1.getAsBool();
     bool q = arg2.getAsBool();
@@ -658,9 +809,9 @@ public:
   }
   
   virtual bool execute(const scDataNode &args) const {
-    scDataNode arg1, arg2;
+    scDataNode temp1;
     
-    m_machine->evaluateArg(args[1], arg1);
+    const scDataNode &arg1 = m_machine->evaluateArgRef(args[1], temp1);
 
     bool outValue = !arg1.getAsBool();
     
@@ -681,10 +832,10 @@ public:
   virtual void getArgCount(uint &a_min, uint &a_max) const { a_min = a_max = 3; }
 
   virtual bool execute(const scDataNode &args) const {
-    scDataNode arg1, arg2, outValue;
+    scDataNode temp1, temp2, outValue;
     
-    m_machine->evaluateArg(args[1], arg1);
-    m_machine->evaluateArg(args[2], arg2);
+    const scDataNode &arg1 = m_machine->evaluateArgRef(args[1], temp1);
+    const scDataNode &arg2 = m_machine->evaluateArgRef(args[2], temp2);
     
     calcValue(arg1, arg2, outValue);
     m_machine->setLValue(args[0], outValue);
@@ -692,12 +843,51 @@ public:
     return true;
   }
   
+  virtual bool executeBatch(sgpBatchLanes &lanes) const {
+    const double *arg1, *arg2;
+    const uint *types1, *types2;
+    double *outValues = lanes.getResultBuffer();
+    
+    lanes.evaluateArg(1, arg1, types1);
+    lanes.evaluateArg(2, arg2, types2);
+    
+    calcBatchValues(arg1, arg2, outValues, lanes.getLaneCount());
+    
+    for(uint i=0, epos = lanes.getLaneCount(); i != epos; i++) {
+      if (!lanes.isActive(i))
+        continue;
+      if (!sgpBatchLanes::isNumericType(types1[i]) || !sgpBatchLanes::isNumericType(types2[i]))
+        lanes.abortLane(i);
+      else    
+        lanes.setLValue(0, i, outValues[i], gdtfBool);
+    }
+    return true;
+  }
+  
   virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const = 0;
   virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const
   {
     bool outValueBool = calcValue(arg1, arg2);
     output = scDataNode(outValueBool);
   }
+  // batch version of calcValue, result for each lane: 1.0 = true, 0.0 = false
+  virtual void calcBatchValues(const double *arg1, const double *arg2, double *output, uint count) const {}
+
+  virtual sgpNativeFunc getNativeFunc(const uint *argTypes, uint argCount, uint &outputType) const {
+    uint dataType = getNativeArgType();
+    
+    if (!isNativeOutputType(argTypes[0], gdtfBool) || (argTypes[1] != dataType) || (argTypes[2] != dataType))
+      return SC_NULL;
+    outputType = gdtfBool;  
+    return getNativeCalcFunc();
+  }
+  
+  virtual bool canFail() const { return false; }
+  
+  // type of input arguments of native version
+  virtual uint getNativeArgType() const { return gdtfNull; }
+  // native version of calcValue
+  virtual sgpNativeFunc getNativeCalcFunc() const { return SC_NULL; }
 };
 
 // equ #out, arg1, arg2: verify arg1 == arg2
@@ -773,6 +963,7 @@ public:
 
 class sgpFuncCompFloat: public sgpFuncEqu {
 public:
+  virtual uint getNativeArgType() const { return gdtfFloat; }
   virtual bool getArgMeta(scDataNode &output) const
   {
     addArgMeta(gatfOutput, gatfLValue, gdtfVariant+gdtfNull+gdtfBool, output);
@@ -784,6 +975,7 @@ public:
 
 class sgpFuncCompDouble: public sgpFuncEqu {
 public:
+  virtual uint getNativeArgType() const { return gdtfDouble; }
   virtual bool getArgMeta(scDataNode &output) const
   {
     addArgMeta(gatfOutput, gatfLValue, gdtfVariant+gdtfNull+gdtfBool, output);
@@ -815,50 +1007,84 @@ public:
   }
 };
 
-//-----
-class sgpFuncEquInt: public sgpFuncCompInt {
+// comparison operations for sgpFuncCompKernel
+template<class Type> struct sgpKernelOpEqu {
+  typedef typename Type::value_type value_type;
+  static bool calc(value_type a, value_type b) { return Type::isEqual(a, b); }
+};
+
+template<class Type> struct sgpKernelOpGt {
+  typedef typename Type::value_type value_type;
+  static bool calc(value_type a, value_type b) { return (a > b); }
+};
+
+template<class Type> struct sgpKernelOpGte {
+  typedef typename Type::value_type value_type;
+  static bool calc(value_type a, value_type b) { return (a >= b); }
+};
+
+template<class Type> struct sgpKernelOpLt {
+  typedef typename Type::value_type value_type;
+  static bool calc(value_type a, value_type b) { return (a < b); }
+};
+
+template<class Type> struct sgpKernelOpLte {
+  typedef typename Type::value_type value_type;
+  static bool calc(value_type a, value_type b) { return (a <= b); }
+};
+
+// comparison for a single data type: scalar, native & batch version generated 
+// from operation, Base defines argument meta
+template<class Base, uint DataType, template<class> class Op>
+class sgpFuncCompKernel: public Base {
 public:
-  virtual scString getName() const { return "equ.int"; };  
+  typedef sgpKernelType<DataType> Type;
+  typedef typename Type::value_type value_type;
+  typedef Op<Type> Oper;
+
+  virtual bool hasBatchKernel() const { return (Type::batchEnabled != 0); }
+  virtual uint getNativeArgType() const { return DataType; }
+  virtual sgpNativeFunc getNativeCalcFunc() const { return &nativeCalc; }
+  static uint nativeCalc(const sgpNativeInstr &instr)
+  {
+    instr.args[0]->asBool = Oper::calc(Type::getValue(*instr.args[1]), Type::getValue(*instr.args[2]));
+    return gnfrNext;
+  }
+  virtual void calcBatchValues(const double *arg1, const double *arg2, double *output, uint count) const
+  {
+    for(uint i=0; i != count; i++)
+      output[i] = (Oper::calc(value_type(arg1[i]), value_type(arg2[i])) ? 1.0 : 0.0);
+  }
   virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const
   {
-    return (arg1.getAsInt() == arg2.getAsInt());
+    return Oper::calc(Type::getValue(arg1), Type::getValue(arg2));
   }    
 };
 
-class sgpFuncEquInt64: public sgpFuncCompInt64 {
+//-----
+class sgpFuncEquInt: public sgpFuncCompKernel<sgpFuncCompInt, gdtfInt, sgpKernelOpEqu> {
+public:
+  virtual scString getName() const { return "equ.int"; };
+};
+
+class sgpFuncEquInt64: public sgpFuncCompKernel<sgpFuncCompInt64, gdtfInt64, sgpKernelOpEqu> {
 public:
   virtual scString getName() const { return "equ.int64"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const
-  {
-    return (arg1.getAsInt64() == arg2.getAsInt64());
-  }    
 };
 
-class sgpFuncEquByte: public sgpFuncCompByte {
+class sgpFuncEquByte: public sgpFuncCompKernel<sgpFuncCompByte, gdtfByte, sgpKernelOpEqu> {
 public:
   virtual scString getName() const { return "equ.byte"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const
-  {
-    return (arg1.getAsByte() == arg2.getAsByte());
-  }    
 };
 
-class sgpFuncEquUInt: public sgpFuncCompUInt {
+class sgpFuncEquUInt: public sgpFuncCompKernel<sgpFuncCompUInt, gdtfUInt, sgpKernelOpEqu> {
 public:
   virtual scString getName() const { return "equ.uint"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const
-  {
-    return (arg1.getAsUInt() == arg2.getAsUInt());
-  }    
 };
 
-class sgpFuncEquUInt64: public sgpFuncCompUInt64 {
+class sgpFuncEquUInt64: public sgpFuncCompKernel<sgpFuncCompUInt64, gdtfUInt64, sgpKernelOpEqu> {
 public:
   virtual scString getName() const { return "equ.uint64"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const
-  {
-    return (arg1.getAsUInt64() == arg2.getAsUInt64());
-  }    
 };
 
 class sgpFuncEquBool: public sgpFuncCompBool {
@@ -870,34 +1096,19 @@ public:
   }    
 };
 
-class sgpFuncEquFloat: public sgpFuncCompFloat {
+class sgpFuncEquFloat: public sgpFuncCompKernel<sgpFuncCompFloat, gdtfFloat, sgpKernelOpEqu> {
 public:
   virtual scString getName() const { return "equ.float"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const
-  {
-    //return (arg1.getAsFloat() == arg2.getAsFloat());
-    return (std::fabs(arg1.getAsFloat() - arg2.getAsFloat()) < std::numeric_limits<float>::epsilon());        
-  }    
 };
 
-class sgpFuncEquDouble: public sgpFuncCompDouble {
+class sgpFuncEquDouble: public sgpFuncCompKernel<sgpFuncCompDouble, gdtfDouble, sgpKernelOpEqu> {
 public:
   virtual scString getName() const { return "equ.double"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const
-  {
-    //return (arg1.getAsDouble() == arg2.getAsDouble());
-    return (std::fabs(arg1.getAsDouble() - arg2.getAsDouble()) < std::numeric_limits<double>::epsilon());        
-  }    
 };
 
-class sgpFuncEquXDouble: public sgpFuncCompXDouble {
+class sgpFuncEquXDouble: public sgpFuncCompKernel<sgpFuncCompXDouble, gdtfXDouble, sgpKernelOpEqu> {
 public:
   virtual scString getName() const { return "equ.xdouble"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const
-  {
-    //return (arg1.getAsXDouble() == arg2.getAsXDouble());
-    return (std::fabs(arg1.getAsXDouble() - arg2.getAsXDouble()) < std::numeric_limits<long double>::epsilon());        
-  }    
 };
 
 class sgpFuncEquString: public sgpFuncCompString {
@@ -915,49 +1126,29 @@ public:
 };  
 
 //----------------------------------------------------------------------------
-class sgpFuncGtInt: public sgpFuncCompInt {
+class sgpFuncGtInt: public sgpFuncCompKernel<sgpFuncCompInt, gdtfInt, sgpKernelOpGt> {
 public:
-  virtual scString getName() const { return "gt.int"; };  
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const
-  {
-    return (arg1.getAsInt() > arg2.getAsInt());
-  }    
+  virtual scString getName() const { return "gt.int"; };
 };
 
-class sgpFuncGtInt64: public sgpFuncCompInt64 {
+class sgpFuncGtInt64: public sgpFuncCompKernel<sgpFuncCompInt64, gdtfInt64, sgpKernelOpGt> {
 public:
   virtual scString getName() const { return "gt.int64"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const
-  {
-    return (arg1.getAsInt64() > arg2.getAsInt64());
-  }    
 };
 
-class sgpFuncGtByte: public sgpFuncCompByte {
+class sgpFuncGtByte: public sgpFuncCompKernel<sgpFuncCompByte, gdtfByte, sgpKernelOpGt> {
 public:
   virtual scString getName() const { return "gt.byte"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const
-  {
-    return (arg1.getAsByte() > arg2.getAsByte());
-  }    
 };
 
-class sgpFuncGtUInt: public sgpFuncCompUInt {
+class sgpFuncGtUInt: public sgpFuncCompKernel<sgpFuncCompUInt, gdtfUInt, sgpKernelOpGt> {
 public:
   virtual scString getName() const { return "gt.uint"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsUInt() > arg2.getAsUInt());
-  }    
 };
 
-class sgpFuncGtUInt64: public sgpFuncCompUInt64 {
+class sgpFuncGtUInt64: public sgpFuncCompKernel<sgpFuncCompUInt64, gdtfUInt64, sgpKernelOpGt> {
 public:
   virtual scString getName() const { return "gt.uint64"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsUInt64() > arg2.getAsUInt64());
-  }    
 };
 
 class sgpFuncGtBool: public sgpFuncCompBool {
@@ -969,31 +1160,19 @@ public:
   }    
 };
 
-class sgpFuncGtFloat: public sgpFuncCompFloat {
+class sgpFuncGtFloat: public sgpFuncCompKernel<sgpFuncCompFloat, gdtfFloat, sgpKernelOpGt> {
 public:
   virtual scString getName() const { return "gt.float"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsFloat() > arg2.getAsFloat());
-  }    
 };
 
-class sgpFuncGtDouble: public sgpFuncCompDouble {
+class sgpFuncGtDouble: public sgpFuncCompKernel<sgpFuncCompDouble, gdtfDouble, sgpKernelOpGt> {
 public:
   virtual scString getName() const { return "gt.double"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsDouble() > arg2.getAsDouble());
-  }    
 };
 
-class sgpFuncGtXDouble: public sgpFuncCompXDouble {
+class sgpFuncGtXDouble: public sgpFuncCompKernel<sgpFuncCompXDouble, gdtfXDouble, sgpKernelOpGt> {
 public:
   virtual scString getName() const { return "gt.xdouble"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsXDouble() > arg2.getAsXDouble());
-  }    
 };
 
 class sgpFuncGtString: public sgpFuncCompString {
@@ -1011,49 +1190,29 @@ public:
 };  
 
 //----------------------------------------------------------------------------
-class sgpFuncGteInt: public sgpFuncCompInt {
+class sgpFuncGteInt: public sgpFuncCompKernel<sgpFuncCompInt, gdtfInt, sgpKernelOpGte> {
 public:
-  virtual scString getName() const { return "gte.int"; };  
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsInt() >= arg2.getAsInt());
-  }    
+  virtual scString getName() const { return "gte.int"; };
 };
 
-class sgpFuncGteInt64: public sgpFuncCompInt64 {
+class sgpFuncGteInt64: public sgpFuncCompKernel<sgpFuncCompInt64, gdtfInt64, sgpKernelOpGte> {
 public:
   virtual scString getName() const { return "gte.int64"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsInt64() >= arg2.getAsInt64());
-  }    
 };
 
-class sgpFuncGteByte: public sgpFuncCompByte {
+class sgpFuncGteByte: public sgpFuncCompKernel<sgpFuncCompByte, gdtfByte, sgpKernelOpGte> {
 public:
   virtual scString getName() const { return "gte.byte"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsByte() >= arg2.getAsByte());
-  }    
 };
 
-class sgpFuncGteUInt: public sgpFuncCompUInt {
+class sgpFuncGteUInt: public sgpFuncCompKernel<sgpFuncCompUInt, gdtfUInt, sgpKernelOpGte> {
 public:
   virtual scString getName() const { return "gte.uint"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsUInt() >= arg2.getAsUInt());
-  }    
 };
 
-class sgpFuncGteUInt64: public sgpFuncCompUInt64 {
+class sgpFuncGteUInt64: public sgpFuncCompKernel<sgpFuncCompUInt64, gdtfUInt64, sgpKernelOpGte> {
 public:
   virtual scString getName() const { return "gte.uint64"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsUInt64() >= arg2.getAsUInt64());
-  }    
 };
 
 class sgpFuncGteBool: public sgpFuncCompBool {
@@ -1065,31 +1224,19 @@ public:
   }    
 };
 
-class sgpFuncGteFloat: public sgpFuncCompFloat {
+class sgpFuncGteFloat: public sgpFuncCompKernel<sgpFuncCompFloat, gdtfFloat, sgpKernelOpGte> {
 public:
   virtual scString getName() const { return "gte.float"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsFloat() >= arg2.getAsFloat());
-  }    
 };
 
-class sgpFuncGteDouble: public sgpFuncCompDouble {
+class sgpFuncGteDouble: public sgpFuncCompKernel<sgpFuncCompDouble, gdtfDouble, sgpKernelOpGte> {
 public:
   virtual scString getName() const { return "gte.double"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsDouble() >= arg2.getAsDouble());
-  }    
 };
 
-class sgpFuncGteXDouble: public sgpFuncCompXDouble {
+class sgpFuncGteXDouble: public sgpFuncCompKernel<sgpFuncCompXDouble, gdtfXDouble, sgpKernelOpGte> {
 public:
   virtual scString getName() const { return "gte.xdouble"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsXDouble() >= arg2.getAsXDouble());
-  }    
 };
 
 class sgpFuncGteString: public sgpFuncCompString {
@@ -1107,49 +1254,29 @@ public:
 };  
 
 //----------------------------------------------------------------------------
-class sgpFuncLtInt: public sgpFuncCompInt {
+class sgpFuncLtInt: public sgpFuncCompKernel<sgpFuncCompInt, gdtfInt, sgpKernelOpLt> {
 public:
-  virtual scString getName() const { return "lt.int"; };  
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsInt() < arg2.getAsInt());
-  }    
+  virtual scString getName() const { return "lt.int"; };
 };
 
-class sgpFuncLtInt64: public sgpFuncCompInt64 {
+class sgpFuncLtInt64: public sgpFuncCompKernel<sgpFuncCompInt64, gdtfInt64, sgpKernelOpLt> {
 public:
   virtual scString getName() const { return "lt.int64"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsInt64() < arg2.getAsInt64());
-  }    
 };
 
-class sgpFuncLtByte: public sgpFuncCompByte {
+class sgpFuncLtByte: public sgpFuncCompKernel<sgpFuncCompByte, gdtfByte, sgpKernelOpLt> {
 public:
   virtual scString getName() const { return "lt.byte"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsByte() < arg2.getAsByte());
-  }    
 };
 
-class sgpFuncLtUInt: public sgpFuncCompUInt {
+class sgpFuncLtUInt: public sgpFuncCompKernel<sgpFuncCompUInt, gdtfUInt, sgpKernelOpLt> {
 public:
   virtual scString getName() const { return "lt.uint"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsUInt() < arg2.getAsUInt());
-  }    
 };
 
-class sgpFuncLtUInt64: public sgpFuncCompUInt64 {
+class sgpFuncLtUInt64: public sgpFuncCompKernel<sgpFuncCompUInt64, gdtfUInt64, sgpKernelOpLt> {
 public:
   virtual scString getName() const { return "lt.uint64"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsUInt64() < arg2.getAsUInt64());
-  }    
 };
 
 class sgpFuncLtBool: public sgpFuncCompBool {
@@ -1161,31 +1288,19 @@ public:
   }    
 };
 
-class sgpFuncLtFloat: public sgpFuncCompFloat {
+class sgpFuncLtFloat: public sgpFuncCompKernel<sgpFuncCompFloat, gdtfFloat, sgpKernelOpLt> {
 public:
   virtual scString getName() const { return "lt.float"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsFloat() < arg2.getAsFloat());
-  }    
 };
 
-class sgpFuncLtDouble: public sgpFuncCompDouble {
+class sgpFuncLtDouble: public sgpFuncCompKernel<sgpFuncCompDouble, gdtfDouble, sgpKernelOpLt> {
 public:
   virtual scString getName() const { return "lt.double"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsDouble() < arg2.getAsDouble());
-  }    
 };
 
-class sgpFuncLtXDouble: public sgpFuncCompXDouble {
+class sgpFuncLtXDouble: public sgpFuncCompKernel<sgpFuncCompXDouble, gdtfXDouble, sgpKernelOpLt> {
 public:
   virtual scString getName() const { return "lt.xdouble"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsXDouble() < arg2.getAsXDouble());
-  }    
 };
 
 class sgpFuncLtString: public sgpFuncCompString {
@@ -1203,49 +1318,29 @@ public:
 };  
 
 //----------------------------------------------------------------------------
-class sgpFuncLteInt: public sgpFuncCompInt {
+class sgpFuncLteInt: public sgpFuncCompKernel<sgpFuncCompInt, gdtfInt, sgpKernelOpLte> {
 public:
-  virtual scString getName() const { return "lse.int"; };  
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsInt() <= arg2.getAsInt());
-  }    
+  virtual scString getName() const { return "lse.int"; };
 };
 
-class sgpFuncLteInt64: public sgpFuncCompInt64 {
+class sgpFuncLteInt64: public sgpFuncCompKernel<sgpFuncCompInt64, gdtfInt64, sgpKernelOpLte> {
 public:
   virtual scString getName() const { return "lse.int64"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsInt64() <= arg2.getAsInt64());
-  }    
 };
 
-class sgpFuncLteByte: public sgpFuncCompByte {
+class sgpFuncLteByte: public sgpFuncCompKernel<sgpFuncCompByte, gdtfByte, sgpKernelOpLte> {
 public:
   virtual scString getName() const { return "lse.byte"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsByte() <= arg2.getAsByte());
-  }    
 };
 
-class sgpFuncLteUInt: public sgpFuncCompUInt {
+class sgpFuncLteUInt: public sgpFuncCompKernel<sgpFuncCompUInt, gdtfUInt, sgpKernelOpLte> {
 public:
   virtual scString getName() const { return "lse.uint"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsUInt() <= arg2.getAsUInt());
-  }    
 };
 
-class sgpFuncLteUInt64: public sgpFuncCompUInt64 {
+class sgpFuncLteUInt64: public sgpFuncCompKernel<sgpFuncCompUInt64, gdtfUInt64, sgpKernelOpLte> {
 public:
   virtual scString getName() const { return "lse.uint64"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsUInt64() <= arg2.getAsUInt64());
-  }    
 };
 
 class sgpFuncLteBool: public sgpFuncCompBool {
@@ -1257,31 +1352,19 @@ public:
   }    
 };
 
-class sgpFuncLteFloat: public sgpFuncCompFloat {
+class sgpFuncLteFloat: public sgpFuncCompKernel<sgpFuncCompFloat, gdtfFloat, sgpKernelOpLte> {
 public:
   virtual scString getName() const { return "lse.float"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsFloat() <= arg2.getAsFloat());
-  }    
 };
 
-class sgpFuncLteDouble: public sgpFuncCompDouble {
+class sgpFuncLteDouble: public sgpFuncCompKernel<sgpFuncCompDouble, gdtfDouble, sgpKernelOpLte> {
 public:
   virtual scString getName() const { return "lse.double"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsDouble() <= arg2.getAsDouble());
-  }    
 };
 
-class sgpFuncLteXDouble: public sgpFuncCompXDouble {
+class sgpFuncLteXDouble: public sgpFuncCompKernel<sgpFuncCompXDouble, gdtfXDouble, sgpKernelOpLte> {
 public:
   virtual scString getName() const { return "lse.xdouble"; };
-  virtual bool calcValue(const scDataNode &arg1, const scDataNode &arg2) const 
-  {
-    return (arg1.getAsXDouble() <= arg2.getAsXDouble());
-  }    
 };
 
 class sgpFuncLteString: public sgpFuncCompString {
@@ -1538,9 +1621,9 @@ public:
   virtual void getArgCount(uint &a_min, uint &a_max) const { a_min = a_max = 2; }
 
   virtual bool execute(const scDataNode &args) const {
-    scDataNode arg1, outValue;
+    scDataNode temp1, outValue;
     bool res;
-    m_machine->evaluateArg(args[1], arg1);
+    const scDataNode &arg1 = m_machine->evaluateArgRef(args[1], temp1);
     
     res = checkArgs(arg1);
     
@@ -1554,6 +1637,18 @@ public:
   
   virtual bool checkArgs(const scDataNode &arg1) const {return true;}
   virtual void calcValue(const scDataNode &arg1, scDataNode &output) const = 0;
+
+  virtual bool foldConstArgs(const scDataNode &args, scDataNode &output) const {
+    if (!isConstFoldable() || (args.size() != 2) || !isFoldableConstArg(args[1]))
+      return false;
+    calcValue(args[1], output);  
+    return true;
+  }
+  
+  virtual bool canFail() const { return !isConstFoldable(); }
+  
+  // returns <true> if calcValue has no side effects & never fails (checkArgs not used)
+  virtual bool isConstFoldable() const { return false; }
 };
 
 // generic arithmetic, 2-input argument function
@@ -1562,11 +1657,11 @@ public:
   virtual void getArgCount(uint &a_min, uint &a_max) const { a_min = a_max = 3; }
 
   virtual bool execute(const scDataNode &args) const {
-    scDataNode arg1, arg2, outValue;
+    scDataNode temp1, temp2, outValue;
     bool res;
     
-    m_machine->evaluateArg(args[1], arg1);
-    m_machine->evaluateArg(args[2], arg2);
+    const scDataNode &arg1 = m_machine->evaluateArgRef(args[1], temp1);
+    const scDataNode &arg2 = m_machine->evaluateArgRef(args[2], temp2);
     
     res = checkArgs(arg1, arg2);
     
@@ -1578,8 +1673,77 @@ public:
     return res;
   }
   
+  virtual bool executeBatch(sgpBatchLanes &lanes) const {
+    const double *arg1, *arg2;
+    const uint *types1, *types2;
+    double *outValues = lanes.getResultBuffer();
+    uint outType = getBatchOutputType();
+    
+    lanes.evaluateArg(1, arg1, types1);
+    lanes.evaluateArg(2, arg2, types2);
+    
+    calcBatchValues(arg1, arg2, outValues, lanes.getLaneCount());
+    
+    for(uint i=0, epos = lanes.getLaneCount(); i != epos; i++) {
+      if (!lanes.isActive(i))
+        continue;
+      if (!sgpBatchLanes::isNumericType(types1[i]) || !sgpBatchLanes::isNumericType(types2[i]))
+        lanes.abortLane(i);
+      else if (!checkBatchArgs(arg1[i], arg2[i]))
+        lanes.failLane(i);
+      else    
+        lanes.setLValue(0, i, outValues[i], outType);
+    }
+    return true;
+  }
+  
   virtual bool checkArgs(const scDataNode &arg1, const scDataNode &arg2) const {return true;}
   virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const = 0;
+
+  virtual bool foldConstArgs(const scDataNode &args, scDataNode &output) const {
+    if (!isConstFoldable() || (args.size() != 3) || !isFoldableConstArg(args[1]) || !isFoldableConstArg(args[2]))
+      return false;
+    calcValue(args[1], args[2], output);  
+    return true;
+  }
+  
+  virtual int getIdentityArgNo(const scDataNode &args) const {
+    if (args.size() != 3)
+      return -1;
+    if (isFoldableConstArg(args[2]) && isRightNeutral(args[2]))
+      return 1;
+    if (isFoldableConstArg(args[1]) && isLeftNeutral(args[1]))
+      return 2;
+    return -1;  
+  }
+  
+  virtual bool canFail() const { return !isConstFoldable(); }
+  
+  // returns <true> if calcValue has no side effects & never fails (checkArgs not used)
+  virtual bool isConstFoldable() const { return false; }
+  // returns <true> if f(value, x) = x
+  virtual bool isLeftNeutral(const scDataNode &value) const { return false; }
+  // returns <true> if f(x, value) = x
+  virtual bool isRightNeutral(const scDataNode &value) const { return false; }
+  // batch version of checkArgs & calcValue, calculated for all lanes
+  virtual bool checkBatchArgs(double arg1, double arg2) const {return true;}
+  virtual void calcBatchValues(const double *arg1, const double *arg2, double *output, uint count) const {}
+  virtual uint getBatchOutputType() const { return gdtfNull; }
+  // data type of arguments & result of native version
+  virtual uint getNativeOutputType() const { return getBatchOutputType(); }
+
+  // native version is available for arguments of output type only
+  virtual sgpNativeFunc getNativeFunc(const uint *argTypes, uint argCount, uint &outputType) const {
+    uint dataType = getNativeOutputType();
+    
+    if (!isNativeOutputType(argTypes[0], dataType) || (argTypes[1] != dataType) || (argTypes[2] != dataType))
+      return SC_NULL;
+    outputType = dataType;  
+    return getNativeCalcFunc();
+  }
+  
+  // native version of checkArgs & calcValue
+  virtual sgpNativeFunc getNativeCalcFunc() const { return SC_NULL; }
 };
 
 //----------------------------------------------------------------------------
@@ -1721,6 +1885,7 @@ public:
 
 class sgpFuncArith2aFloat: public sgpFuncArith2a {
 public:
+  virtual uint getBatchOutputType() const { return gdtfFloat; }
   virtual bool getArgMeta(scDataNode &output) const
   {
     addArgMeta(gatfOutput, gatfLValue, gdtfVariant+gdtfNull+gdtfFloat, output);
@@ -1732,6 +1897,7 @@ public:
 
 class sgpFuncArith2aDouble: public sgpFuncArith2a {
 public:
+  virtual uint getBatchOutputType() const { return gdtfDouble; }
   virtual bool getArgMeta(scDataNode &output) const
   {
     addArgMeta(gatfOutput, gatfLValue, gdtfVariant+gdtfNull+gdtfDouble, output);
@@ -1760,12 +1926,12 @@ public:
   virtual void getArgCount(uint &a_min, uint &a_max) const { a_min = a_max = 4; }
 
   virtual bool execute(const scDataNode &args) const {
-    scDataNode arg1, arg2, arg3, outValue;
+    scDataNode temp1, temp2, temp3, outValue;
     bool res;
     
-    m_machine->evaluateArg(args[1], arg1);
-    m_machine->evaluateArg(args[2], arg2);
-    m_machine->evaluateArg(args[3], arg3);
+    const scDataNode &arg1 = m_machine->evaluateArgRef(args[1], temp1);
+    const scDataNode &arg2 = m_machine->evaluateArgRef(args[2], temp2);
+    const scDataNode &arg3 = m_machine->evaluateArgRef(args[3], temp3);
 
     res = checkArgs(arg1, arg2, arg3);
     
@@ -1881,416 +2047,253 @@ public:
 
 //----------------------------------------------------------------------------
 
-//-------  ADD
-class sgpFuncAddInt: public sgpFuncArith2aInt {
+// arithmetic operations for sgpFuncArith2aKernel
+// canFail: isValidArg2 has to be verified before calc
+template<class Type> struct sgpKernelOpAdd {
+  typedef typename Type::value_type value_type;
+  enum { canFail = 0 };
+  static value_type calc(value_type a, value_type b) { return value_type(a + b); }
+  static bool isValidArg2(value_type b) { return true; }
+  static bool isLeftNeutral(value_type value) { return (Type::isInteger != 0) && (value == 0); }
+  static bool isRightNeutral(value_type value) { return (Type::isInteger != 0) && (value == 0); }
+};
+
+template<class Type> struct sgpKernelOpSub {
+  typedef typename Type::value_type value_type;
+  enum { canFail = 0 };
+  static value_type calc(value_type a, value_type b) { return value_type(a - b); }
+  static bool isValidArg2(value_type b) { return true; }
+  static bool isLeftNeutral(value_type value) { return false; }
+  static bool isRightNeutral(value_type value) { return (Type::isInteger != 0) && (value == 0); }
+};
+
+template<class Type> struct sgpKernelOpMult {
+  typedef typename Type::value_type value_type;
+  enum { canFail = 0 };
+  static value_type calc(value_type a, value_type b) { return value_type(a * b); }
+  static bool isValidArg2(value_type b) { return true; }
+  static bool isLeftNeutral(value_type value) { return (value == 1); }
+  static bool isRightNeutral(value_type value) { return (value == 1); }
+};
+
+template<class Type> struct sgpKernelOpDiv {
+  typedef typename Type::value_type value_type;
+  enum { canFail = 1 };
+  static value_type calc(value_type a, value_type b) { return value_type(a / b); }
+  static bool isValidArg2(value_type b) { return (b != 0); }
+  static bool isLeftNeutral(value_type value) { return false; }
+  static bool isRightNeutral(value_type value) { return (value == 1); }
+};
+
+// arithmetic function for a single data type: scalar, native & batch version 
+// generated from operation, Base defines argument meta & batch output type
+template<class Base, uint DataType, template<class> class Op>
+class sgpFuncArith2aKernel: public Base {
 public:
-  virtual scString getName() const { return "add.int"; };
+  typedef sgpKernelType<DataType> Type;
+  typedef typename Type::value_type value_type;
+  typedef Op<Type> Oper;
+
+  virtual bool isConstFoldable() const { return (Oper::canFail == 0); }
+  virtual bool isLeftNeutral(const scDataNode &value) const { return Oper::isLeftNeutral(Type::getValue(value)); }
+  virtual bool isRightNeutral(const scDataNode &value) const { return Oper::isRightNeutral(Type::getValue(value)); }
+  virtual bool hasBatchKernel() const { return (Type::batchEnabled != 0); }
+  virtual uint getNativeOutputType() const { return DataType; }
+  virtual sgpNativeFunc getNativeCalcFunc() const { return &nativeCalc; }
+  static uint nativeCalc(const sgpNativeInstr &instr)
+  {
+    value_type arg2 = Type::getValue(*instr.args[2]);
+    if (!Oper::isValidArg2(arg2))
+      return gnfrFailed;
+    Type::getRef(*instr.args[0]) = Oper::calc(Type::getValue(*instr.args[1]), arg2);
+    return gnfrNext;
+  }
+  virtual void calcBatchValues(const double *arg1, const double *arg2, double *output, uint count) const
+  {
+    for(uint i=0; i != count; i++)
+      output[i] = Oper::calc(value_type(arg1[i]), value_type(arg2[i]));
+  }
+  virtual bool checkBatchArgs(double arg1, double arg2) const
+  {
+    return Oper::isValidArg2(value_type(arg2));
+  }
   virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const 
   {
-    output.copyValueFrom(scDataNode( 
-      int(arg1.getAsInt() + 
-          arg2.getAsInt())));
+    output.copyValueFrom(scDataNode(Oper::calc(Type::getValue(arg1), Type::getValue(arg2))));
   }
+  virtual bool checkArgs(const scDataNode &arg1, const scDataNode &arg2) const
+  {
+    if (Oper::canFail == 0)
+      return true;
+    bool res = Oper::isValidArg2(Type::getValue(arg2));
+    if (!res) 
+      this->m_machine->handleInstrError(this->getName(), arg2, GVM_ERROR_ARITH_DIV_BY_ZERO);    
+    return res;
+  }
+};
+
+//-------  ADD
+class sgpFuncAddInt: public sgpFuncArith2aKernel<sgpFuncArith2aInt, gdtfInt, sgpKernelOpAdd> {
+public:
+  virtual scString getName() const { return "add.int"; };
 };
 
-class sgpFuncAddInt64: public sgpFuncArith2aInt64 {
+class sgpFuncAddInt64: public sgpFuncArith2aKernel<sgpFuncArith2aInt64, gdtfInt64, sgpKernelOpAdd> {
 public:
   virtual scString getName() const { return "add.int64"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const 
-  {
-    output.copyValueFrom(scDataNode( 
-      long64(arg1.getAsInt64() + 
-             arg2.getAsInt64())));
-  }
 };
 
-class sgpFuncAddByte: public sgpFuncArith2aByte {
+class sgpFuncAddByte: public sgpFuncArith2aKernel<sgpFuncArith2aByte, gdtfByte, sgpKernelOpAdd> {
 public:
   virtual scString getName() const { return "add.byte"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const 
-  {
-    output.copyValueFrom(scDataNode( 
-      byte(arg1.getAsByte() + 
-           arg2.getAsByte())));
-  }
 };
 
-class sgpFuncAddUInt: public sgpFuncArith2aUInt {
+class sgpFuncAddUInt: public sgpFuncArith2aKernel<sgpFuncArith2aUInt, gdtfUInt, sgpKernelOpAdd> {
 public:
   virtual scString getName() const { return "add.uint"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const 
-  {
-    output.copyValueFrom(scDataNode( 
-      uint(arg1.getAsUInt() + 
-           arg2.getAsUInt())));
-  }
 };
 
-class sgpFuncAddUInt64: public sgpFuncArith2aUInt64 {
+class sgpFuncAddUInt64: public sgpFuncArith2aKernel<sgpFuncArith2aUInt64, gdtfUInt64, sgpKernelOpAdd> {
 public:
   virtual scString getName() const { return "add.uint64"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const 
-  {
-    output.copyValueFrom(scDataNode( 
-      ulong64(arg1.getAsUInt64() + 
-              arg2.getAsUInt64())));
-  }
 };
 
-class sgpFuncAddFloat: public sgpFuncArith2aFloat {
+class sgpFuncAddFloat: public sgpFuncArith2aKernel<sgpFuncArith2aFloat, gdtfFloat, sgpKernelOpAdd> {
 public:
   virtual scString getName() const { return "add.float"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const 
-  {
-    output.copyValueFrom(scDataNode( 
-      float(arg1.getAsFloat() + 
-            arg2.getAsFloat())));
-  }
 };
 
-class sgpFuncAddDouble: public sgpFuncArith2aDouble {
+class sgpFuncAddDouble: public sgpFuncArith2aKernel<sgpFuncArith2aDouble, gdtfDouble, sgpKernelOpAdd> {
 public:
   virtual scString getName() const { return "add.double"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const 
-  {
-    output.copyValueFrom(scDataNode( 
-      double(arg1.getAsDouble() + 
-             arg2.getAsDouble())));
-  }
 };
 
-class sgpFuncAddXDouble: public sgpFuncArith2aXDouble {
+class sgpFuncAddXDouble: public sgpFuncArith2aKernel<sgpFuncArith2aXDouble, gdtfXDouble, sgpKernelOpAdd> {
 public:
   virtual scString getName() const { return "add.xdouble"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const 
-  {
-    output.copyValueFrom(scDataNode( 
-      xdouble(arg1.getAsXDouble() + 
-              arg2.getAsXDouble())));
-  }
 };
 
 //------ SUB
-class sgpFuncSubInt: public sgpFuncArith2aInt {
+class sgpFuncSubInt: public sgpFuncArith2aKernel<sgpFuncArith2aInt, gdtfInt, sgpKernelOpSub> {
 public:
   virtual scString getName() const { return "sub.int"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const 
-  {
-    output.copyValueFrom(scDataNode(
-      int(arg1.getAsInt() - 
-          arg2.getAsInt())));
-  }
 };
 
-class sgpFuncSubInt64: public sgpFuncArith2aInt64 {
+class sgpFuncSubInt64: public sgpFuncArith2aKernel<sgpFuncArith2aInt64, gdtfInt64, sgpKernelOpSub> {
 public:
   virtual scString getName() const { return "sub.int64"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const 
-  {
-    output.copyValueFrom(scDataNode( 
-      long64(arg1.getAsInt64() - 
-             arg2.getAsInt64())));
-  }
 };
 
-class sgpFuncSubByte: public sgpFuncArith2aByte {
+class sgpFuncSubByte: public sgpFuncArith2aKernel<sgpFuncArith2aByte, gdtfByte, sgpKernelOpSub> {
 public:
   virtual scString getName() const { return "sub.byte"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const 
-  {
-    output.copyValueFrom(scDataNode(
-      byte(arg1.getAsByte() - 
-           arg2.getAsByte())));
-  }
 };
 
-class sgpFuncSubUInt: public sgpFuncArith2aUInt {
+class sgpFuncSubUInt: public sgpFuncArith2aKernel<sgpFuncArith2aUInt, gdtfUInt, sgpKernelOpSub> {
 public:
   virtual scString getName() const { return "sub.uint"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const 
-  {
-    output.copyValueFrom(scDataNode( 
-      uint(arg1.getAsUInt() - 
-           arg2.getAsUInt())));
-  }
 };
 
-class sgpFuncSubUInt64: public sgpFuncArith2aUInt64 {
+class sgpFuncSubUInt64: public sgpFuncArith2aKernel<sgpFuncArith2aUInt64, gdtfUInt64, sgpKernelOpSub> {
 public:
   virtual scString getName() const { return "sub.uint64"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const 
-  {
-    output.copyValueFrom(scDataNode( 
-      ulong64(arg1.getAsUInt64() - 
-              arg2.getAsUInt64())));
-  }
 };
 
-class sgpFuncSubFloat: public sgpFuncArith2aFloat {
+class sgpFuncSubFloat: public sgpFuncArith2aKernel<sgpFuncArith2aFloat, gdtfFloat, sgpKernelOpSub> {
 public:
   virtual scString getName() const { return "sub.float"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const 
-  {
-    output.copyValueFrom(scDataNode(
-      float(arg1.getAsFloat() - 
-            arg2.getAsFloat())));
-  }
 };
 
-class sgpFuncSubDouble: public sgpFuncArith2aDouble {
+class sgpFuncSubDouble: public sgpFuncArith2aKernel<sgpFuncArith2aDouble, gdtfDouble, sgpKernelOpSub> {
 public:
   virtual scString getName() const { return "sub.double"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const 
-  {
-    output.copyValueFrom(scDataNode( 
-      double(arg1.getAsDouble() - 
-             arg2.getAsDouble())));
-  }
 };
 
-class sgpFuncSubXDouble: public sgpFuncArith2aXDouble {
+class sgpFuncSubXDouble: public sgpFuncArith2aKernel<sgpFuncArith2aXDouble, gdtfXDouble, sgpKernelOpSub> {
 public:
   virtual scString getName() const { return "sub.xdouble"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const
-  {
-    output.copyValueFrom(scDataNode( 
-      xdouble(arg1.getAsXDouble() - 
-              arg2.getAsXDouble())));
-  }
 };
 
 //------ MULT
-class sgpFuncMultInt: public sgpFuncArith2aInt {
+class sgpFuncMultInt: public sgpFuncArith2aKernel<sgpFuncArith2aInt, gdtfInt, sgpKernelOpMult> {
 public:
   virtual scString getName() const { return "mult.int"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const
-  {
-    output.copyValueFrom(scDataNode(
-      int(arg1.getAsInt() * 
-          arg2.getAsInt())));
-  }
 };
 
-class sgpFuncMultInt64: public sgpFuncArith2aInt64 {
+class sgpFuncMultInt64: public sgpFuncArith2aKernel<sgpFuncArith2aInt64, gdtfInt64, sgpKernelOpMult> {
 public:
   virtual scString getName() const { return "mult.int64"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const
-  {
-    output.copyValueFrom(scDataNode( 
-      long64(arg1.getAsInt64() * 
-             arg2.getAsInt64())));
-  }
 };
 
-class sgpFuncMultByte: public sgpFuncArith2aByte {
+class sgpFuncMultByte: public sgpFuncArith2aKernel<sgpFuncArith2aByte, gdtfByte, sgpKernelOpMult> {
 public:
   virtual scString getName() const { return "mult.byte"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const
-  {
-    output.copyValueFrom(scDataNode(
-      byte(arg1.getAsByte() * 
-           arg2.getAsByte())));
-  }
 };
 
-class sgpFuncMultUInt: public sgpFuncArith2aUInt {
+class sgpFuncMultUInt: public sgpFuncArith2aKernel<sgpFuncArith2aUInt, gdtfUInt, sgpKernelOpMult> {
 public:
   virtual scString getName() const { return "mult.uint"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const
-  {
-    output.copyValueFrom(scDataNode(
-      uint(arg1.getAsUInt() * 
-           arg2.getAsUInt())));
-  }
 };
 
-class sgpFuncMultUInt64: public sgpFuncArith2aUInt64 {
+class sgpFuncMultUInt64: public sgpFuncArith2aKernel<sgpFuncArith2aUInt64, gdtfUInt64, sgpKernelOpMult> {
 public:
   virtual scString getName() const { return "mult.uint64"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const
-  {
-    output.copyValueFrom(scDataNode( 
-      ulong64(arg1.getAsUInt64() * 
-              arg2.getAsUInt64())));
-  }
 };
 
-class sgpFuncMultFloat: public sgpFuncArith2aFloat {
+class sgpFuncMultFloat: public sgpFuncArith2aKernel<sgpFuncArith2aFloat, gdtfFloat, sgpKernelOpMult> {
 public:
   virtual scString getName() const { return "mult.float"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const
-  {
-    output.copyValueFrom(scDataNode( 
-      float(arg1.getAsFloat() * 
-            arg2.getAsFloat())));
-  }
 };
 
-class sgpFuncMultDouble: public sgpFuncArith2aDouble {
+class sgpFuncMultDouble: public sgpFuncArith2aKernel<sgpFuncArith2aDouble, gdtfDouble, sgpKernelOpMult> {
 public:
   virtual scString getName() const { return "mult.double"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const
-  {
-    output.copyValueFrom(scDataNode( 
-      double(arg1.getAsDouble() * 
-             arg2.getAsDouble())));
-  }
 };
 
-class sgpFuncMultXDouble: public sgpFuncArith2aXDouble {
+class sgpFuncMultXDouble: public sgpFuncArith2aKernel<sgpFuncArith2aXDouble, gdtfXDouble, sgpKernelOpMult> {
 public:
   virtual scString getName() const { return "mult.xdouble"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const
-  {
-    output.copyValueFrom(scDataNode( 
-      xdouble(arg1.getAsXDouble() * 
-              arg2.getAsXDouble())));
-  }
 };
 
 //------ DIV
-class sgpFuncDivInt: public sgpFuncArith2aInt {
+class sgpFuncDivInt: public sgpFuncArith2aKernel<sgpFuncArith2aInt, gdtfInt, sgpKernelOpDiv> {
 public:
   virtual scString getName() const { return "div.int"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const
-  {
-    output.copyValueFrom(scDataNode( 
-      int(arg1.getAsInt() / 
-          arg2.getAsInt())));
-  }
-  virtual bool checkArgs(const scDataNode &arg1, const scDataNode &arg2) const
-  {
-    bool res = (arg2.getAsInt() != 0);
-    if (!res) 
-      m_machine->handleInstrError(getName(), arg2, GVM_ERROR_ARITH_DIV_BY_ZERO);    
-    return res;
-  }
 };
 
-class sgpFuncDivInt64: public sgpFuncArith2aInt64 {
+class sgpFuncDivInt64: public sgpFuncArith2aKernel<sgpFuncArith2aInt64, gdtfInt64, sgpKernelOpDiv> {
 public:
   virtual scString getName() const { return "div.int64"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const
-  {
-    output.copyValueFrom(scDataNode( 
-      long64(arg1.getAsInt64() / 
-             arg2.getAsInt64())));
-  }
-  virtual bool checkArgs(const scDataNode &arg1, const scDataNode &arg2) const
-  {
-    bool res = (arg2.getAsInt64() != 0);
-    if (!res) 
-      m_machine->handleInstrError(getName(), arg2, GVM_ERROR_ARITH_DIV_BY_ZERO);    
-    return res;
-  }
 };
 
-class sgpFuncDivByte: public sgpFuncArith2aByte {
+class sgpFuncDivByte: public sgpFuncArith2aKernel<sgpFuncArith2aByte, gdtfByte, sgpKernelOpDiv> {
 public:
   virtual scString getName() const { return "div.byte"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const
-  {
-    output.copyValueFrom(scDataNode( 
-      byte(arg1.getAsByte() / 
-           arg2.getAsByte())));
-  }
-  virtual bool checkArgs(const scDataNode &arg1, const scDataNode &arg2) const
-  {
-    bool res = (arg2.getAsByte() != 0);
-    if (!res) 
-      m_machine->handleInstrError(getName(), arg2, GVM_ERROR_ARITH_DIV_BY_ZERO);    
-    return res;
-  }
 };
 
-class sgpFuncDivUInt: public sgpFuncArith2aUInt {
+class sgpFuncDivUInt: public sgpFuncArith2aKernel<sgpFuncArith2aUInt, gdtfUInt, sgpKernelOpDiv> {
 public:
   virtual scString getName() const { return "div.uint"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const
-  {
-    output.copyValueFrom(scDataNode(
-      uint(arg1.getAsUInt() / 
-           arg2.getAsUInt())));
-  }
-  virtual bool checkArgs(const scDataNode &arg1, const scDataNode &arg2) const
-  {
-    bool res = (arg2.getAsUInt() != 0);
-    if (!res) 
-      m_machine->handleInstrError(getName(), arg2, GVM_ERROR_ARITH_DIV_BY_ZERO);    
-    return res;
-  }
 };
 
-class sgpFuncDivUInt64: public sgpFuncArith2aUInt64 {
+class sgpFuncDivUInt64: public sgpFuncArith2aKernel<sgpFuncArith2aUInt64, gdtfUInt64, sgpKernelOpDiv> {
 public:
   virtual scString getName() const { return "div.uint64"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const
-  {
-    output.copyValueFrom(scDataNode( 
-      ulong64(arg1.getAsUInt64() / 
-              arg2.getAsUInt64())));
-  }
-  virtual bool checkArgs(const scDataNode &arg1, const scDataNode &arg2) const
-  {
-    bool res = (arg2.getAsUInt64() != 0);
-    if (!res) 
-      m_machine->handleInstrError(getName(), arg2, GVM_ERROR_ARITH_DIV_BY_ZERO);    
-    return res;
-  }
 };
 
-class sgpFuncDivFloat: public sgpFuncArith2aFloat {
+class sgpFuncDivFloat: public sgpFuncArith2aKernel<sgpFuncArith2aFloat, gdtfFloat, sgpKernelOpDiv> {
 public:
   virtual scString getName() const { return "div.float"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const
-  {
-    output.copyValueFrom(scDataNode( 
-      float(arg1.getAsFloat() / 
-            arg2.getAsFloat())));
-  }
-  virtual bool checkArgs(const scDataNode &arg1, const scDataNode &arg2) const
-  {
-    bool res = (arg2.getAsFloat() != 0.0);
-    if (!res) 
-      m_machine->handleInstrError(getName(), arg2, GVM_ERROR_ARITH_DIV_BY_ZERO);    
-    return res;
-  }
 };
 
-class sgpFuncDivDouble: public sgpFuncArith2aDouble {
+class sgpFuncDivDouble: public sgpFuncArith2aKernel<sgpFuncArith2aDouble, gdtfDouble, sgpKernelOpDiv> {
 public:
   virtual scString getName() const { return "div.double"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const
-  {
-    output.copyValueFrom(scDataNode( 
-      double(arg1.getAsDouble() / 
-             arg2.getAsDouble())));
-  }
-  virtual bool checkArgs(const scDataNode &arg1, const scDataNode &arg2) const
-  {
-    bool res = (arg2.getAsDouble() != 0.0);
-    if (!res) 
-      m_machine->handleInstrError(getName(), arg2, GVM_ERROR_ARITH_DIV_BY_ZERO);    
-    return res;
-  }
 };
 
-class sgpFuncDivXDouble: public sgpFuncArith2aXDouble {
+class sgpFuncDivXDouble: public sgpFuncArith2aKernel<sgpFuncArith2aXDouble, gdtfXDouble, sgpKernelOpDiv> {
 public:
   virtual scString getName() const { return "div.xdouble"; };
-  virtual void calcValue(const scDataNode &arg1, const scDataNode &arg2, scDataNode &output) const
-  {
-    output.copyValueFrom(scDataNode(
-      xdouble(arg1.getAsXDouble() / 
-              arg2.getAsXDouble())));
-  }
-  virtual bool checkArgs(const scDataNode &arg1, const scDataNode &arg2) const
-  {
-    bool res = (arg2.getAsXDouble() != 0.0);
-    if (!res) 
-      m_machine->handleInstrError(getName(), arg2, GVM_ERROR_ARITH_DIV_BY_ZERO);    
-    return res;
-  }
 };
 
 // ----------------------------------------------------------------------------
@@ -2798,6 +2801,8 @@ public:
 class sgpFuncNegInt: public sgpFuncArith1aInt {
 public:
   virtual scString getName() const { return "neg.int"; };
+  virtual bool isConstFoldable() const { return true; }
+  virtual bool isInvolution() const { return true; }
   virtual void calcValue(const scDataNode &arg1, scDataNode &output) const
   {
     int val1 = arg1.getAsInt();
@@ -2809,6 +2814,8 @@ public:
 class sgpFuncNegInt64: public sgpFuncArith1aInt64 {
 public:
   virtual scString getName() const { return "neg.int64"; };
+  virtual bool isConstFoldable() const { return true; }
+  virtual bool isInvolution() const { return true; }
   virtual void calcValue(const scDataNode &arg1, scDataNode &output) const
   {
     long64 val1 = arg1.getAsInt64();
@@ -2820,6 +2827,8 @@ public:
 class sgpFuncNegFloat: public sgpFuncArith1aFloat {
 public:
   virtual scString getName() const { return "neg.float"; };
+  virtual bool isConstFoldable() const { return true; }
+  virtual bool isInvolution() const { return true; }
   virtual void calcValue(const scDataNode &arg1, scDataNode &output) const
   {
     float val1 = arg1.getAsFloat();
@@ -2831,6 +2840,8 @@ public:
 class sgpFuncNegDouble: public sgpFuncArith1aDouble {
 public:
   virtual scString getName() const { return "neg.double"; };
+  virtual bool isConstFoldable() const { return true; }
+  virtual bool isInvolution() const { return true; }
   virtual void calcValue(const scDataNode &arg1, scDataNode &output) const
   {
     double val1 = arg1.getAsDouble();
@@ -2842,6 +2853,8 @@ public:
 class sgpFuncNegXDouble: public sgpFuncArith1aXDouble {
 public:
   virtual scString getName() const { return "neg.xdouble"; };
+  virtual bool isConstFoldable() const { return true; }
+  virtual bool isInvolution() const { return true; }
   virtual void calcValue(const scDataNode &arg1, scDataNode &output) const
   {
     xdouble val1 = arg1.getAsXDouble();
@@ -3412,6 +3425,38 @@ public:
       m_machine->skipCells(arg2.getAsUInt64());
     return true;
   }
+
+  virtual bool hasBatchKernel() const { return true; }
+
+  virtual bool executeBatch(sgpBatchLanes &lanes) const {
+    const double *values1, *values2;
+    const uint *types1, *types2;
+
+    lanes.evaluateArg(0, values1, types1);
+    lanes.evaluateArg(1, values2, types2);
+    
+    for(uint i=0, epos = lanes.getLaneCount(); i != epos; i++) {
+      if (!lanes.isActive(i))
+        continue;
+      if ((types1[i] != gdtfBool) || ((types2[i] & (gdtfByte + gdtfUInt)) == 0))
+        lanes.abortLane(i);
+      else if (values1[i] == 0.0)
+        lanes.skipCells(i, ulong64(values2[i]));
+    }
+    return true;
+  }
+
+  // jump target is resolved on compile
+  virtual sgpNativeFunc getNativeFunc(const uint *argTypes, uint argCount, uint &outputType) const {
+    if ((argTypes[0] != gdtfBool) || ((argTypes[1] & gdtfAllBaseUInts) == 0))
+      return SC_NULL;
+    outputType = gdtfNull;  
+    return &nativeSkipIfn;
+  }
+  
+  static uint nativeSkipIfn(const sgpNativeInstr &instr) {
+    return (instr.args[0]->asBool ? gnfrNext : gnfrJump);
+  }
 };
 
 // skip.if value1 jump_size : skip if value is <true>
@@ -3445,6 +3490,38 @@ public:
       m_machine->skipCells(arg2.getAsUInt64());
     return true;
   }
+
+  virtual bool hasBatchKernel() const { return true; }
+
+  virtual bool executeBatch(sgpBatchLanes &lanes) const {
+    const double *values1, *values2;
+    const uint *types1, *types2;
+
+    lanes.evaluateArg(0, values1, types1);
+    lanes.evaluateArg(1, values2, types2);
+    
+    for(uint i=0, epos = lanes.getLaneCount(); i != epos; i++) {
+      if (!lanes.isActive(i))
+        continue;
+      if ((types1[i] != gdtfBool) || ((types2[i] & (gdtfByte + gdtfUInt)) == 0))
+        lanes.abortLane(i);
+      else if (values1[i] != 0.0)
+        lanes.skipCells(i, ulong64(values2[i]));
+    }
+    return true;
+  }
+
+  // jump target is resolved on compile
+  virtual sgpNativeFunc getNativeFunc(const uint *argTypes, uint argCount, uint &outputType) const {
+    if ((argTypes[0] != gdtfBool) || ((argTypes[1] & gdtfAllBaseUInts) == 0))
+      return SC_NULL;
+    outputType = gdtfNull;  
+    return &nativeSkipIf;
+  }
+  
+  static uint nativeSkipIf(const sgpNativeInstr &instr) {
+    return (instr.args[0]->asBool ? gnfrJump : gnfrNext);
+  }
 };
 
 // skip jump_size1 : skip n cells
@@ -3475,6 +3552,37 @@ public:
     m_machine->skipCells(arg1.getAsUInt64());
     return true;
   }
+
+  virtual bool hasBatchKernel() const { return true; }
+
+  virtual bool executeBatch(sgpBatchLanes &lanes) const {
+    const double *values;
+    const uint *dataTypes;
+
+    lanes.evaluateArg(0, values, dataTypes);
+    
+    for(uint i=0, epos = lanes.getLaneCount(); i != epos; i++) {
+      if (!lanes.isActive(i))
+        continue;
+      if ((dataTypes[i] & (gdtfByte + gdtfUInt)) == 0)
+        lanes.abortLane(i);
+      else
+        lanes.skipCells(i, ulong64(values[i]));
+    }
+    return true;
+  }
+
+  // jump target is resolved on compile
+  virtual sgpNativeFunc getNativeFunc(const uint *argTypes, uint argCount, uint &outputType) const {
+    if ((argTypes[0] & gdtfAllBaseUInts) == 0)
+      return SC_NULL;
+    outputType = gdtfNull;  
+    return &nativeSkip;
+  }
+  
+  static uint nativeSkip(const sgpNativeInstr &instr) {
+    return gnfrJump;
+  }
 };
 
 //  jump.back jump_size1 : go back n cells
@@ -3544,6 +3652,48 @@ public:
       
     return true;
   }
+
+  virtual bool hasBatchKernel() const { return true; }
+
+  virtual bool executeBatch(sgpBatchLanes &lanes) const {
+    const double *values1, *values2;
+    const uint *types1, *types2;
+    int rValue;
+
+    lanes.evaluateArg(0, values1, types1);
+    lanes.evaluateArg(1, values2, types2);
+    
+    for(uint i=0, epos = lanes.getLaneCount(); i != epos; i++) {
+      if (!lanes.isActive(i))
+        continue;
+      if (((types1[i] & (gdtfInt + gdtfByte)) == 0) || ((types2[i] & (gdtfByte + gdtfUInt)) == 0)) {
+        lanes.abortLane(i);
+        continue;
+      }  
+      
+      rValue = static_cast<int>(values1[i]);
+      if (rValue <= 0)
+        lanes.skipCells(i, ulong64(values2[i]));
+      rValue--;
+      lanes.setLValue(0, i, rValue, gdtfInt);
+    }
+    return true;
+  }
+
+  // jump target is resolved on compile
+  virtual sgpNativeFunc getNativeFunc(const uint *argTypes, uint argCount, uint &outputType) const {
+    if ((argTypes[0] != gdtfInt) || ((argTypes[1] & gdtfAllBaseUInts) == 0))
+      return SC_NULL;
+    outputType = gdtfInt;  
+    return &nativeRepnz;
+  }
+  
+  static uint nativeRepnz(const sgpNativeInstr &instr) {
+    int rValue = instr.args[0]->asInt;
+    
+    instr.args[0]->asInt = rValue - 1;
+    return ((rValue <= 0) ? gnfrJump : gnfrNext);
+  }
 };
 
 // repnz.back #reg jump_size : decrement #reg, if non-zero jump backward
@@ -4725,6 +4875,11 @@ class sgpFuncRandInit: public sgpFunction {
 public:
   virtual scString getName() const { return "rand.init"; };
   
+  virtual bool hasSideEffects() const
+  {
+    return true;
+  }
+  
   virtual void getArgCount(uint &a_min, uint &a_max) const { a_min = a_max = 0; }
 
   virtual bool getArgMeta(scDataNode &output) const
@@ -4743,6 +4898,11 @@ class sgpFuncRandRandomf: public sgpFunction {
 public:
   virtual scString getName() const { return "rand.randomf"; };
   
+  virtual bool hasSideEffects() const
+  {
+    return true;
+  }
+  
   virtual void getArgCount(uint &a_min, uint &a_max) const { a_min = a_max = 1; }
 
   virtual bool getArgMeta(scDataNode &output) const
@@ -4765,6 +4925,11 @@ class sgpFuncRandRandomi: public sgpFunction {
 public:
   virtual scString getName() const { return "rand.randomi"; };
   
+  virtual bool hasSideEffects() const
+  {
+    return true;
+  }
+  
   virtual void getArgCount(uint &a_min, uint &a_max) const { a_min = a_max = 3; }
 
   virtual bool getArgMeta(scDataNode &output) const
@@ -4797,6 +4962,7 @@ public:
 
 class sgpFuncBlockBase: public sgpFunction {
 public:
+  virtual bool hasSideEffects() const { return true; }
   virtual uint getLastCost() {return 10;}; 
 };
 
@@ -116,8 +116,8 @@ public:
   virtual float calcValue(float inValue) const = 0;
   
   virtual bool execute(const scDataNode &args) const {
-    scDataNode arg1;
-    m_machine->evaluateArg(args[1], arg1);
+    scDataNode temp1;
+    const scDataNode &arg1 = m_machine->evaluateArgRef(args[1], temp1);
 
     float input = arg1.getAsFloat();
     scDataNode outValue(float(calcValue(input)));
@@ -140,8 +140,8 @@ public:
   virtual double calcValue(double inValue) const = 0;
 
   virtual bool execute(const scDataNode &args) const {
-    scDataNode arg1;
-    m_machine->evaluateArg(args[1], arg1);
+    scDataNode temp1;
+    const scDataNode &arg1 = m_machine->evaluateArgRef(args[1], temp1);
 
     double input = arg1.getAsFloat();
     scDataNode outValue(double(calcValue(input)));
@@ -164,8 +164,8 @@ public:
   virtual xdouble calcValue(xdouble inValue) const = 0;
 
   virtual bool execute(const scDataNode &args) const {
-    scDataNode arg1;
-    m_machine->evaluateArg(args[1], arg1);
+    scDataNode temp1;
+    const scDataNode &arg1 = m_machine->evaluateArgRef(args[1], temp1);
 
     xdouble input = arg1.getAsFloat();
     scDataNode outValue(xdouble(calcValue(input)));
@@ -189,10 +189,10 @@ public:
   virtual float calcValue(float inValue1, float inValue2) const = 0;
   
   virtual bool execute(const scDataNode &args) const {
-    scDataNode arg1, arg2;
+    scDataNode temp1, temp2;
     
-    m_machine->evaluateArg(args[1], arg1);
-    m_machine->evaluateArg(args[2], arg2);
+    const scDataNode &arg1 = m_machine->evaluateArgRef(args[1], temp1);
+    const scDataNode &arg2 = m_machine->evaluateArgRef(args[2], temp2);
 
     float input1 = arg1.getAsFloat();
     float input2 = arg2.getAsFloat();
@@ -219,9 +219,9 @@ public:
   virtual double calcValue(double inValue1, double inValue2) const = 0;
 
   virtual bool execute(const scDataNode &args) const {
-    scDataNode arg1, arg2;
-    m_machine->evaluateArg(args[1], arg1);
-    m_machine->evaluateArg(args[2], arg2);
+    scDataNode temp1, temp2;
+    const scDataNode &arg1 = m_machine->evaluateArgRef(args[1], temp1);
+    const scDataNode &arg2 = m_machine->evaluateArgRef(args[2], temp2);
 
     double input1 = arg1.getAsFloat();
     double input2 = arg2.getAsFloat();
@@ -248,10 +248,10 @@ public:
   virtual xdouble calcValue(xdouble inValue1, xdouble inValue2) const = 0;
 
   virtual bool execute(const scDataNode &args) const {
-    scDataNode arg1, arg2;
+    scDataNode temp1, temp2;
 
-    m_machine->evaluateArg(args[1], arg1);
-    m_machine->evaluateArg(args[2], arg2);
+    const scDataNode &arg1 = m_machine->evaluateArgRef(args[1], temp1);
+    const scDataNode &arg2 = m_machine->evaluateArgRef(args[2], temp2);
 
     xdouble input1 = arg1.getAsFloat();
     xdouble input2 = arg2.getAsFloat();
@@ -200,13 +200,11 @@ bool sgpLister::extractInstr(const scDataNode &blockCode, cell_size_t cellPos, u
 
   uint minArgCount, maxArgCount;
     
-  sgpFunctionMapColnIterator p = m_functions.find(instrCode);
+  functor = m_functions.getFunctor(instrCode);
 
-  if (p == m_functions.end()) {
+  if (functor == SC_NULL) {
     res = false;
   } else {  
-    sgpFunctionTransporter transporter = p->second;
-    functor = &(*transporter);
     name = functor->getName();
     bIsJump = functor->isJumpAction();
   
@@ -348,15 +346,12 @@ bool sgpLister::checkLabel(cell_size_t addr, const scDataNode &labels, scString
 // check if this is a jump instruction, if yes, generate new labels
 void sgpLister::checkJump(const scDataNode &blockCode, cell_size_t instrAddr, uint instrCode, uint argCount, scDataNode &labels, scDataNode *outJumpArgs)
 {
-  sgpFunctionMapColnIterator p = m_functions.find(instrCode);
+  sgpFunction *functor = m_functions.getFunctor(instrCode);
   if (outJumpArgs != SC_NULL)
     outJumpArgs->clear();
     
-  if (p != m_functions.end()) {
+  if (functor != SC_NULL) {
     scString keyName;
-    sgpFunction *functor;
-    sgpFunctionTransporter transporter = p->second;
-    functor = &(*transporter);
     scDataNode argCell;
     
     if (functor->isJumpAction()) {
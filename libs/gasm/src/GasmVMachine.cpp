@@ -10,6 +10,7 @@
 #include "sc/defs.h"
 
 #include <limits>
+#include <algorithm>
 
 #include "base/algorithm.h"
 
@@ -19,7 +20,6 @@
 #include "sc/utils.h"
 #include "sgp/GasmFunLib.h"
 
-#define USE_INSTR_CACHE 
 #define USE_GASM_STATS
 
 #ifdef USE_GASM_STATS
@@ -43,16 +43,197 @@ void addFunctionToList(uint instrCode, sgpFunction *funct, sgpFunctionMapColn &l
 sgpFunction *getFunctorForInstrCode(const sgpFunctionMapColn &functions,
   uint instrCodeRaw)
 {
-  sgpFunctionMapColnIterator p = const_cast<sgpFunctionMapColn &>(functions).find(instrCodeRaw);
-  sgpFunction *functor;
+  return functions.getFunctor(instrCodeRaw);
+}
+
+// ----------------------------------------------------------------------------
+// sgpFunctionMapColn
+// ----------------------------------------------------------------------------    
+std::pair<sgpFunctionMapColn::iterator, bool> sgpFunctionMapColn::insert(const value_type &value)
+{
+  std::pair<iterator, bool> res = m_items.insert(value);
+  
+  if (res.second && (value.first <= SGP_MAX_INSTR_CODE)) {
+    if (m_index.size() <= value.first)
+      m_index.resize(value.first + 1, SC_NULL);
+    m_index[value.first] = value.second.get();
+  }  
+  
+  return res;  
+}
+
+void sgpFunctionMapColn::clear()
+{
+  m_items.clear();
+  m_index.clear();
+}
+
+// lookup for codes outside of dense table
+sgpFunction *sgpFunctionMapColn::findFunctor(uint instrCode) const
+{
+  const_iterator p = m_items.find(instrCode);
   
-  if (p == functions.end()) {
+  if (p == m_items.end())
     return SC_NULL;
-  } 
+  else  
+    return p->second.get();
+}
+
+// ----------------------------------------------------------------------------
+// sgpTypedRegFile
+// ----------------------------------------------------------------------------    
+
+void sgpTypedRegFile::clear()
+{
+  for(uint i=0; i < SGP_TYPED_REG_COUNT; i++) {
+    dataTypes[i] = gdtfVariant;
+    values[i].asUInt64 = 0;
+  }  
+}
+
+void sgpTypedRegFile::loadFrom(const scDataNode &regs)
+{
+  scDataNode element;
+  uint regNo;
+  
+  for(uint i=0; i < SGP_TYPED_REG_COUNT; i++) {
+    regNo = SGP_REGB_ACCUMS + i;
+    values[i].asUInt64 = 0;
+    
+    if (regNo < regs.size()) {
+      regs.getElement(regNo, element);
+      dataTypes[i] = sgpVMachine::castDataNodeToGasmType(element.getValueType());
+    } else {
+      dataTypes[i] = gdtfNull;
+    }  
+      
+    if ((dataTypes[i] & gdtfAllScalars) != 0)
+      setValue(regNo, element);
+    else
+      dataTypes[i] = gdtfVariant;
+  }
+}
+
+void sgpTypedRegFile::storeTo(scDataNode &regs) const
+{
+  scDataNode element;
+  uint regNo;
   
-  sgpFunctionTransporter transporter = p->second;
-  functor = &(*transporter);
-  return functor;
+  for(uint i=0; i < SGP_TYPED_REG_COUNT; i++) {
+    regNo = SGP_REGB_ACCUMS + i;
+    if (isUnboxed(regNo) && (regNo < regs.size())) {
+      getValue(regNo, element);
+      regs.setElement(regNo, element);
+    }  
+  }
+}
+
+void sgpTypedRegFile::getValue(uint regNo, scDataNode &output) const
+{
+  const uint idx = regNo - SGP_REGB_ACCUMS;
+  getUnboxedValue(values[idx], dataTypes[idx], output);
+}
+
+// note: value is casted to register type, same as scDataNode::assignValueFrom
+void sgpTypedRegFile::setValue(uint regNo, const scDataNode &value)
+{
+  const uint idx = regNo - SGP_REGB_ACCUMS;
+  setUnboxedValue(values[idx], dataTypes[idx], value);
+}
+
+void sgpTypedRegFile::getUnboxedValue(const sgpTypedRegValue &reg, uint dataType, scDataNode &output)
+{
+  output.clear();
+  switch (dataType) {
+    case gdtfInt:
+      output.setAsInt(reg.asInt);
+      break;
+    case gdtfInt64:
+      output.setAsInt64(reg.asInt64);
+      break;
+    case gdtfByte:
+      output.setAsByte(reg.asByte);
+      break;
+    case gdtfUInt:
+      output.setAsUInt(reg.asUInt);
+      break;
+    case gdtfUInt64:
+      output.setAsUInt64(reg.asUInt64);
+      break;
+    case gdtfFloat:
+      output.setAsFloat(reg.asFloat);
+      break;
+    case gdtfDouble:
+      output.setAsDouble(reg.asDouble);
+      break;
+    case gdtfXDouble:
+      output.setAsXDouble(reg.asXDouble);
+      break;
+    case gdtfBool:
+      output.setAsBool(reg.asBool);
+      break;
+    default:
+      break;
+  } // switch  
+}
+
+void sgpTypedRegFile::setUnboxedValue(sgpTypedRegValue &reg, uint dataType, const scDataNode &value)
+{
+  switch (dataType) {
+    case gdtfInt:
+      reg.asInt = value.getAsInt();
+      break;
+    case gdtfInt64:
+      reg.asInt64 = value.getAsInt64();
+      break;
+    case gdtfByte:
+      reg.asByte = value.getAsByte();
+      break;
+    case gdtfUInt:
+      reg.asUInt = value.getAsUInt();
+      break;
+    case gdtfUInt64:
+      reg.asUInt64 = value.getAsUInt64();
+      break;
+    case gdtfFloat:
+      reg.asFloat = value.getAsFloat();
+      break;
+    case gdtfDouble:
+      reg.asDouble = value.getAsDouble();
+      break;
+    case gdtfXDouble:
+      reg.asXDouble = value.getAsXDouble();
+      break;
+    case gdtfBool:
+      reg.asBool = value.getAsBool();
+      break;
+    default:
+      break;
+  } // switch  
+}
+
+// set value of one of numeric types supported by batch lanes
+void sgpTypedRegFile::setUnboxedValue(sgpTypedRegValue &reg, uint dataType, double value)
+{
+  switch (dataType) {
+    case gdtfInt:
+      reg.asInt = static_cast<int>(value);
+      break;
+    case gdtfByte:
+      reg.asByte = static_cast<byte>(value);
+      break;
+    case gdtfUInt:
+      reg.asUInt = static_cast<uint>(value);
+      break;
+    case gdtfFloat:
+      reg.asFloat = static_cast<float>(value);
+      break;
+    case gdtfDouble:
+      reg.asDouble = value;
+      break;
+    default:
+      break;
+  } // switch  
 }
 
 // ----------------------------------------------------------------------------
@@ -85,39 +266,85 @@ void sgpProgramState::resetWarmWay()
 void sgpProgramState::clearRegisters()
 {
   activeRegs.clear();
-  modifiedRegs.clear();
-}
-
-void sgpProgramState::markRegAsModified(uint regNo)
-{
-  modifiedRegs.insert(regNo);
+  regEpochs.clear();
+  regEpoch = 1;
+  typedRegs.clear();
 }
 
+// Restore is performed lazily: new epoch is started and registers modified
+// in previous epochs are copied from template on first use (syncRegister).
 void sgpProgramState::restoreRegisters(const scDataNode &src)
 {
-  if (!modifiedRegs.empty())
-  {  
-     scDataNode element;
-     uint regNoEpos = std::min<uint>(src.size(), activeRegs.size());
-     
-     for(sgpRegUSet::const_iterator it = modifiedRegs.begin(), epos = modifiedRegs.end();
-         it != epos;
-         ++it)
-     {
-       if (*it < regNoEpos)
-       {
-         src.getElement(*it, element);       
-         activeRegs.setElement(*it, element);
-       }  
-     }    
-     modifiedRegs.clear();
-  } else if (activeRegs.empty())
+  if (activeRegs.empty())
   {
      activeRegs.clear();
      activeRegs.copyFrom(src);
+     regEpochs.assign(activeRegs.size(), 0);
+     regEpoch = 1;
+     return;
+  } 
+  
+  if (regEpochs.size() < activeRegs.size())
+    regEpochs.resize(activeRegs.size(), 0);
+    
+  regEpoch++;
+  if (regEpoch == 0) {
+  // epoch counter overflow - restore all modified registers now
+    for(uint regNo = 0, epos = regEpochs.size(); regNo != epos; regNo++)
+      if (regEpochs[regNo] != 0)
+        restoreRegister(regNo, src);
+    regEpoch = 1;    
   }
 }
 
+void sgpProgramState::restoreRegister(uint regNo, const scDataNode &src)
+{
+  if ((regNo < src.size()) && (regNo < activeRegs.size())) {
+    scDataNode element;
+    src.getElement(regNo, element);       
+    activeRegs.setElement(regNo, element);
+  }  
+  regEpochs[regNo] = 0;
+}
+
+// restore all registers modified in previous epochs, required before registers are copied as a whole
+void sgpProgramState::syncRegisters(const scDataNode &src)
+{
+  for(uint regNo = 0, epos = regEpochs.size(); regNo != epos; regNo++)
+    syncRegister(regNo, src);
+}
+
+// mark all modified registers as modified in current epoch (values are valid)
+void sgpProgramState::touchRegisters()
+{
+  for(uint regNo = 0, epos = regEpochs.size(); regNo != epos; regNo++)
+    if (regEpochs[regNo] != 0)
+      regEpochs[regNo] = regEpoch;
+}
+
+// boxed -> unboxed accumulators
+void sgpProgramState::loadTypedRegisters()
+{
+  typedRegs.loadFrom(activeRegs);
+}
+
+// unboxed -> boxed accumulators
+void sgpProgramState::storeTypedRegisters()
+{
+  typedRegs.storeTo(activeRegs);
+  for(uint regNo = SGP_REGB_ACCUMS; regNo < SGP_REGB_VARIANTS; regNo++)
+    if (typedRegs.isUnboxed(regNo))
+      markRegAsModified(regNo);
+}
+
+// unboxed -> boxed single accumulator, register stays boxed until typed registers are loaded again
+void sgpProgramState::boxTypedRegister(uint regNo)
+{
+  typedRegs.getValue(regNo, activeRegs[regNo]);
+  typedRegs.dataTypes[regNo - SGP_REGB_ACCUMS] = gdtfVariant;
+  markRegAsModified(regNo);
+}
+
 // ----------------------------------------------------------------------------
 // sgpProgramCode
 // ----------------------------------------------------------------------------    
@@ -385,6 +612,11 @@ scDataNode &sgpProgramCode::getFullCode()
   return m_code;
 }
 
+const scDataNode &sgpProgramCode::getFullCode() const
+{
+  return m_code;
+}
+
 void sgpProgramCode::setFullCode(const scDataNode &code)
 {
   m_code = code;
@@ -417,6 +649,64 @@ bool sgpProgramCode::blockExists(uint blockNo)
   return (blockNo < m_code.size());
 }
 
+// ----------------------------------------------------------------------------
+// sgpCompiledProgram
+// ----------------------------------------------------------------------------    
+sgpCompiledProgram::sgpCompiledProgram()
+{
+  m_instrCount = m_effInstrCount = 0;
+}
+
+sgpCompiledProgram::~sgpCompiledProgram()
+{
+}
+
+// compares cells in the same way as they are bound on compile
+static bool isSameCodeCell(const scDataNode &cell1, const scDataNode &cell2)
+{
+  if (cell1.isParent() || cell2.isParent())
+    return false;
+    
+  if (cell1.getValueType() != cell2.getValueType())
+    return false;
+    
+  switch (cell1.getValueType()) {
+    case vt_null:
+      return true;
+    case vt_bool: case vt_byte: case vt_uint: case vt_uint64:
+      return (cell1.getAsUInt64() == cell2.getAsUInt64());
+    case vt_int: case vt_int64:
+      return (cell1.getAsInt64() == cell2.getAsInt64());
+    case vt_float: case vt_double:
+      return (cell1.getAsDouble() == cell2.getAsDouble());
+    default:
+      return (cell1.getAsString() == cell2.getAsString());
+  }  
+}
+
+cell_size_t sgpCompiledProgram::getCommonCodeLength(const sgpCompiledProgram &other, uint blockNo) const
+{
+  const scDataNode &code1 = m_code.getFullCode();
+  const scDataNode &code2 = other.m_code.getFullCode();
+  
+  if ((blockNo >= code1.size()) || (blockNo >= code2.size()))
+    return 0;
+  
+  const scDataNode &block1 = code1[blockNo];
+  const scDataNode &block2 = code2[blockNo];
+  cell_size_t res = 0;
+  cell_size_t epos = std::min<cell_size_t>(block1.size(), block2.size());
+  
+  // meta info (cell 0) is not used by compiled block
+  if (epos > 0) 
+    res++;  
+  
+  while ((res < epos) && isSameCodeCell(block1[res], block2[res]))
+    res++;
+    
+  return res;
+}
+
 // ----------------------------------------------------------------------------
 // sgpFunction
 // ----------------------------------------------------------------------------    
@@ -504,11 +794,65 @@ bool sgpFunction::execute(const scDataNode &args, uint &execCost) const
   return res;
 }
 
+bool sgpFunction::hasBatchKernel() const
+{
+  return false;
+}
+
+bool sgpFunction::executeBatch(sgpBatchLanes &lanes) const
+{
+  return false;
+}
+
+bool sgpFunction::executeBatch(sgpBatchLanes &lanes, uint &execCost) const
+{
+  bool res = executeBatch(lanes);
+  execCost = getFunctionCost();
+  return res;
+}
+
+sgpNativeFunc sgpFunction::getNativeFunc(const uint *argTypes, uint argCount, uint &outputType) const
+{
+  return SC_NULL;
+}
+
+sgpNativeFunc sgpFunction::getNativeFunc(const uint *argTypes, uint argCount, uint &outputType, uint &execCost) const
+{
+  sgpNativeFunc res = getNativeFunc(argTypes, argCount, outputType);
+  execCost = getFunctionCost();
+  return res;
+}
+
 bool sgpFunction::hasDynamicArgs() const
 {
   return false;
 }
 
+bool sgpFunction::hasSideEffects() const
+{
+  return false;
+}
+
+bool sgpFunction::canFail() const
+{
+  return true;
+}
+
+bool sgpFunction::foldConstArgs(const scDataNode &args, scDataNode &output) const
+{
+  return false;
+}
+
+int sgpFunction::getIdentityArgNo(const scDataNode &args) const
+{
+  return -1;
+}
+
+bool sgpFunction::isInvolution() const
+{
+  return false;
+}
+
 // ----------------------------------------------------------------------------
 // sgpFunctionForExpand
 // ----------------------------------------------------------------------------    
@@ -521,512 +865,1442 @@ sgpFunctionForExpand::~sgpFunctionForExpand()
 }
 
 // ----------------------------------------------------------------------------
-// sgpVMachine
+// sgpDecodedProgram
 // ----------------------------------------------------------------------------    
-sgpVMachine::sgpVMachine()
+sgpDecodedProgram::sgpDecodedProgram()
 {
-  m_features = sgpGvmFeaturesDefault;
-  m_readRegErrorLock = 0;
-  
-  setErrorLimit(SGP_DEF_ERROR_LIMIT);
-  setDynamicRegsLimit(SGP_DEF_DYNAMIC_REGS_LIMIT);
-  setDefaultDataType(gdtfInt);
-  setSupportedArgTypes(gatfAny);
-  setSupportedDataTypes(gdtfAll);
-  setMaxStackDepth(SGP_DEF_MAX_STACK_DEPTH);
-  setMaxAccessPathLength(SGP_DEF_MAX_ACCESS_PATH_LEN);
-  setExtraRegDataTypes(gdtfInt + gdtfByte + gdtfFloat);
-  setMaxItemCount(SGP_DEF_ITEM_LIMIT);
-  setValueStackLimit(SGP_DEF_VALUE_STACK_LIMIT);
-  setBlockSizeLimit(SGP_DEF_BLOCK_SIZE_LIMIT);
+}
 
-  resetProgram();
+sgpDecodedProgram::~sgpDecodedProgram()
+{
 }
 
-sgpVMachine::~sgpVMachine()
+void sgpDecodedProgram::clear()
 {
+  m_blocks.clear();
+  m_args.clear();
+  m_argLists.clear();
+  m_constPool.clear();
 }
 
-void sgpVMachine::run(uint instrLimit)
+bool sgpDecodedProgram::empty() const
 {
-  m_instrLimit = instrLimit;
-  prepareRun();
-  beforeRun();
-  intRun();
-  afterRun();
+  return m_blocks.empty();
 }
 
-void sgpVMachine::prepareRun()
+// forget results of type inference, required when validation rules are changed
+void sgpDecodedProgram::clearArgChecks()
 {
-  m_instrCount = 0;
-  m_errorCount = 0;
+  for(sgpDecodedBlockVector::iterator it = m_blocks.begin(), epos = m_blocks.end(); it != epos; ++it) {
+    it->typesInferred = false;
+    it->typesProvable = false;
+    it->entryRegs.clear();
+    it->entryTypes.clear();
+    for(sgpDecodedInstrVector::iterator instrIt = it->instrs.begin(), instrEnd = it->instrs.end(); 
+        instrIt != instrEnd; 
+        ++instrIt)
+      instrIt->argCheck = gdacDynamic;
+  }  
 }
 
-void sgpVMachine::intRun()
+void sgpDecodedProgram::compile(sgpProgramCode &code, const sgpFunctionMapColn &functions)
 {
-  cell_size_t runLimit = m_instrLimit;
-  bool useLimit = (m_instrLimit > 0);
+  clear();
+  for(uint i=0, epos = code.getBlockCount(); i != epos; i++)
+    compileBlock(code, functions, i);
+}
 
-  scDataNode *args = SC_NULL;
-  std::auto_ptr<scDataNode> argsGuard;
+// decode block in code order, starting from the first instruction
+void sgpDecodedProgram::compileBlock(sgpProgramCode &code, const sgpFunctionMapColn &functions, uint blockNo)
+{
+  sgpDecodedBlock &block = prepareBlock(code, blockNo);
+  cell_size_t blockLength = code.getBlockLength(blockNo);
+  cell_size_t cellNo = 1;
+  int instrIndex;
+  int prevIndex = -1;
   
-  uint instrCode;
-  uint argCount;
-  sgpFunction *functor;
-  bool found;
-  ulong64 instrKey = 0;
-  bool useTrace = ((ggfTraceEnabled & m_features) != 0);
+  while (cellNo < blockLength) {
+    instrIndex = block.cellIndex[cellNo];
+    if (instrIndex < 0)
+      instrIndex = decodeCell(code, functions, block, blockNo, cellNo);
+    if (prevIndex >= 0)
+      block.instrs[prevIndex].nextInstr = instrIndex;
+    prevIndex = instrIndex;  
+    cellNo += block.instrs[instrIndex].nextCellOffset;
+  }
   
-  if (isFinished())
-    return;
-    
-  m_instrCount = 0;
-  do {
-    m_lastOperCost = 0;    
-    found = true;
+  if (prevIndex >= 0)
+    block.instrs[prevIndex].nextInstr = SGP_DECODED_BLOCK_END;
+}
 
-#ifdef USE_INSTR_CACHE    
-    if (!m_instrCacheRequired || !getActiveInstrFromCache(instrCode, argCount, args, functor))
-    {
-#endif
-      if (argsGuard.get() != SC_NULL)
-      {      
-        argsGuard->clear();
-      } else {       
-        argsGuard.reset(new scDataNode());
-      }  
-      if (getActiveInstr(instrCode, argCount, *argsGuard.get(), functor)) {
-        args = argsGuard.get();        
-      } else {  
-        found = false;
-        argsGuard.reset();
-      }  
-#ifdef USE_INSTR_CACHE    
-    }
-#endif
+const sgpDecodedInstr *sgpDecodedProgram::getInstr(sgpProgramCode &code, const sgpFunctionMapColn &functions, 
+  uint blockNo, cell_size_t cellNo, bool &decoded)
+{
+  sgpDecodedBlock *block;
+  
+  if ((blockNo < m_blocks.size()) && (cellNo < m_blocks[blockNo].cellIndex.size()))
+    block = &m_blocks[blockNo];
+  else
+    block = &prepareBlock(code, blockNo);  
+
+  assert(cellNo < block->cellIndex.size());
     
-    assert(!found || (args != SC_NULL));
-    assert(!found || (argCount == 0) || (args->getValueType() != vt_null));
+  int instrIndex = block->cellIndex[cellNo];
+  decoded = (instrIndex < 0);
+  
+  if (decoded)
+    instrIndex = decodeCell(code, functions, *block, blockNo, cellNo);
     
-    if (found) {    
-      m_programState.nextCellNo = m_programState.activeCellNo + (1 + argCount);
-      if (useTrace) 
-        addToTraceLogInstr(instrCode, *args, functor);
+  return &(block->instrs[instrIndex]);
+}
 
-#ifdef USE_INSTR_CACHE    
-      if (m_instrCacheRequired) {
-        instrKey = calcActiveInstrCacheKey();
-      }          
-#endif      
-      intRunInstr(instrCode, *args, functor);
-      
-      m_programState.activeCellNo = m_programState.nextCellNo;
-    } else {
-      m_programState.activeCellNo += (1 + argCount);
-    }  
+sgpDecodedBlock &sgpDecodedProgram::prepareBlock(sgpProgramCode &code, uint blockNo)
+{
+  if (blockNo >= m_blocks.size())
+    m_blocks.resize(blockNo + 1);
     
-#ifdef USE_INSTR_CACHE    
-    if (m_instrCacheRequired && (argsGuard.get() != SC_NULL))  
-      addInstrToCache(instrKey, instrCode, argCount, argsGuard.release(), functor);
-#endif
+  sgpDecodedBlock &res = m_blocks[blockNo];
+  cell_size_t blockLength = code.getBlockLength(blockNo);
+  
+  if (res.cellIndex.size() < blockLength)
+    res.cellIndex.resize(blockLength, -1);
     
-    if (useLimit) runLimit--;
-    m_instrCount++;
-    m_totalCost += m_lastOperCost;
-    if ((m_errorCount > 0) && (m_errorCount == m_errorLimit))
-      break; 
+  return res;  
+}
 
-    if (isFinished())
-    {
-      if (!m_programState.callStack.empty())
-      { 
-        exitBlock();
-        m_programState.activeCellNo = m_programState.nextCellNo;
+// decode instruction starting at a given cell, returns index of instruction in block
+int sgpDecodedProgram::decodeCell(sgpProgramCode &code, const sgpFunctionMapColn &functions, 
+  sgpDecodedBlock &block, uint blockNo, cell_size_t cellNo)
+{
+  scDataNode &blockCode = code.getBlock(blockNo);
+  cell_size_t codeSize = code.getBlockLength(blockNo);
+  cell_size_t argOffset = cellNo + 1;
+  sgpDecodedInstr instr;
+  
+  instr.encodedCode = blockCode.getUInt(cellNo);
+  sgpVMachine::decodeInstr(instr.encodedCode, instr.instrCode, instr.argCount);
+
+  instr.functor = ::getFunctorForInstrCode(functions, instr.instrCode);
+  instr.args = SC_NULL;
+  instr.firstArg = m_args.size();
+  instr.status = gdisOk;
+  instr.argCheck = gdacDynamic;
+  
+  if (instr.functor == SC_NULL) {
+    instr.status = gdisUnknownInstr;
+  } else {
+    if (argOffset + instr.argCount > codeSize) {
+      if (argOffset <= codeSize) {
+        instr.argCount = codeSize - argOffset;
+      } else {
+        instr.argCount = 0;  
       }  
-      checkNextBlock();
-    }      
+    }
 
-  } while ((runLimit > 0 || !useLimit) && (!isFinished()));
-}
+    uint minArgCount, maxArgCount;
+    instr.functor->getArgCount(minArgCount, maxArgCount);
 
-void sgpVMachine::checkNextBlock()
-{
-  if (
-       (m_programState.nextBlockNo >= 0) 
-       && 
-       (m_programState.nextBlockNo != static_cast<int>(m_programState.activeBlockNo))
-       &&
-       m_programCode.blockExists(m_programState.nextBlockNo)
-     )
-  {
-    scDataNode blockResult = getOutput();
-    prepareBlockRun(m_programState.nextBlockNo);   
-    setInput(blockResult);
-    setOutput(blockResult); // next block is optional
+    if ((instr.argCount < minArgCount) || ((maxArgCount > 0) && (instr.argCount > maxArgCount))) 
+      instr.status = gdisWrongArgCount;
+  }  
+  
+  if (instr.status == gdisOk) {
+    std::auto_ptr<scDataNode> argsGuard(new scDataNode());
+    sgpDecodedArg arg;
+    scDataNode *cell;
+    
+    for(uint i=0; i < instr.argCount; i++) {
+      cell = blockCode.cloneElement(argOffset + i);
+      argsGuard->addChild(cell);
+      
+      arg.argType = sgpVMachine::getArgType(*cell);
+      switch (arg.argType) {
+        case gatfRegister:
+          arg.value = sgpVMachine::getRegisterNo(*cell);
+          break;
+        case gatfConst:  
+          arg.value = m_constPool.size();
+          m_constPool.addChild(new scDataNode(*cell));
+          break;
+        default:
+          arg.value = 0;  
+          break;
+      } // switch  
+      m_args.push_back(arg);
+    }
+    
+    instr.args = argsGuard.get();
+    m_argLists.push_back(argsGuard.release());
   }
+  
+  instr.nextCellOffset = 1 + instr.argCount;
+  instr.nextInstr = SGP_DECODED_NOT_LINKED;
+  block.instrs.push_back(instr);
+  
+  int res = block.instrs.size() - 1;
+  block.cellIndex[cellNo] = res;
+  return res;
 }
 
-bool sgpVMachine::isFinished()
+// ----------------------------------------------------------------------------
+// sgpBatchLanes
+// ----------------------------------------------------------------------------    
+sgpBatchLanes::sgpBatchLanes(): m_laneCount(0), m_errorLimit(0), m_blockLength(0), 
+  m_args(SC_NULL), m_argCount(0), m_nextCellNo(0)
 {
-  bool res = true;
-  if (m_programCode.blockExists(m_programState.activeBlockNo)) {
-    res = (m_programState.activeCellNo >= m_programCode.getBlockLength(m_programState.activeBlockNo));
-  }
-  return res;
 }
 
-void sgpVMachine::runInstr(uint code, const scDataNode &args)
+sgpBatchLanes::~sgpBatchLanes()
 {
-  uint instrCode;
-  uint argCount;
-  decodeInstr(code, instrCode, argCount);
-  
-  sgpFunctionMapColnIterator p = m_functions.find(instrCode);
-  sgpFunction *functor;
-  argCount = args.size();
-  
-  if (p == m_functions.end()) {
-    argCount = 0;
-    functor = SC_NULL;
-    handleUnknownInstr(instrCode, scDataNode());
-  } else {
-    sgpFunctionTransporter transporter = p->second;
-    functor = &(*transporter);
-
-    if (!checkArgCount(argCount, functor)) {
-      handleWrongParamCount(code);        
-    } else {
-      // all OK
-      intRunInstr(instrCode, args, functor);
-    }  
-  }  
 }
 
-bool sgpVMachine::verifyArgs(const scDataNode &args, sgpFunction *functor)
+void sgpBatchLanes::init(uint laneCount, uint slotCount, cell_size_t blockLength, uint errorLimit)
 {
-  bool staticTypes;
-  uint argNo;
-  bool res;
-  const scDataNode *argMetaPtr;
+  m_laneCount = laneCount;
+  m_errorLimit = errorLimit;
+  m_blockLength = blockLength;
   
-  res = checkArgCount(args.size(), functor);  
+  m_values.assign(slotCount * laneCount, 0.0);
+  m_types.assign(slotCount * laneCount, gdtfNull);
+  m_result.assign(laneCount, 0.0);
+  m_resumeCells.assign(laneCount, 0);
+  m_states.assign(laneCount, gblsRunning);
+  m_errorCounts.assign(laneCount, 0);
+  m_costs.assign(laneCount, 0);
+  m_active.assign(laneCount, 0);
+  m_failed.assign(laneCount, 0);
+  m_skipped.assign(laneCount, 0);
+  m_instrCells.assign(blockLength + 1, 0);
+  m_instrCells[blockLength] = 1;
+  m_args = SC_NULL;
+  m_argCount = 0;
+}
 
-  if (res) {
-    argMetaPtr = functor->getArgMeta();
-    if (argMetaPtr != SC_NULL) 
-      res = checkArgMeta(args, *argMetaPtr, gatfInput+gatfOutput, argNo, staticTypes);
-  }
-      
-  if (res)
-    res = checkArgsSupported(args, argNo);  
-    
-  return res;  
+void sgpBatchLanes::setSlotValue(uint slot, uint lane, double value, uint dataType)
+{
+  m_values[slot * m_laneCount + lane] = value;
+  m_types[slot * m_laneCount + lane] = dataType;
 }
 
-void sgpVMachine::intRunInstr(uint code, const scDataNode &args, sgpFunction *functor)
+// mark cell as a valid target of skip
+void sgpBatchLanes::setInstrCell(cell_size_t cellNo)
 {
-  bool argsOk = true;
+  m_instrCells[cellNo] = 1;
+}
 
-  assert(functor != SC_NULL);
+// returns number of lanes which execute instruction
+uint sgpBatchLanes::beginInstr(const sgpBatchInstr &instr, const sgpBatchArg *args)
+{
+  uint res = 0;
   
-  try {
-    if ((ggfValidateArgs & m_features) != 0) 
-    {
-       ulong64 keyNum = calcActiveInstrCacheKey();
-         
-       if (!getArgsValidFromCache(keyNum)) {
-         const scDataNode *argMetaPtr;
-         bool staticTypes = false;
-         uint argNo = 0;
-         
-         argMetaPtr = functor->getArgMeta();
-         
-         if (argMetaPtr != SC_NULL) {
-           argsOk = checkArgMeta(args, *argMetaPtr, gatfInput+gatfOutput, argNo, staticTypes);
-           if (!staticTypes) 
-             addOperCostById(SGP_OPER_COST_DYNAMIC_TYPE_ARGS);
-         }           
-         if (argsOk)
-           argsOk = checkArgsSupported(args, argNo);  
-         if (staticTypes && argsOk)
-           setArgsValidInCache(keyNum);  
-         if (!argsOk) {
-           handleWrongArgumentError(code, args, argNo);
-         }  
-       } 
-    } 
+  m_args = args;
+  m_argCount = instr.instr->argCount;
+  m_nextCellNo = instr.cellNo + instr.instr->nextCellOffset;
+  
+  for(uint i=0; i != m_laneCount; i++) {
+    m_failed[i] = m_skipped[i] = 0;
+    m_active[i] = ((m_states[i] == gblsRunning) && (m_resumeCells[i] <= instr.cellNo)) ? 1 : 0;
+    if (m_active[i] != 0) {
+      m_costs[i] += instr.validateCost;
+      checkLaneArgs(i);
+      if (m_active[i] != 0)
+        res++;
+    }    
+  }
+  
+  return res;
+}
 
-    if (argsOk) {
-      uint funCost;
-      
-      if (functor->execute(args, funCost))
-      {
-        addOperCost(funCost);
-      } else {
-        handleInstrError(code, args, GVM_ERROR_FUNCT_FAIL, "Function failed");
-        addOperCostById(SGP_OPER_COST_FUNC_FAILED);
-      }
+// types of dynamic registers are validated per lane, scalar run handles errors
+void sgpBatchLanes::checkLaneArgs(uint lane)
+{
+  for(uint i=0; i != m_argCount; i++) {
+    const sgpBatchArg &arg = m_args[i];
+    if ((arg.laneTypeMask != 0) && (arg.argType == gatfRegister)) {
+      if ((m_types[arg.slot * m_laneCount + lane] & arg.laneTypeMask) == 0) {
+        abortLane(lane);
+        break;
+      }  
     }
-  }  
-  catch(scError &excp) {
-    handleInstrException(excp, code, args, functor);
-  }
-  catch(const std::exception& e) {
-    handleInstrException(e, code, args, functor);
   }
-  catch(...) {
-    handleInstrException(scString("Unknown"), code, args, functor);
+}
+
+void sgpBatchLanes::endInstr(uint execCost)
+{
+  for(uint i=0; i != m_laneCount; i++) {
+    if (m_active[i] == 0)
+      continue;
+      
+    if (m_failed[i] == 0)  
+      m_costs[i] += execCost;
+      
+    // control flow changed - verify target
+    if ((m_skipped[i] != 0) && ((m_resumeCells[i] > m_blockLength) || (m_instrCells[m_resumeCells[i]] == 0)))
+      abortLane(i);
+    // error limit is verified after each instruction, same as in intRun
+    else if ((m_errorLimit > 0) && (m_errorCounts[i] >= m_errorLimit))
+      m_states[i] = gblsFinished;
   }
 }
-  
-// add cost specified by ID to last oper cost
-void sgpVMachine::addOperCostById(uint a_subOperCostId, uint mult)
+
+bool sgpBatchLanes::isNumericType(uint dataType)
 {
-  uint cost;
+  return ((dataType & (gdtfFloat + gdtfDouble + gdtfInt + gdtfUInt + gdtfByte)) != 0);
+}
 
-  switch (a_subOperCostId) {
-    case SGP_OPER_COST_UNK_INSTR:
-      cost = 100;
+void sgpBatchLanes::getSlotValue(uint slot, uint lane, scDataNode &output) const
+{
+  buildValue(m_values[slot * m_laneCount + lane], m_types[slot * m_laneCount + lane], output);
+}
+
+// round value to precision of a given type
+double sgpBatchLanes::castValue(double value, uint dataType)
+{
+  switch (dataType) {
+    case gdtfInt:
+      return static_cast<int>(value);
+    case gdtfByte:
+      return static_cast<byte>(value);
+    case gdtfUInt:
+      return static_cast<uint>(value);
+    case gdtfFloat:
+      return static_cast<float>(value);
+    default:
+      return value;
+  } // switch  
+}
+
+void sgpBatchLanes::buildValue(double value, uint dataType, scDataNode &output)
+{
+  output.clear();
+  switch (dataType) {
+    case gdtfInt:
+      output.setAsInt(static_cast<int>(value));
       break;
-    case SGP_OPER_COST_EXCEPTION:
-      cost = 90;
+    case gdtfByte:
+      output.setAsByte(static_cast<byte>(value));
       break;
-    case SGP_OPER_COST_ERROR:  
-      cost = 20;
+    case gdtfUInt:
+      output.setAsUInt(static_cast<uint>(value));
       break;
-    case SGP_OPER_COST_ARG_CNT_ERROR:  
-      cost = 18;
+    case gdtfFloat:
+      output.setAsFloat(static_cast<float>(value));
+      break;
+    case gdtfDouble:
+      output.setAsDouble(value);
+      break;
+    case gdtfBool:
+      output.setAsBool(value != 0.0);
       break;
     default:
-      cost = 1;
       break;
-  }
-          
-  m_lastOperCost += (cost * mult);
+  } // switch  
 }
 
-// add cost specified by value
-void sgpVMachine::addOperCost(ulong64 a_cost)
+void sgpBatchLanes::evaluateArg(uint argNo, const double *&values, const uint *&dataTypes)
 {
-  m_lastOperCost += a_cost;
+  const sgpBatchArg &arg = m_args[argNo];
+  
+  for(uint i=0; i != m_laneCount; i++)
+    if (m_active[i] != 0)
+      m_costs[i] += arg.evalCost;
+  
+  if (arg.argType == gatfRegister) {
+    values = &m_values[arg.slot * m_laneCount];
+    dataTypes = &m_types[arg.slot * m_laneCount];
+  } else {
+    uint offset = argNo * m_laneCount;
+    if (m_constValues.size() < offset + m_laneCount) {
+      m_constValues.resize(offset + m_laneCount);
+      m_constTypes.resize(offset + m_laneCount);
+    }  
+    if (arg.argType == gatfConst) {
+      std::fill(m_constValues.begin() + offset, m_constValues.begin() + offset + m_laneCount, arg.constValue);
+      std::fill(m_constTypes.begin() + offset, m_constTypes.begin() + offset + m_laneCount, arg.constType);
+    } else {
+      std::fill(m_constValues.begin() + offset, m_constValues.begin() + offset + m_laneCount, 0.0);
+      std::fill(m_constTypes.begin() + offset, m_constTypes.begin() + offset + m_laneCount, uint(gdtfNull));
+    }  
+    values = &m_constValues[offset];
+    dataTypes = &m_constTypes[offset];
+  }
 }
 
-// reset after code change
-void sgpVMachine::resetProgram()
+// value is stored using rules of sgpVMachine::setRegisterValue, lanes which
+// would cause write error are executed again in scalar mode
+void sgpBatchLanes::setLValue(uint argNo, uint lane, double value, uint dataType)
 {
-  m_instrCacheRequired = false;
-  initRegisterTemplate();
-  clearArgValidCache();
-  clearInstrCache();
-  m_programState.clearRegisters();
-  resetWarmWay();
+  const sgpBatchArg &arg = m_args[argNo];
+  
+  m_costs[lane] += sgpVMachine::getOperCostById(SGP_OPER_COST_SET_LVALUE);
+  
+  if (arg.argType != gatfRegister)
+    return;
+    
+  uint storeType = dataType;
+  bool typeOk;
+  
+  switch (arg.regType) {
+    case gdtfVariant:
+      typeOk = true;
+      break;
+    case gdtfInt:  
+      typeOk = ((dataType & (gdtfInt + gdtfByte)) != 0);
+      storeType = gdtfInt;
+      break;
+    case gdtfFloat:  
+      typeOk = (dataType == gdtfFloat);
+      break;
+    case gdtfDouble:  
+      typeOk = ((dataType & (gdtfFloat + gdtfDouble)) != 0);
+      storeType = gdtfDouble;
+      break;
+    case gdtfBool:  
+      typeOk = (dataType == gdtfBool);
+      break;
+    default:
+      typeOk = false;
+      break;
+  }    
+  
+  if (typeOk) {
+    m_values[arg.slot * m_laneCount + lane] = value;
+    m_types[arg.slot * m_laneCount + lane] = storeType;
+  } else {
+    abortLane(lane);
+  }  
 }
 
-// reset data state, no program change was performed since last reset
-void sgpVMachine::resetWarmWay()
+void sgpBatchLanes::skipCells(uint lane, ulong64 cellCount)
 {
-  m_programState.resetWarmWay();
-  m_programState.restoreRegisters(m_registerTemplate);
-  m_totalCost = 0;
-  if ((m_features & ggfNotesEnabled) != 0)
-    m_programState.notes = m_notes;
-  clearErrors();
-  clearTrace();
+  if (cellCount == 0)
+    return;
+  if (cellCount > ulong64(m_blockLength - m_nextCellNo))
+  // invalid skip, verified in endInstr
+    m_resumeCells[lane] = m_blockLength + 1;
+  else  
+    m_resumeCells[lane] = m_nextCellNo + cellCount;
+  m_skipped[lane] = 1;
 }
 
-void sgpVMachine::setStartBlockNo(uint blockNo)
+// function reported error & failed - same costs as in sgpVMachine::handleInstrError 
+// (called by function) + sgpVMachine::execInstr
+void sgpBatchLanes::failLane(uint lane)
 {
-  m_programState.activeBlockNo = blockNo;
+  m_failed[lane] = 1;
+  m_costs[lane] += 
+    2 * sgpVMachine::getOperCostById(SGP_OPER_COST_ERROR) 
+    + 
+    sgpVMachine::getOperCostById(SGP_OPER_COST_FUNC_FAILED);
+  m_errorCounts[lane] += 2;
 }
 
-void sgpVMachine::prepareBlockRun(uint blockNo)
+void sgpBatchLanes::abortLane(uint lane)
 {
-  m_programState.resetWarmWay();
-  m_programState.restoreRegisters(m_registerTemplate);
-  clearInput();
-  clearOutput();
-  m_programState.activeBlockNo = blockNo;
-  m_programState.activeCellNo = m_programState.nextCellNo = 1;
-  m_programState.nextBlockNo = -1;
+  m_states[lane] = gblsScalar;
+  m_active[lane] = 0;
 }
 
-void sgpVMachine::clearInput()
+// ----------------------------------------------------------------------------
+// sgpNativeProgram
+// ----------------------------------------------------------------------------    
+void sgpNativeProgram::clear()
 {
-#ifdef DEBUG_VMACHINE
-  scLog::addDebug("vmach-clr-inp-beg");
-#endif  
-  scDataNode nullInput;
-  for(uint i = SGP_REGB_INPUT; i <= SGP_REGB_INPUT_MAX; i++)
-    m_programState.activeRegs.setElement(i, nullInput);
-#ifdef DEBUG_VMACHINE
-  scLog::addDebug("vmach-clr-inp-end");
-#endif  
+  compiled = false;
+  valid = false;
+  blockNo = 0;
+  blockLength = 0;
+  outputType = gdtfNull;
+  instrs.clear();
+  consts.clear();
+  inputRegs.clear();
+  inputTypes.clear();
 }
 
-void sgpVMachine::clearOutput()
+// ----------------------------------------------------------------------------
+// sgpVMachine
+// ----------------------------------------------------------------------------    
+sgpVMachine::sgpVMachine()
 {
-  setOutput(scDataNode());
+  m_features = sgpGvmFeaturesDefault;
+  m_typedRegsActive = false;
+  m_instrCacheInvalid = false;
+  m_activeInstr = SC_NULL;
+  m_argTypesProven = false;
+  m_provenBlockNo = -1;
+  m_provenCallDepth = 0;
+  m_readRegErrorLock = 0;
+  
+  setErrorLimit(SGP_DEF_ERROR_LIMIT);
+  setDynamicRegsLimit(SGP_DEF_DYNAMIC_REGS_LIMIT);
+  setDefaultDataType(gdtfInt);
+  setSupportedArgTypes(gatfAny);
+  setSupportedDataTypes(gdtfAll);
+  setMaxStackDepth(SGP_DEF_MAX_STACK_DEPTH);
+  setMaxAccessPathLength(SGP_DEF_MAX_ACCESS_PATH_LEN);
+  setExtraRegDataTypes(gdtfInt + gdtfByte + gdtfFloat);
+  setMaxItemCount(SGP_DEF_ITEM_LIMIT);
+  setValueStackLimit(SGP_DEF_VALUE_STACK_LIMIT);
+  setBlockSizeLimit(SGP_DEF_BLOCK_SIZE_LIMIT);
+
+  resetProgram();
 }
 
-void sgpVMachine::initBlockState(uint blockNo)
+sgpVMachine::~sgpVMachine()
 {
-  m_programState.activeBlockNo = blockNo;
-  m_programState.activeCellNo = m_programState.nextCellNo = 1;
-  m_programState.definedRegs.clear();
-  m_programState.references.clear();
+}
 
-  initRegisters();
+void sgpVMachine::run(uint instrLimit)
+{
+  m_instrLimit = instrLimit;
+  prepareRun();
+  beforeRun();
+  if (((ggfNativeRun & m_features) != 0) && prepareNativeRun())
+    intRunNative();
+  else if (((ggfThreadedRun & m_features) != 0) && ((ggfTraceEnabled & m_features) == 0))
+    intRunThreaded();
+  else  
+    intRun();
+  afterRun();
 }
 
-bool sgpVMachine::getActiveInstrForLog(uint &instrCode, uint &argCount, scString &name)
+void sgpVMachine::prepareRun()
 {
-  bool res = false;
-  sgpFunction *functor;
+  m_instrCount = 0;
+  m_errorCount = 0;
+}
 
-  if (m_programCode.blockExists(m_programState.activeBlockNo)) {
-    cell_size_t activeCellNo = m_programState.activeCellNo;
-    scDataNode code;
-    scDataNode cell;
+void sgpVMachine::intRun()
+{
+  cell_size_t runLimit = m_instrLimit;
+  bool useLimit = (m_instrLimit > 0);
+  const sgpDecodedInstr *instr;
+  bool useTrace = ((ggfTraceEnabled & m_features) != 0);
+  
+  if (isFinished())
+    return;
+    
+  m_instrCount = 0;
+  do {
+    m_lastOperCost = 0;    
+    instr = getActiveDecodedInstr();
+    
+    if (instr->status == gdisOk) {    
+      assert(instr->args != SC_NULL);
+      m_programState.nextCellNo = m_programState.activeCellNo + instr->nextCellOffset;
+      if (useTrace) 
+        addToTraceLogInstr(instr->instrCode, *instr->args, instr->functor);
 
-    m_programCode.getBlock(m_programState.activeBlockNo, code);
-    code.getElement(activeCellNo, cell);
-    uint instrCodeCell = cell.getAsUInt();
-    decodeInstr(instrCodeCell, instrCode, argCount);
+      intRunInstr(instr->instrCode, *instr->args, instr->functor);
+      
+      m_programState.activeCellNo = m_programState.nextCellNo;
+    } else {
+      handleDecodedInstrError(*instr);
+      m_programState.activeCellNo += instr->nextCellOffset;
+    }  
     
-    sgpFunctionMapColnIterator p = m_functions.find(instrCode);
+    if (useLimit) runLimit--;
+    m_instrCount++;
+    m_totalCost += m_lastOperCost;
+    if ((m_errorCount > 0) && (m_errorCount == m_errorLimit))
+      break; 
 
-    if (p != m_functions.end()) {
-      sgpFunctionTransporter transporter = p->second;
-      functor = &(*transporter);
-      name = functor->getName();
-      res = true;
+    if (isFinished())
+    {
+      if (!m_programState.callStack.empty())
+      { 
+        exitBlock();
+        m_programState.activeCellNo = m_programState.nextCellNo;
+      }  
+      checkNextBlock();
+    }      
+
+  } while ((runLimit > 0 || !useLimit) && (!isFinished()));
+}
+
+// Threaded engine - follows links between decoded instructions.
+// Exceptions are handled outside of the instruction loop.
+// Block end is checked only after control flow change (skip, jump, call, return),
+// error & instruction limits are checked after each instruction (like in intRun).
+void sgpVMachine::intRunThreaded()
+{
+  bool running;
+
+  if (!m_instrCacheRequired || m_instrCacheInvalid || m_decodedProgram.empty())
+    forceInstrCache();
+    
+  m_instrCount = 0;
+  m_lastOperCost = 0;
+  m_activeInstr = SC_NULL;
+  m_argTypesProven = false;
+  m_provenBlockNo = -1;
+  running = !isFinished();
+  
+  while (running) {
+    try {
+      running = intRunThreadedSteps();
+    }
+    catch(scError &excp) {
+      if (m_activeInstr == SC_NULL)
+        throw;
+      handleInstrException(excp, m_activeInstr->instrCode, *m_activeInstr->args, m_activeInstr->functor);
+      running = finishThreadedInstr();
+    }
+    catch(const std::exception& e) {
+      if (m_activeInstr == SC_NULL)
+        throw;
+      handleInstrException(e, m_activeInstr->instrCode, *m_activeInstr->args, m_activeInstr->functor);
+      running = finishThreadedInstr();
+    }
+    catch(...) {
+      if (m_activeInstr == SC_NULL)
+        throw;
+      handleInstrException(scString("Unknown"), m_activeInstr->instrCode, *m_activeInstr->args, m_activeInstr->functor);
+      running = finishThreadedInstr();
     }
   }
   
-  return res;
+  m_totalCost += m_lastOperCost;
+  m_lastOperCost = 0;
 }
 
-bool sgpVMachine::getActiveInstr(uint &instrCode, uint &argCount, scDataNode &args, sgpFunction *&functor)
+// returns <true> if run is not finished (used after exception)
+bool sgpVMachine::intRunThreadedSteps()
 {
-  bool res = true;
-  cell_size_t activeCellNo = m_programState.activeCellNo;
-  scDataNode &code = m_programCode.getBlock(m_programState.activeBlockNo);
-  uint instrCodeCell = code.getUInt(activeCellNo);
-      
-  decodeInstr(instrCodeCell, instrCode, argCount);
+  uint blockNo = m_programState.activeBlockNo;
+  cell_size_t blockLength = m_programCode.getBlockLength(blockNo);
+  cell_size_t nextCellNo;
+  bool validateArgs = ((ggfValidateArgs & m_features) != 0);
+  const sgpDecodedInstr *instr = getActiveDecodedInstr();
+  // limits as values never reached if limit is not used
+  cell_size_t instrLimit = (m_instrLimit > 0) ? m_instrLimit : std::numeric_limits<cell_size_t>::max();
+  uint errorLimit = (m_errorLimit > 0) ? m_errorLimit : UINT_MAX;
   
-  sgpFunctionMapColnIterator p = m_functions.find(instrCode);
-
-  args.clear();
+  if (validateArgs)
+    updateArgTypesProven(blockNo);
   
-  if (p == m_functions.end()) {
-    functor = SC_NULL;
-    handleUnknownInstr(instrCode, scDataNode());
-    res = false;
-  } else {
-    sgpFunctionTransporter transporter = p->second;
-    functor = &(*transporter);
-
-    cell_size_t argOffset = activeCellNo + 1;
-    cell_size_t codeSize = m_programCode.getBlockLength(m_programState.activeBlockNo);
-
-    if (argOffset + argCount > codeSize) {
-      if (argOffset <= codeSize) {
-        argCount = codeSize - argOffset;
-      } else {
-        argCount = 0;  
-      }  
+  for(;;) {
+    nextCellNo = m_programState.activeCellNo + instr->nextCellOffset;
+    m_programState.nextCellNo = nextCellNo;
+
+    if (instr->status == gdisOk) {
+      m_activeInstr = instr;
+      runDecodedInstr(*instr, validateArgs);
+      m_activeInstr = SC_NULL;
+    } else {
+      handleDecodedInstrError(*instr);
     }
 
-    if (!checkArgCount(argCount, functor))    
+    m_instrCount++;
+
+    if (
+        (m_programState.nextCellNo == nextCellNo) 
+        && 
+        (m_programState.activeBlockNo == blockNo) 
+        && 
+        !m_instrCacheInvalid
+       )
     {
-      handleWrongParamCount(instrCodeCell);
-      res = false;
-    }    
-     
-    if (res) {  
-      for(uint i=0; i<argCount; i++) {
-        args.addChild(
-          //code.cloneElement(argOffset + i));
-          m_programCode.cloneBlockCell(m_programState.activeBlockNo, argOffset + i));
+    // sequential flow
+      m_programState.activeCellNo = nextCellNo;
+      if ((m_instrCount < instrLimit) && (m_errorCount < errorLimit)) {
+        if (instr->nextInstr >= 0) {
+          instr = m_decodedProgram.getLinkedInstr(blockNo, instr->nextInstr);
+          continue;
+        } else if ((instr->nextInstr == SGP_DECODED_NOT_LINKED) && (nextCellNo < blockLength)) {
+          instr = getActiveDecodedInstr();
+          continue;
+        }  
       }  
+      // block end or limit reached
+    } else {
+      m_programState.activeCellNo = m_programState.nextCellNo;
     }
-  }  
-  
-  addOperCostById(SGP_OPER_COST_GET_ACT_INSTR);  
-  return res;
+
+    if (!checkThreadedRunState())
+      return false;
+
+    blockNo = m_programState.activeBlockNo;
+    blockLength = m_programCode.getBlockLength(blockNo);
+    instr = getActiveDecodedInstr();
+    
+    if (validateArgs)
+      updateArgTypesProven(blockNo);
+  }
 }
 
-ulong64 sgpVMachine::calcActiveInstrCacheKey()
+bool sgpVMachine::finishThreadedInstr()
 {
-  return
-     m_programState.activeCellNo +
-      (m_programCode.getMaxBlockLength() * m_programState.activeBlockNo);       
+  m_activeInstr = SC_NULL;
+  // register types are not known after exception
+  m_argTypesProven = false;
+  m_provenBlockNo = -1;
+  m_instrCount++;
+  m_programState.activeCellNo = m_programState.nextCellNo;
+  return checkThreadedRunState();
 }
 
-bool sgpVMachine::getActiveInstrFromCache(uint &instrCode, uint &argCount, scDataNode *&args, sgpFunction *&functor)
-{  
-  ulong64 keyNum = calcActiveInstrCacheKey();
-  sgpInstructionInfo *ptr = m_instrCache.find(keyNum);
-  bool res = (ptr != SC_NULL);
-  if (res) {
-    ptr->getActiveInstr(instrCode, argCount, args, functor);   
-  }
+// returns <false> if run is finished
+bool sgpVMachine::checkThreadedRunState()
+{
+  if ((m_errorCount > 0) && (m_errorCount == m_errorLimit))
+    return false; 
+
+  if (isFinished())
+  {
+    if (!m_programState.callStack.empty())
+    { 
+      exitBlock();
+      m_programState.activeCellNo = m_programState.nextCellNo;
+    }  
+    checkNextBlock();
+  }      
+
+  if ((m_instrLimit > 0) && (m_instrCount >= m_instrLimit))
+    return false;
     
-  return res; 
+  return !isFinished();  
 }
 
-void sgpVMachine::addInstrToCache(ulong64 keyNum, uint instrCode, uint argCount, scDataNode *args, sgpFunction *functor)
+void sgpVMachine::checkNextBlock()
 {
-  m_instrCache.insert(keyNum, 
-    new sgpInstructionInfo(instrCode, argCount, args, functor));
+  if (
+       (m_programState.nextBlockNo >= 0) 
+       && 
+       (m_programState.nextBlockNo != static_cast<int>(m_programState.activeBlockNo))
+       &&
+       m_programCode.blockExists(m_programState.nextBlockNo)
+     )
+  {
+    scDataNode blockResult = getOutput();
+    prepareBlockRun(m_programState.nextBlockNo);   
+    setInput(blockResult);
+    setOutput(blockResult); // next block is optional
+  }
 }
 
-void sgpVMachine::clearInstrCache()
+bool sgpVMachine::isFinished()
 {
-  m_instrCache.clear();
+  bool res = true;
+  if (m_programCode.blockExists(m_programState.activeBlockNo)) {
+    res = (m_programState.activeCellNo >= m_programCode.getBlockLength(m_programState.activeBlockNo));
+  }
+  return res;
 }
-  
-void sgpVMachine::getArgValue(const scDataNode &argInfo, scDataNode &output)
+
+void sgpVMachine::runInstr(uint code, const scDataNode &args)
 {
+  uint instrCode;
+  uint argCount;
+  decodeInstr(code, instrCode, argCount);
+  
+  sgpFunction *functor = m_functions.getFunctor(instrCode);
+  argCount = args.size();
+  
+  if (functor == SC_NULL) {
+    argCount = 0;
+    handleUnknownInstr(instrCode, scDataNode());
+  } else {
+    if (!checkArgCount(argCount, functor)) {
+      handleWrongParamCount(code);        
+    } else {
+      // all OK
+      intRunInstr(instrCode, args, functor);
+    }  
+  }  
 }
 
-void sgpVMachine::setArgValue(const scDataNode &argInfo, const scDataNode &value)
+bool sgpVMachine::verifyArgs(const scDataNode &args, sgpFunction *functor)
 {
+  bool staticTypes;
+  uint argNo;
+  bool res;
+  const scDataNode *argMetaPtr;
+  
+  res = checkArgCount(args.size(), functor);  
+
+  if (res) {
+    argMetaPtr = functor->getArgMeta();
+    if (argMetaPtr != SC_NULL) 
+      res = checkArgMeta(args, *argMetaPtr, gatfInput+gatfOutput, argNo, staticTypes);
+  }
+      
+  if (res)
+    res = checkArgsSupported(args, argNo);  
+    
+  return res;  
 }
 
-uint sgpVMachine::getArgType(const scDataNode &argInfo)
+void sgpVMachine::intRunInstr(uint code, const scDataNode &args, sgpFunction *functor)
 {
-  uint res;
-  if (argInfo.isParent())
-    res = argInfo.getUInt("arg_type", gatfConst);
-  else if (argInfo.getValueType() == vt_uint) {
-    if (argInfo.getAsUInt() >= (UINT_MAX - SGP_MAX_REG_NO)) 
-      res = gatfRegister;
-    else
-      res = gatfConst;  
-  } else 
-    res = gatfConst;  
-  return res;
+  assert(functor != SC_NULL);
+  
+  try {
+    if (((ggfValidateArgs & m_features) == 0) || checkInstrArgs(code, args, functor))
+      execInstr(code, args, functor);
+  }  
+  catch(scError &excp) {
+    handleInstrException(excp, code, args, functor);
+  }
+  catch(const std::exception& e) {
+    handleInstrException(e, code, args, functor);
+  }
+  catch(...) {
+    handleInstrException(scString("Unknown"), code, args, functor);
+  }
 }
 
-uint sgpVMachine::getArgDataType(const scDataNode &argInfo)
+// run instruction without exception handling, arguments proven on load are not validated
+void sgpVMachine::runDecodedInstr(const sgpDecodedInstr &instr, bool validateArgs)
 {
-  uint res;
-  if (argInfo.isParent())
-    res = argInfo.getUInt("data_type", gdtfInt);
-  else
-    res = gdtfInt;  
-  return res;
+  if (validateArgs) {
+    switch (instr.argCheck) {
+      case gdacStatic:
+        break;
+      case gdacProven:
+        if (m_argTypesProven) {
+          addOperCostById(SGP_OPER_COST_DYNAMIC_TYPE_ARGS);
+          break;
+        }  
+        // no break - types not proven, validate on run
+      default:
+        if (!checkInstrArgs(instr.instrCode, *instr.args, instr.functor))
+          return;
+        break;  
+    } // switch  
+  }
+  
+  execInstr(instr.instrCode, *instr.args, instr.functor);
 }
 
-bool sgpVMachine::castValue(const scDataNode &value, sgpGvmDataTypeFlag targetType, scDataNode &output)
+// returns <true> if arguments are valid, handles error otherwise
+bool sgpVMachine::checkInstrArgs(uint code, const scDataNode &args, sgpFunction *functor)
 {
-  uint inType = calcDataType(value);
-  
-  if (inType == uint(targetType)) {
-    output = value;
-  } else {   
+  bool argsOk = true;
+  ulong64 keyNum = calcActiveInstrCacheKey();
+         
+  if (!getArgsValidFromCache(keyNum)) {
+    const scDataNode *argMetaPtr;
+    bool staticTypes = false;
+    uint argNo = 0;
+         
+    argMetaPtr = functor->getArgMeta();
+         
+    if (argMetaPtr != SC_NULL) {
+      argsOk = checkArgMeta(args, *argMetaPtr, gatfInput+gatfOutput, argNo, staticTypes);
+      if (!staticTypes) 
+        addOperCostById(SGP_OPER_COST_DYNAMIC_TYPE_ARGS);
+    }           
+    if (argsOk)
+      argsOk = checkArgsSupported(args, argNo);  
+    if (staticTypes && argsOk)
+      setArgsValidInCache(keyNum);  
+    if (!argsOk) {
+      handleWrongArgumentError(code, args, argNo);
+    }  
+  } 
+  
+  return argsOk;
+}
+
+// Proof of register types is kept while control stays inside the same block,
+// it is started again only on block entry (cell 1).
+void sgpVMachine::updateArgTypesProven(uint blockNo)
+{
+  uint callDepth = m_programState.callStack.size();
+  
+  if ((m_provenBlockNo == static_cast<int>(blockNo)) && (m_provenCallDepth == callDepth))
+    return;
+    
+  m_provenBlockNo = blockNo;
+  m_provenCallDepth = callDepth;
+  m_argTypesProven = (m_programState.activeCellNo == 1) && checkEntryArgTypes(blockNo);
+}
+
+// returns <true> if types of dynamic registers match types assumed by type inference of block
+bool sgpVMachine::checkEntryArgTypes(uint blockNo)
+{
+  if (
+      ((ggfValidateArgs & m_features) == 0)
+      ||
+      ((ggfCodeAccessWrite & m_features) != 0)
+      ||
+      ((gatfRef & m_supportedArgTypes) != 0)
+     )
+    return false;
+    
+  sgpDecodedBlock *block = m_decodedProgram.getBlock(blockNo);
+  if (block == SC_NULL)
+    return false;
+    
+  if (!block->typesInferred)
+    inferArgTypes(blockNo, *block);
+    
+  if (!block->typesProvable)
+    return false;
+    
+  for(uint i = 0, epos = block->entryRegs.size(); i != epos; i++)
+    if (getActualArgType(block->entryRegs[i]) != block->entryTypes[i])
+      return false;
+      
+  return true;    
+}
+
+// returns data type of current value of register, the same as calcDataType
+uint sgpVMachine::getActualArgType(uint regNo)
+{
+  scDataNode regValue;
+  
+  if (isStaticTypeRegister(regNo))
+    return getRegisterDefaultDataType(regNo);
+  else if (getRegisterValueInternal(regNo, regValue))
+    return calcDataType(regValue);
+  else
+    return gdtfNull;  
+}
+
+// Infer data types of dynamic registers at each instruction of block, assuming 
+// types of register values on block entry. Arguments of each instruction are 
+// validated once using inferred types:
+// - gdacStatic: only static types used, arguments always valid
+// - gdacProven: arguments valid if block was entered with the same register types
+// - gdacDynamic: type unknown or invalid, arguments validated on run
+// Returns <false> if control flow of block cannot be analysed.
+bool sgpVMachine::inferArgTypes(uint blockNo, sgpDecodedBlock &block)
+{
+  cell_size_t blockLength = m_programCode.getBlockLength(blockNo);
+  std::vector<int> order;                           // instruction indices in code order
+  std::vector<cell_size_t> orderCells;
+  std::vector<int> cellPos(blockLength + 1, -1);    // cell no -> position in order
+  std::vector<int> regSlots(SGP_REGB_VIRTUAL, -1);  // register no -> index in entryRegs
+  cell_size_t cellNo = 1;
+  int instrIndex;
+  bool res = true;
+  
+  block.typesInferred = true;
+  block.typesProvable = false;
+  block.entryRegs.clear();
+  block.entryTypes.clear();
+  
+  if (block.cellIndex.size() < blockLength)
+    res = false;
+  
+  while (res && (cellNo < blockLength)) {
+    instrIndex = block.cellIndex[cellNo];
+    if (instrIndex < 0) {
+      res = false;
+      break;
+    }  
+    cellPos[cellNo] = order.size();
+    order.push_back(instrIndex);
+    orderCells.push_back(cellNo);
+    cellNo += block.instrs[instrIndex].nextCellOffset;
+  }
+  
+  if (res)
+    cellPos[blockLength] = order.size();
+  
+  // registers with dynamic type used by block
+  for(uint pos = 0, epos = order.size(); res && (pos != epos); pos++) {
+    const sgpDecodedInstr &instr = block.instrs[order[pos]];
+    if (instr.status != gdisOk)
+      continue;
+    for(uint argNo = 0; argNo != instr.argCount; argNo++) {
+      const scDataNode &argCell = (*instr.args)[argNo];
+      uint argType = getArgType(argCell);
+      if (argType == gatfRef) {
+        res = false;
+        break;
+      }
+      if (argType != gatfRegister)
+        continue;
+      uint regNo = getRegisterNo(argCell);
+      if ((regNo >= SGP_REGB_VIRTUAL) || isStaticTypeRegister(regNo) || (regSlots[regNo] >= 0))
+        continue;
+      regSlots[regNo] = block.entryRegs.size();
+      block.entryRegs.push_back(regNo);
+      block.entryTypes.push_back(getActualArgType(regNo));
+    }  
+  }
+  
+  // successors of instructions, jump targets must be constant & point to instruction or block end
+  std::vector<std::vector<uint> > nextPos(order.size());
+  scDataNode jumpArgs;
+  
+  for(uint pos = 0, epos = order.size(); res && (pos != epos); pos++) {
+    const sgpDecodedInstr &instr = block.instrs[order[pos]];
+    cell_size_t nextCellNo = orderCells[pos] + instr.nextCellOffset;
+    
+    nextPos[pos].push_back(pos + 1);
+    
+    if ((instr.status != gdisOk) || !instr.functor->isJumpAction())
+      continue;
+      
+    jumpArgs.clear();
+    instr.functor->getJumpArgs(jumpArgs);
+    
+    for(uint i = 0, jumpCnt = jumpArgs.size(); i != jumpCnt; i++) {
+      int jumpArg = jumpArgs.getInt(i);
+      uint jumpArgNo = static_cast<uint>((jumpArg < 0) ? -jumpArg : jumpArg) - 1;
+      ulong64 jumpSize;
+      cell_size_t targetCellNo;
+      
+      if ((jumpArgNo >= instr.argCount) || (getArgType((*instr.args)[jumpArgNo]) != gatfConst)) {
+        res = false;
+        break;
+      }
+      
+      jumpSize = (*instr.args)[jumpArgNo].getAsUInt64();
+      if (jumpArg > 0) {
+        if (jumpSize > blockLength - nextCellNo) {
+          res = false;
+          break;
+        }
+        targetCellNo = nextCellNo + jumpSize;
+      } else {
+        if (jumpSize >= nextCellNo) {
+          res = false;
+          break;
+        }
+        targetCellNo = nextCellNo - jumpSize;
+      }
+      
+      if (cellPos[targetCellNo] < 0) {
+        res = false;
+        break;
+      }
+      nextPos[pos].push_back(cellPos[targetCellNo]);
+    }  
+  }
+  
+  // propagate types until fixpoint, type which differs on joined paths is unknown (0)
+  std::vector<std::vector<uint> > inTypes(order.size());
+  std::vector<bool> visited(order.size(), false);
+  std::vector<uint> worklist;
+  std::vector<uint> outTypes;
+  
+  if (res && !order.empty()) {
+    inTypes[0] = block.entryTypes;
+    visited[0] = true;
+    worklist.push_back(0);
+  }
+  
+  while (!worklist.empty()) {
+    uint pos = worklist.back();
+    worklist.pop_back();
+    
+    outTypes = inTypes[pos];
+    inferInstrArgTypes(block.instrs[order[pos]], regSlots, outTypes);
+    
+    for(uint i = 0, epos = nextPos[pos].size(); i != epos; i++) {
+      uint succPos = nextPos[pos][i];
+      if (succPos >= order.size())
+        continue;
+      
+      if (!visited[succPos]) {
+        inTypes[succPos] = outTypes;
+        visited[succPos] = true;
+        worklist.push_back(succPos);
+      } else {
+        bool changed = false;
+        std::vector<uint> &succTypes = inTypes[succPos];
+        for(uint j = 0, typeCnt = succTypes.size(); j != typeCnt; j++)
+          if ((succTypes[j] != 0) && (succTypes[j] != outTypes[j])) {
+            succTypes[j] = 0;
+            changed = true;
+          }  
+        if (changed)
+          worklist.push_back(succPos);
+      }
+    }
+  }
+  
+  // validate arguments, static types are checked even if block cannot be analysed
+  std::vector<int> instrPos(block.instrs.size(), -1);
+  std::vector<uint> unknownTypes(block.entryRegs.size(), 0);
+  
+  if (res)
+    for(uint pos = 0, epos = order.size(); pos != epos; pos++)
+      instrPos[order[pos]] = pos;
+    
+  for(uint i = 0, epos = block.instrs.size(); i != epos; i++) {
+    int pos = instrPos[i];
+    if ((pos >= 0) && visited[pos])
+      block.instrs[i].argCheck = checkArgsOnLoad(block.instrs[i], regSlots, inTypes[pos]);
+    else  
+      block.instrs[i].argCheck = checkArgsOnLoad(block.instrs[i], regSlots, unknownTypes);
+  }
+  
+  block.typesProvable = res;
+  return res;
+}
+
+// calculate register types after instruction execution
+void sgpVMachine::inferInstrArgTypes(const sgpDecodedInstr &instr, const std::vector<int> &regSlots, 
+  std::vector<uint> &regTypes)
+{
+  if (instr.status != gdisOk)
+    return;
+    
+  sgpFunction *functor = instr.functor;
+  const scDataNode *argMeta = functor->getArgMeta();
+  
+  // registers not listed in arguments can be changed
+  if ((argMeta == SC_NULL) || functor->hasDynamicArgs() || functor->hasSideEffects()) {
+    std::fill(regTypes.begin(), regTypes.end(), 0);
+    return;
+  }
+  
+  uint argCount = instr.argCount;
+  uint metaSize = argMeta->size();
+  uint outputType = 0;
+  uint regNo;
+  
+  // output is always written if arguments are valid & function cannot fail
+  if (
+      (argCount > 0) && (argCount <= SGP_MAX_INSTR_ARG_COUNT) 
+      && 
+      !functor->canFail() 
+      && 
+      (checkArgsOnLoad(instr, regSlots, regTypes) != gdacDynamic)
+     ) 
+  {
+    uint argTypes[SGP_MAX_INSTR_ARG_COUNT];
+    bool argsReadable = true;
+    
+    for(uint i = 0; i != argCount; i++) {
+      const scDataNode &argCell = (*instr.args)[i];
+      argTypes[i] = getArgTypeOnLoad(argCell, regSlots, regTypes);
+      if ((i > 0) && (getArgType(argCell) == gatfRegister) && !canReadRegister(getRegisterNo(argCell)))
+        argsReadable = false;
+    }  
+    
+    const scDataNode &outputArg = (*instr.args)[0];
+    if ((getArgType(outputArg) == gatfRegister) && !isStaticTypeRegister(getRegisterNo(outputArg)))
+      argTypes[0] = gdtfVariant;
+      
+    if (!argsReadable || (functor->getNativeFunc(argTypes, argCount, outputType) == SC_NULL))
+      outputType = 0;
+  }
+  
+  for(uint i = 0; (i != argCount) && (i != metaSize); i++) {
+    if ((getArgMetaParamUInt(*argMeta, i, GASM_ARG_META_IO_MODE) & gatfOutput) == 0)
+      continue;
+      
+    const scDataNode &argCell = (*instr.args)[i];
+    if (getArgType(argCell) != gatfRegister)
+      continue;
+      
+    regNo = getRegisterNo(argCell);
+    if ((regNo >= SGP_REGB_VIRTUAL) || (regSlots[regNo] < 0))
+      continue;
+      
+    if ((i == 0) && (outputType != 0))
+      regTypes[regSlots[regNo]] = outputType;
+    else if (canWriteRegister(regNo))
+      regTypes[regSlots[regNo]] = 0;
+  }
+}
+
+// validate instruction arguments using inferred register types, 
+// uses the same rules as checkArgMeta & checkArgsSupported
+uint sgpVMachine::checkArgsOnLoad(const sgpDecodedInstr &instr, const std::vector<int> &regSlots, 
+  const std::vector<uint> &regTypes)
+{
+  if (instr.status != gdisOk)
+    return gdacDynamic;
+    
+  const scDataNode *argMeta = instr.functor->getArgMeta();
+  uint res = gdacStatic;
+  uint argType, dataType;
+  
+  if (argMeta != SC_NULL) {
+    for(uint i = 0, epos = std::min<uint>(instr.argCount, argMeta->size()); i != epos; i++) {
+      if ((getArgMetaParamUInt(*argMeta, i, GASM_ARG_META_IO_MODE) & (gatfInput + gatfOutput)) == 0)
+        continue;
+        
+      const scDataNode &argCell = (*instr.args)[i];
+      argType = getArgType(argCell);
+      
+      if (argType == gatfRegister) {
+        if (!isStaticTypeRegister(getRegisterNo(argCell)))
+          res = gdacProven;
+      } else if ((argType & (gatfConst + gatfNull)) == 0) {
+        return gdacDynamic;
+      }  
+      
+      if ((argType & getArgMetaParamUInt(*argMeta, i, GASM_ARG_META_ARG_TYPE)) == 0)
+        return gdacDynamic;
+        
+      dataType = getArgTypeOnLoad(argCell, regSlots, regTypes);  
+      if ((dataType & getArgMetaParamUInt(*argMeta, i, GASM_ARG_META_DATA_TYPE)) == 0)
+        return gdacDynamic;
+    }
+  } else {
+  // cost of dynamic validation is always added
+    res = gdacProven;
+  }
+  
+  for(uint i = 0; i != instr.argCount; i++) {
+    const scDataNode &argCell = (*instr.args)[i];
+    if ((getArgTypeOnLoad(argCell, regSlots, regTypes) & m_supportedDataTypes) == 0)
+      return gdacDynamic;
+    if ((getArgType(argCell) & m_supportedArgTypes) == 0)
+      return gdacDynamic;
+  }
+  
+  return res;
+}
+
+// returns data type of argument using inferred register types, 0 if type is unknown
+uint sgpVMachine::getArgTypeOnLoad(const scDataNode &argCell, const std::vector<int> &regSlots, 
+  const std::vector<uint> &regTypes)
+{
+  switch (getArgType(argCell)) {
+    case gatfRegister: {
+      uint regNo = getRegisterNo(argCell);
+      if (isStaticTypeRegister(regNo))
+        return getRegisterDefaultDataType(regNo);
+      if ((regNo < SGP_REGB_VIRTUAL) && (regSlots[regNo] >= 0))
+        return regTypes[regSlots[regNo]];
+      return 0;
+    }
+    case gatfConst:
+    case gatfNull:
+      return calcDataType(argCell);
+    default:
+      return 0;
+  }
+}
+
+void sgpVMachine::execInstr(uint code, const scDataNode &args, sgpFunction *functor)
+{
+  uint funCost;
+      
+  if (functor->execute(args, funCost))
+  {
+    addOperCost(funCost);
+  } else {
+    handleInstrError(code, args, GVM_ERROR_FUNCT_FAIL, "Function failed");
+    addOperCostById(SGP_OPER_COST_FUNC_FAILED);
+  }
+}
+  
+// add cost specified by ID to last oper cost
+void sgpVMachine::addOperCostById(uint a_subOperCostId, uint mult)
+{
+  m_lastOperCost += (getOperCostById(a_subOperCostId) * mult);
+}
+
+uint sgpVMachine::getOperCostById(uint a_subOperCostId)
+{
+  uint cost;
+
+  switch (a_subOperCostId) {
+    case SGP_OPER_COST_UNK_INSTR:
+      cost = 100;
+      break;
+    case SGP_OPER_COST_EXCEPTION:
+      cost = 90;
+      break;
+    case SGP_OPER_COST_ERROR:  
+      cost = 20;
+      break;
+    case SGP_OPER_COST_ARG_CNT_ERROR:  
+      cost = 18;
+      break;
+    default:
+      cost = 1;
+      break;
+  }
+          
+  return cost;
+}
+
+// add cost specified by value
+void sgpVMachine::addOperCost(ulong64 a_cost)
+{
+  m_lastOperCost += a_cost;
+}
+
+// reset after code change
+void sgpVMachine::resetProgram()
+{
+  m_instrCacheRequired = false;
+  initRegisterTemplate();
+  clearArgValidCache();
+  clearInstrCache();
+  m_programState.clearRegisters();
+  m_typedRegsActive = isTypedRegsEnabled();
+  resetWarmWay();
+}
+
+// reset data state, no program change was performed since last reset
+void sgpVMachine::resetWarmWay()
+{
+  m_programState.resetWarmWay();
+  restoreRegisters();
+  m_totalCost = 0;
+  if ((m_features & ggfNotesEnabled) != 0)
+    m_programState.notes = m_notes;
+  clearErrors();
+  clearTrace();
+}
+
+void sgpVMachine::setStartBlockNo(uint blockNo)
+{
+  m_programState.activeBlockNo = blockNo;
+}
+
+void sgpVMachine::prepareBlockRun(uint blockNo)
+{
+  m_programState.resetWarmWay();
+  restoreRegisters();
+  clearInput();
+  clearOutput();
+  m_programState.activeBlockNo = blockNo;
+  m_programState.activeCellNo = m_programState.nextCellNo = 1;
+  m_programState.nextBlockNo = -1;
+}
+
+void sgpVMachine::clearInput()
+{
+#ifdef DEBUG_VMACHINE
+  scLog::addDebug("vmach-clr-inp-beg");
+#endif  
+  scDataNode nullInput;
+  for(uint i = SGP_REGB_INPUT; i <= SGP_REGB_INPUT_MAX; i++)
+    m_programState.activeRegs.setElement(i, nullInput);
+#ifdef DEBUG_VMACHINE
+  scLog::addDebug("vmach-clr-inp-end");
+#endif  
+}
+
+void sgpVMachine::clearOutput()
+{
+  setOutput(scDataNode());
+}
+
+void sgpVMachine::initBlockState(uint blockNo)
+{
+  m_programState.activeBlockNo = blockNo;
+  m_programState.activeCellNo = m_programState.nextCellNo = 1;
+  m_programState.definedRegs.clear();
+  m_programState.references.clear();
+
+  initRegisters();
+}
+
+bool sgpVMachine::getActiveInstrForLog(uint &instrCode, uint &argCount, scString &name)
+{
+  bool res = false;
+  sgpFunction *functor;
+
+  if (m_programCode.blockExists(m_programState.activeBlockNo)) {
+    cell_size_t activeCellNo = m_programState.activeCellNo;
+    scDataNode code;
+    scDataNode cell;
+
+    m_programCode.getBlock(m_programState.activeBlockNo, code);
+    code.getElement(activeCellNo, cell);
+    uint instrCodeCell = cell.getAsUInt();
+    decodeInstr(instrCodeCell, instrCode, argCount);
+    
+    functor = m_functions.getFunctor(instrCode);
+
+    if (functor != SC_NULL) {
+      name = functor->getName();
+      res = true;
+    }
+  }
+  
+  return res;
+}
+
+// returns decoded instruction for active cell, decodes it if needed
+const sgpDecodedInstr *sgpVMachine::getActiveDecodedInstr()
+{
+  bool decoded;
+  
+  if (m_instrCacheInvalid) {
+    m_decodedProgram.clear();
+    m_instrCacheInvalid = false;
+  }  
+  
+  const sgpDecodedInstr *res = 
+    m_decodedProgram.getInstr(m_programCode, m_functions, 
+      m_programState.activeBlockNo, m_programState.activeCellNo, decoded);
+
+  // same cost as for instruction not found in cache    
+  if (decoded || !m_instrCacheRequired)
+    addOperCostById(SGP_OPER_COST_GET_ACT_INSTR);  
+    
+  return res;
+}
+
+void sgpVMachine::handleDecodedInstrError(const sgpDecodedInstr &instr)
+{
+  if (instr.status == gdisUnknownInstr)
+    handleUnknownInstr(instr.instrCode, scDataNode());
+  else  
+    handleWrongParamCount(instr.encodedCode);
+}
+
+ulong64 sgpVMachine::calcActiveInstrCacheKey()
+{
+  return
+     m_programState.activeCellNo +
+      (m_programCode.getMaxBlockLength() * m_programState.activeBlockNo);       
+}
+
+// decoded code can be in use by active instruction - it is released on next fetch
+void sgpVMachine::clearInstrCache()
+{
+  m_instrCacheInvalid = true;
+  m_nativeProgram.clear();
+  m_compiledProgram.reset();
+}
+  
+void sgpVMachine::getArgValue(const scDataNode &argInfo, scDataNode &output)
+{
+}
+
+void sgpVMachine::setArgValue(const scDataNode &argInfo, const scDataNode &value)
+{
+}
+
+uint sgpVMachine::getArgType(const scDataNode &argInfo)
+{
+  uint res;
+  if (argInfo.isParent())
+    res = argInfo.getUInt("arg_type", gatfConst);
+  else if (argInfo.getValueType() == vt_uint) {
+    if (argInfo.getAsUInt() >= (UINT_MAX - SGP_MAX_REG_NO)) 
+      res = gatfRegister;
+    else
+      res = gatfConst;  
+  } else 
+    res = gatfConst;  
+  return res;
+}
+
+uint sgpVMachine::getArgDataType(const scDataNode &argInfo)
+{
+  uint res;
+  if (argInfo.isParent())
+    res = argInfo.getUInt("data_type", gdtfInt);
+  else
+    res = gdtfInt;  
+  return res;
+}
+
+bool sgpVMachine::castValue(const scDataNode &value, sgpGvmDataTypeFlag targetType, scDataNode &output)
+{
+  uint inType = calcDataType(value);
+  
+  if (inType == uint(targetType)) {
+    output = value;
+  } else {   
     initDataNodeAs(targetType, output); 
     if (((inType & gdtfAllBaseXInts) != 0) && ((targetType & gdtfAllBaseFloats) != 0))
     {
@@ -1121,11 +2395,18 @@ bool sgpVMachine::isLastRunOk()
 void sgpVMachine::setProgramState(const sgpProgramState &state)
 {
   m_programState = state;
+  m_programState.syncRegisters(m_registerTemplate);
+  if (m_typedRegsActive)
+    m_programState.loadTypedRegisters();
+  m_nativeProgram.clear();
 }
 
 void sgpVMachine::getProgramState(sgpProgramState &state) const
 {
   state = m_programState;
+  state.syncRegisters(m_registerTemplate);
+  if (m_typedRegsActive)
+    state.storeTypedRegisters();
 }
 
 void sgpVMachine::setProgramCode(const sgpProgramCode &code)
@@ -1134,6 +2415,18 @@ void sgpVMachine::setProgramCode(const sgpProgramCode &code)
   resetProgram();
 }
 
+// use program shared with other vmachines, program is decoded only 
+// if it differs from the one used already
+void sgpVMachine::setCompiledProgram(const sgpCompiledProgramTransporter &program)
+{
+  if ((program.get() != SC_NULL) && (program == m_compiledProgram) && !m_instrCacheInvalid) 
+    return;
+
+  setProgramCode(program->getCode());
+  forceInstrCache();
+  m_compiledProgram = program;
+}
+
 void sgpVMachine::getProgramCode(sgpProgramCode &code) const
 {
   code = m_programCode;
@@ -1142,6 +2435,7 @@ void sgpVMachine::getProgramCode(sgpProgramCode &code) const
 void sgpVMachine::setFunctionList(const sgpFunctionMapColn &functions)
 {
   m_functions.clear();
+  clearInstrCache();
   sgpFunLib::duplicate(functions, m_functions);
 
   for(sgpFunctionMapColn::iterator p = m_functions.begin(); p != m_functions.end(); p++)
@@ -1159,6 +2453,10 @@ uint sgpVMachine::getFeatures()
 void sgpVMachine::setFeatures(uint features)
 {
   m_features = features;
+  updateRegisterBackend();
+  m_nativeProgram.clear();
+  m_compiledProgram.reset();
+  m_decodedProgram.clearArgChecks();
 }
 
 void sgpVMachine::getErrorLog(scStringList &output)
@@ -1189,11 +2487,16 @@ uint sgpVMachine::getSupportedArgTypes()
 void sgpVMachine::setSupportedArgTypes(uint types)
 {
   m_supportedArgTypes = types;
+  updateRegisterBackend();
+  m_nativeProgram.clear();
+  m_decodedProgram.clearArgChecks();
 }
 
 void sgpVMachine::setSupportedDataTypes(uint types)
 {
   m_supportedDataTypes = types;
+  m_nativeProgram.clear();
+  m_decodedProgram.clearArgChecks();
 }
 
 void sgpVMachine::setDefaultDataType(sgpGvmDataTypeFlag a_type)
@@ -1224,6 +2527,8 @@ void sgpVMachine::setMaxAccessPathLength(uint value)
 void sgpVMachine::setExtraRegDataTypes(uint value)
 {
   m_extraRegDataTypes = value;
+  m_nativeProgram.clear();
+  m_decodedProgram.clearArgChecks();
 }
 
 uint sgpVMachine::getExtraRegDataTypes()
@@ -1525,6 +2830,41 @@ void sgpVMachine::handleWrongBlockNo(uint blockNo)
 void sgpVMachine::initRegisters()
 {
   m_programState.activeRegs = m_registerTemplate;
+  if (m_programState.regEpochs.size() < m_registerTemplate.size())
+    m_programState.regEpochs.resize(m_registerTemplate.size(), 0);
+  if (m_typedRegsActive)
+    m_programState.typedRegs = m_typedRegTemplate;
+}
+
+void sgpVMachine::restoreRegisters()
+{
+  m_programState.restoreRegisters(m_registerTemplate);
+  if (m_typedRegsActive)
+    m_programState.typedRegs = m_typedRegTemplate;
+}
+
+// unboxed accumulators cannot hold references
+bool sgpVMachine::isTypedRegsEnabled()
+{
+  return ((m_features & ggfTypedRegsEnabled) != 0) && !isReferenceEnabled();
+}
+
+// switch storage of typed accumulators between boxed & unboxed form
+void sgpVMachine::updateRegisterBackend()
+{
+  bool newActive = isTypedRegsEnabled();
+  
+  if (newActive == m_typedRegsActive)
+    return;
+    
+  if (newActive) {
+    m_programState.syncRegisters(m_registerTemplate);
+    m_programState.loadTypedRegisters();
+  } else { 
+    m_programState.storeTypedRegisters();
+  }
+    
+  m_typedRegsActive = newActive;  
 }
 
 //- #0 - return value(s) - type depends on block
@@ -1638,6 +2978,7 @@ void sgpVMachine::initRegisterTemplate()
       m_registerDataTypes[i] = calcDataType(m_registerTemplate[i]);
   }  
   m_registerTemplateSize = m_registerTemplate.size();  
+  m_typedRegTemplate.loadFrom(m_registerTemplate);
 }
 
 void sgpVMachine::addRegisterTplBlock(sgpGvmDataTypeFlag a_type, uint a_size)
@@ -1862,6 +3203,29 @@ bool sgpVMachine::isRegisterNo(uint value)
     return false;  
 }
 
+// returns <true> if programs using given functions & data types can be executed
+// in numeric profile: data types allow numeric values and each function argument 
+// accepts scalar values
+bool sgpVMachine::isNumericProfileSupported(const sgpFunctionMapColn &functions, uint dataTypes)
+{
+  scDataNode argMeta;
+  
+  if ((dataTypes & (gdtfFloat + gdtfDouble)) == 0)
+    return false;
+    
+  for(sgpFunctionMapColn::const_iterator it = functions.begin(), epos = functions.end(); it != epos; ++it)
+  {
+    argMeta.clear();
+    if (!it->second->getArgMeta(argMeta))
+      continue;
+    for(uint i=0, cnt = argMeta.size(); i != cnt; i++)  
+      if ((getArgMetaParamUInt(argMeta, i, GASM_ARG_META_DATA_TYPE) & gdtfAllScalars) == 0)
+        return false;
+  }
+  
+  return true;
+}
+
 uint sgpVMachine::getRegisterNo(const scDataNode &lvalue)
 {
   uint regNo;
@@ -1921,8 +3285,12 @@ bool sgpVMachine::getRegisterValue(uint regNo, scDataNode &value, bool ignoreRef
     if (!isReadRegErrorLocked() && ((m_features & ggfLogReadErrors) != 0))            
       handleReadDisabled(regNo);
     res = false;
+  } else if (m_typedRegsActive && m_programState.typedRegs.isUnboxed(regNo)) {
+    m_programState.typedRegs.getValue(regNo, value);
+    res = true;
   } else {
     if (regNo < m_programState.activeRegs.size()) {
+      m_programState.syncRegister(regNo, m_registerTemplate);
       m_programState.activeRegs.getElement(regNo, value);
       res = true;  
     } else {
@@ -1952,10 +3320,17 @@ scDataNode *sgpVMachine::getRegisterPtr(uint regNo)
   scDataNode *res;
 
   if (regNo < SGP_REGB_VIRTUAL) {
+    m_programState.syncRegister(regNo, m_registerTemplate);
+    // value can be modified by caller: unboxed accumulator is boxed for the rest of run
+    if (m_typedRegsActive && m_programState.typedRegs.isUnboxed(regNo))
+      m_programState.boxTypedRegister(regNo);
+    m_programState.markRegAsModified(regNo);
     res = &(m_programState.activeRegs.getChildren().at(regNo));
   } else if (regNo == SGP_REGNO_GLOBAL_VARS) {
     res = &(m_programState.globalVars);
   } else if (regNo == SGP_REGNO_PROGRAM_CODE) {
+    // code can be modified by caller: decoded and native code is outdated
+    clearInstrCache();
     res = &(m_programCode.getFullCode());    
   } else {
     res = SC_NULL;
@@ -2008,10 +3383,15 @@ void sgpVMachine::setRegisterValue(uint regNo, const scDataNode &value, bool ign
       //handleError(GVM_ERROR_REG_WRITE_WRONG_TYPE, "Error - wrong value type for reg write, reg no.:"+toString(regNo)+", new value type: "+toString(calcDataType(value)));
       handleRegWriteTypeError(regNo, value);
     } else {    
+      bool unboxed = m_typedRegsActive && m_programState.typedRegs.isUnboxed(regNo);
+      
       if (refsEnabled)
         clearRefsBelow(regNo, scDataNode());
       
-      if (regNo < m_programState.activeRegs.size()) {
+      if (unboxed) {
+        if ((ggfTraceEnabled & m_features) != 0) addToTraceLogChange(regNo, value);
+        m_programState.typedRegs.setValue(regNo, value);
+      } else if (regNo < m_programState.activeRegs.size()) {
         if ((ggfTraceEnabled & m_features) != 0) addToTraceLogChange(regNo, value);
         if (typeRestricted || forceCast)
           m_programState.activeRegs[regNo].assignValueFrom(value);
@@ -2040,7 +3420,9 @@ void sgpVMachine::setRegisterValue(uint regNo, const scDataNode &value, bool ign
         pushValueToValueStack(value);        
       }  
         
-      m_programState.markRegAsModified(regNo);      
+      // unboxed registers are restored as a whole  
+      if (!unboxed)
+        m_programState.markRegAsModified(regNo);      
     } // set OK
   } // is ref
 }
@@ -2682,9 +4064,78 @@ void sgpVMachine::evaluateArg(const scDataNode &input, scDataNode &output)
     }
       
     default:
-      handleError(GVM_ERROR_UNDEF_ARG_TYPE, "Type: "+toString(argType));
+      handleError(GVM_ERROR_UNDEF_ARG_TYPE, "Type: "+toString(argType));
+      break;
+  } // switch  
+}
+
+// Evaluate argument without copying its value. Constants are returned directly
+// from decoded instruction arguments, boxed registers from register file.
+// Returned reference is valid until next register write, <temp> is used 
+// when value has to be calculated (unboxed registers, references).
+// Cost is the same as for evaluateArg.
+const scDataNode &sgpVMachine::evaluateArgRef(const scDataNode &input, scDataNode &temp)
+{
+  const scDataNode *res = SC_NULL;
+  uint dataType;
+  
+  switch (getArgType(input)) { 
+    case gatfConst: {
+      res = &input;
+      
+      addOperCostById(SGP_OPER_COST_EVALUATE_ARG);  
+      addOperCostById(SGP_OPER_COST_EVALUATE_CONST);
+
+      dataType = getArgDataType(input);
+      if ((dataType & (gdtfArray + gdtfStruct + gdtfString)) != 0) {
+        addOperCostById(SGP_OPER_COST_EVALUATE_STRUCT_ARG);
+      } else if ((dataType & gdtfVariant) != 0) {
+        addOperCostById(SGP_OPER_COST_EVALUATE_VARIANT);
+      }  
+      break;
+    }
+
+    case gatfRegister: {
+      uint regNo = getRegisterNo(input);
+      
+      if (
+          (regNo >= m_programState.activeRegs.size()) 
+          || 
+          !canReadRegister(regNo)
+          ||
+          isReferenceEnabled()
+          ||
+          (m_typedRegsActive && m_programState.typedRegs.isUnboxed(regNo))
+         )
+        break;
+        
+      m_programState.syncRegister(regNo, m_registerTemplate);
+      if ((getArgType(m_programState.activeRegs[regNo]) & gatfConst) == 0)
+        break;
+        
+      res = &(m_programState.activeRegs[regNo]);
+      
+      addOperCostById(SGP_OPER_COST_EVALUATE_ARG);  
+      
+      dataType = getArgDataType(*res);
+      if ((dataType & (gdtfArray + gdtfStruct + gdtfString)) != 0) {
+        addOperCostById(SGP_OPER_COST_EVALUATE_STRUCT_ARG);
+      } else if (((dataType & (gdtfVariant)) != 0) || isVariantRegisterFast(regNo)) {
+        addOperCostById(SGP_OPER_COST_EVALUATE_VARIANT);
+      }  
+      break;
+    }  
+    
+    default:
       break;
   } // switch  
+  
+  if (res == SC_NULL) {
+    evaluateArg(input, temp);
+    return temp;
+  }  
+  
+  return *res;
 }
 
 ulong64 sgpVMachine::getTotalCost()
@@ -2700,6 +4151,7 @@ scDataNode sgpVMachine::getOutput()
     throw scError("ActiveRegs are empty!");
 #endif      
   scDataNode res;
+  m_programState.syncRegister(SGP_REGB_OUTPUT, m_registerTemplate);
   m_programState.activeRegs.getElement(SGP_REGB_OUTPUT, res);
   return res;
 }
@@ -2715,115 +4167,668 @@ void sgpVMachine::setOutput(const scDataNode &value)
     scDataNode element;
     for(int i=0,epos = value.size(), cnt = 0; (i != epos) && (cnt < SGP_REGB_OUTPUT_MAX); i++, cnt++)
     {
+      m_programState.syncRegister(SGP_REGB_OUTPUT + cnt, m_registerTemplate);
       m_programState.activeRegs.setElement(SGP_REGB_OUTPUT + cnt, value.getElement(i));      
     }  
   } else { 
   //not an array
+    m_programState.syncRegister(SGP_REGB_OUTPUT + 0, m_registerTemplate);
     m_programState.activeRegs.setElement(SGP_REGB_OUTPUT + 0, value);      
   }  
 }
 
-void sgpVMachine::setInput(const scDataNode &value)
+void sgpVMachine::setInput(const scDataNode &value)
+{
+  assert(!m_programState.activeRegs.empty());
+#ifdef DEBUG_VMACHINE
+  if (m_programState.activeRegs.empty())
+    throw scError("ActiveRegs are empty!");
+#endif      
+  if (value.size() > 0) { 
+    scDataNode element;
+    for(int i=0,epos = value.size(), cnt = 0; (i != epos) && (cnt < SGP_REGB_INPUT_MAX); i++, cnt++)
+    {
+      m_programState.activeRegs.setElement(SGP_REGB_INPUT + cnt, value.getElement(i));      
+    }  
+  } else { 
+  //not an array
+    m_programState.activeRegs.setElement(SGP_REGB_INPUT + 0, value);      
+  }  
+}
+
+// optimize code for repeated executions
+void sgpVMachine::prepareCode(sgpProgramCode &code) const
+{
+  cell_size_t instrCount, effInstrCount;
+  prepareCode(code, instrCount, effInstrCount);
+}
+
+// returns number of instructions before & after preparation (effective code ratio)
+void sgpVMachine::prepareCode(sgpProgramCode &code, cell_size_t &instrCount, cell_size_t &effInstrCount) const
+{
+  instrCount = countInstructions(code);
+  if ((gatfRef & m_supportedArgTypes) == 0) {
+    stripUnusedCodeAfterLastOutWrite(code);
+    stripNonEffectiveCode(code);
+  }  
+  effInstrCount = countInstructions(code);
+}
+
+// expand & prepare code, result can be executed by any vmachine with the same configuration
+sgpCompiledProgramTransporter sgpVMachine::compileProgram(const scDataNode &code) const
+{
+  sgpCompiledProgram *program = new sgpCompiledProgram();
+  sgpCompiledProgramTransporter res(program);
+  
+  program->m_code.setFullCode(code);
+  expandCode(program->m_code);
+  prepareCode(program->m_code, program->m_instrCount, program->m_effInstrCount);
+  return res;
+}
+
+cell_size_t sgpVMachine::countInstructions(const sgpProgramCode &code) const
+{
+  scDataNode blockCode;
+  cell_size_t res = 0;
+  cell_size_t offset, endOffset;
+  uint instrCodeRaw, argCount;
+  
+  for(uint i = 0, epos = code.getBlockCount(); i != epos; i++)
+  {
+    code.getBlockCode(i, blockCode);  
+    offset = 0;
+    endOffset = blockCode.size();
+    while(offset < endOffset) {
+      if (blockCode.getElementType(offset) == vt_uint) {
+        decodeInstr(blockCode.getUInt(offset), instrCodeRaw, argCount);
+        offset += 1 + argCount;
+        res++;
+      } else {
+        offset++;
+      }    
+    }
+  }
+  
+  return res;
+}
+
+void sgpVMachine::stripUnusedCodeAfterLastOutWrite(sgpProgramCode &code) const
+{
+  scDataNode blockCode;
+  cell_size_t instrOffsetForScan, stripPos, endOffset, argOffset;
+  uint instrCode, instrCodeRaw, argCount, argCountFound, argEpos;
+  uint skipSize, regNo, ioMode, argDataTypes;
+  const scDataNode *argMetaPtr;
+  scDataNode tempCode;
+  sgpFunction *functor; 
+  bool codeChanged;
+    
+  for(uint i = 0, epos = code.getBlockCount(); i != epos; i++)
+  {
+    code.getBlockCode(i, blockCode);  
+    codeChanged = false;
+
+    instrOffsetForScan = 0;
+    endOffset = blockCode.size();
+    stripPos = endOffset;
+    
+    while(instrOffsetForScan < endOffset) {
+      skipSize = 1;
+      
+      if (blockCode.getElementType(instrOffsetForScan) == vt_uint) {
+        instrCode = blockCode.getUInt(instrOffsetForScan);      
+        decodeInstr(instrCode, instrCodeRaw, argCount);
+        functor = ::getFunctorForInstrCode(m_functions, instrCodeRaw);
+        argEpos = SC_MIN(instrOffsetForScan+1+argCount, endOffset);
+        argCountFound = argEpos - (instrOffsetForScan + 1);
+        argCount = SC_MIN(argCount, argCountFound);
+        if (functor != SC_NULL) 
+          argMetaPtr = functor->getArgMeta();
+        else
+          argMetaPtr = SC_NULL;  
+        
+        if ((functor != SC_NULL) && (argMetaPtr != SC_NULL))
+        {
+          skipSize = 1 + argCount;
+          
+          if (!functor->isStrippable())
+          {
+            stripPos = instrOffsetForScan + skipSize;
+          } else {            
+            for(uint argNo=0,epos=SC_MIN(argCount, argMetaPtr->size()); argNo != epos; argNo++)
+            {
+              argOffset = instrOffsetForScan + 1 + argNo;
+              ioMode = sgpVMachine::getArgMetaParamUInt(*argMetaPtr, argNo, GASM_ARG_META_IO_MODE);    
+              argDataTypes = sgpVMachine::getArgMetaParamUInt(*argMetaPtr, argNo, GASM_ARG_META_DATA_TYPE);
+              argDataTypes &= m_supportedDataTypes;    
+              
+              if (getArgType(blockCode.getElement(argOffset)) == gatfRegister) {
+                if ((ioMode & gatfOutput) != 0) {              
+                // output reg
+                  regNo = sgpVMachine::getRegisterNo(blockCode.getElement(argOffset));
+                  if (regNo == SGP_REGB_OUTPUT) {
+                    stripPos = instrOffsetForScan + skipSize;
+                  }
+                } 
+              }  
+            } // for
+          } // strippable  
+        } // if functor OK
+      } // if instruction
+      instrOffsetForScan += skipSize;
+    } // while
+    
+    if (stripPos < endOffset) {     
+      blockCode.eraseFrom(stripPos);
+      codeChanged = true;
+    }  
+    
+    if (codeChanged) {
+      code.setBlockCode(i, blockCode);
+    }
+  } // for
+}
+
+// Remove instructions which do not affect block output (introns) using backward 
+// liveness analysis. Only output register is live on block end. Instructions which 
+// cannot be stripped, change control flow or write system registers are always effective.
+// Register is killed only by write of a scalar value - array & struct writes can be partial.
+// Sizes of jumps are updated after strip, blocks with jumps of non-constant size are
+// not changed.
+// With ggfOptimizeCode instructions are simplified before liveness analysis.
+void sgpVMachine::stripNonEffectiveCode(sgpProgramCode &code) const
+{
+  scDataNode blockCode;
+  sgpLivenessInstrVector instrs;
+  bool optimize = ((m_features & ggfOptimizeCode) != 0);
+  
+  for(uint i = 0, epos = code.getBlockCount(); i != epos; i++)
+  {
+    code.getBlockCode(i, blockCode);  
+    
+    if (!prepareLivenessInstrs(blockCode, instrs))
+      continue;
+      
+    if (optimize)
+      optimizeInstrs(instrs);
+      
+    calcLiveness(instrs);
+    
+    if (stripNonEffectiveInstrs(instrs, blockCode))
+      code.setBlockCode(i, blockCode);
+  }
+}
+
+// returns <false> if block cannot be analysed 
+bool sgpVMachine::prepareLivenessInstrs(const scDataNode &blockCode, sgpLivenessInstrVector &instrs) const
+{
+  cell_size_t offset, nextOffset, jumpSize;
+  cell_size_t endOffset = blockCode.size();
+  std::vector<int> cellIndex(endOffset + 1, -1);
+  uint instrCodeRaw, argCount, jumpArgNo;
+  int jumpArg;
+  scDataNode argCell, jumpArgs;
+  sgpLivenessInstr instr;
+  bool stateChanged = false;
+  
+  instrs.clear();
+  offset = 0;
+  
+  while(offset < endOffset) {
+    if (blockCode.getElementType(offset) != vt_uint)
+      return false;
+      
+    instr.code = blockCode.getUInt(offset);
+    decodeInstr(instr.code, instrCodeRaw, argCount);
+    instr.functor = ::getFunctorForInstrCode(m_functions, instrCodeRaw);
+    if ((instr.functor == SC_NULL) || (offset + 1 + argCount > endOffset))
+      return false;
+      
+    instr.offset = offset;
+    instr.size = 1 + argCount;
+    instr.args.clear();
+    for(uint argNo = 0; argNo != argCount; argNo++)
+      instr.args.addChild(blockCode.cloneElement(offset + 1 + argNo));
+    instr.changed = false;  
+    instr.liveIn.clear();
+    instr.jumpArgNos.clear();
+    instr.jumpTargetOffsets.clear();
+    instr.jumpTargets.clear();
+    instr.effective = false;
+    
+    if (!prepareLivenessArgs(instr))
+      return false;
+    
+    // machine state (e.g. push_next_result) can redirect the next write
+    if (stateChanged && !instr.defs.empty()) {
+      instr.fixed = true;
+      stateChanged = false;
+    }  
+    if (instr.functor->hasSideEffects() && instr.defs.empty())
+      stateChanged = true;
+    
+    if (instr.functor->isJumpAction()) {
+      jumpArgs.clear();
+      instr.functor->getJumpArgs(jumpArgs);
+      nextOffset = offset + instr.size;
+      
+      for(uint i = 0, epos = jumpArgs.size(); i != epos; i++) {
+        jumpArg = jumpArgs.getInt(i);
+        jumpArgNo = static_cast<uint>((jumpArg < 0) ? -jumpArg : jumpArg) - 1;
+        if (jumpArgNo >= argCount)
+          return false;
+        argCell = instr.args[jumpArgNo];
+        if (getArgType(argCell) != gatfConst)
+          return false;
+          
+        jumpSize = argCell.getAsUInt64();
+        if (jumpArg > 0) {
+          if (nextOffset + jumpSize > endOffset)
+            return false;
+          instr.jumpTargetOffsets.push_back(nextOffset + jumpSize);
+        } else {
+          // cells are numbered from 1 on run (after block meta)
+          if (nextOffset + 1 <= jumpSize)
+            return false;
+          instr.jumpTargetOffsets.push_back(nextOffset - jumpSize);
+        }  
+        instr.jumpArgNos.push_back(jumpArgNo);
+      }
+    }
+    
+    cellIndex[offset] = instrs.size();
+    instrs.push_back(instr);
+    offset += instr.size;
+  }
+  
+  cellIndex[endOffset] = instrs.size();
+
+  // jump targets must be instructions or block end
+  for(sgpLivenessInstrVector::iterator it = instrs.begin(), epos = instrs.end(); it != epos; ++it)
+    for(uint i = 0, targetCnt = it->jumpTargetOffsets.size(); i != targetCnt; i++) {
+      if (cellIndex[it->jumpTargetOffsets[i]] < 0)
+        return false;
+      it->jumpTargets.push_back(cellIndex[it->jumpTargetOffsets[i]]);
+    }
+  
+  return true;  
+}
+
+// calculate registers used & written by instruction, returns <false> if it cannot be analysed
+bool sgpVMachine::prepareLivenessArgs(sgpLivenessInstr &instr) const
+{
+  uint minArgCount, maxArgCount, metaSize, ioMode, regNo;
+  uint argCount = instr.args.size();
+  sgpFunction *functor = instr.functor;
+  const scDataNode *argMeta = functor->getArgMeta();
+  scDataNode argCell;
+  
+  if (argMeta == SC_NULL)
+    return false;
+  metaSize = argMeta->size();  
+    
+  instr.uses.clear();
+  instr.defs.clear();
+  instr.kills.clear();
+  
+  functor->getArgCount(minArgCount, maxArgCount);
+  // failed instruction does not write output (error, invalid args)
+  bool alwaysWrites = !functor->canFail() && isValidOnPrepare(functor, instr.args);
+  instr.fixed = 
+    !functor->isStrippable() || functor->hasDynamicArgs() || functor->isJumpAction()
+    ||
+    functor->hasSideEffects()
+    ||
+    (argCount < minArgCount) || (argCount > maxArgCount);
+  
+  for(uint argNo = 0; argNo != argCount; argNo++) {
+    argCell = instr.args[argNo];
+    if (getArgType(argCell) == gatfRef)
+      return false;
+    if (getArgType(argCell) != gatfRegister)
+      continue;
+    
+    regNo = getRegisterNo(argCell);
+    // argument without meta is handled as input
+    ioMode = (argNo < metaSize) ? getArgMetaParamUInt(*argMeta, argNo, GASM_ARG_META_IO_MODE) : gatfInput;
+    
+    if ((ioMode & gatfInput) != 0)
+      instr.uses.insert(regNo);
+      
+    if ((ioMode & gatfOutput) != 0) {
+      instr.defs.insert(regNo);
+      if (regNo >= SGP_REGB_VIRTUAL)
+        instr.fixed = true;
+      else if (!alwaysWrites)
+      // output can be left unchanged - previous value is used
+        instr.uses.insert(regNo);
+      else if (
+        isStaticTypeRegister(regNo)
+        ||
+        ((getArgMetaParamUInt(*argMeta, argNo, GASM_ARG_META_DATA_TYPE) & (gdtfArray + gdtfStruct)) == 0)
+      )
+        instr.kills.insert(regNo);
+      else
+      // partial write - previous value is used
+        instr.uses.insert(regNo);
+    }  
+  }
+  
+  // function without register output can have other side effects
+  if (instr.defs.empty())
+    instr.fixed = true;
+    
+  // function can finish block or pass block output
+  if (!functor->isStrippable()) {
+    instr.uses.insert(SGP_REGB_OUTPUT);
+    instr.kills.clear();
+  }  
+  
+  return true;
+}
+
+// Peephole optimization of block: constant-only instructions are folded,
+// identity operations (x*1, x-0...) & double negations are replaced with "move", 
+// move of register to itself is removed. Instructions which are always effective 
+// (side effects, jumps) are not changed. Instruction is changed only if result 
+// is exactly the same: types of arguments must be known on prepare when arguments 
+// are validated.
+void sgpVMachine::optimizeInstrs(sgpLivenessInstrVector &instrs) const
+{
+  uint moveCodeRaw;
+  sgpFunction *moveFunctor;
+  scDataNode value, newArgs, argCell;
+  uint instrCount = instrs.size();
+  std::vector<bool> jumpTargets(instrCount + 1, false);
+  int identityArgNo;
+  bool folded;
+  
+  if (!findFunctionCode("move", moveCodeRaw))
+    return;
+  moveFunctor = ::getFunctorForInstrCode(m_functions, moveCodeRaw);
+    
+  for(uint i = 0; i != instrCount; i++)
+    for(uint j = 0, epos = instrs[i].jumpTargets.size(); j != epos; j++)
+      jumpTargets[instrs[i].jumpTargets[j]] = true;
+      
+  for(uint i = 0; i != instrCount; i++) {
+    sgpLivenessInstr &instr = instrs[i];
+    
+    if (instr.fixed || instr.args.empty())
+      continue;
+      
+    if (!isOptimizableOutput(instr.args[0]) || !isValidOnPrepare(instr.functor, instr.args))
+      continue;
+
+    newArgs.clear();
+    
+    try {
+      folded = instr.functor->foldConstArgs(instr.args, value);
+      identityArgNo = folded ? -1 : instr.functor->getIdentityArgNo(instr.args);
+    }  
+    catch(...) {
+    // constant of wrong type - leave error for run
+      continue;
+    }  
+      
+    if (folded) {
+    // add #x, 2, 3 => move #x, 5
+      newArgs.addChild(new scDataNode(instr.args[0]));
+      newArgs.addChild(new scDataNode(value));
+    } else if (identityArgNo > 0) {
+    // mult #x, #y, 1 => move #x, #y, move #a, #a => (removed)
+      if (
+        (instr.functor == moveFunctor) 
+        ? 
+          (isSameRegister(instr.args[0], instr.args[1]) && (getRegisterNo(instr.args[0]) != SGP_REGB_OUTPUT))
+        : 
+          isExactRegisterPass(instr, identityArgNo, instr.args[0])
+      ) 
+      {
+        newArgs.addChild(new scDataNode(instr.args[0]));
+        newArgs.addChild(new scDataNode(instr.args[identityArgNo]));
+      }  
+    } else if (
+      (i > 0) && !jumpTargets[i] && instr.functor->isInvolution() 
+      && 
+      (instrs[i - 1].functor == instr.functor) && !instrs[i - 1].fixed
+      &&
+      (instrs[i - 1].args.size() == 2) && (instr.args.size() == 2)
+    ) 
+    {
+    // neg #x, #y; neg #z, #x => neg #x, #y; move #z, #y
+      const sgpLivenessInstr &prevInstr = instrs[i - 1];
+      if (
+        isSameRegister(prevInstr.args[0], instr.args[1])
+        &&
+        !isSameRegister(prevInstr.args[0], prevInstr.args[1])
+        &&
+        isExactRegisterPass(prevInstr, 1, prevInstr.args[0])
+        &&
+        isExactRegisterPass(instr, 1, instr.args[0])
+        &&
+        isExactRegisterPass(prevInstr, 1, instr.args[0])
+      )
+      {
+        newArgs.addChild(new scDataNode(instr.args[0]));
+        newArgs.addChild(new scDataNode(prevInstr.args[1]));
+      }  
+    } 
+    
+    if (newArgs.empty())
+      continue;
+      
+    if (!isValidOnPrepare(moveFunctor, newArgs))
+      continue;
+      
+    if (isSameRegister(newArgs[0], newArgs[1])) {
+    // move #a, #a - nothing to do
+      instr.uses.clear();
+      instr.defs.clear();
+      instr.kills.clear();
+      instr.fixed = false;
+    } else {
+      instr.code = encodeInstr(moveCodeRaw, newArgs.size());
+      instr.functor = moveFunctor;
+      instr.args = newArgs;
+      prepareLivenessArgs(instr);
+    }    
+    instr.changed = true;
+  }
+}
+
+// returns <true> if register can be written without error by any instruction
+bool sgpVMachine::isOptimizableOutput(const scDataNode &arg) const
+{
+  if (getArgType(arg) != gatfRegister)
+    return false;
+  
+  uint regNo = getRegisterNo(arg);
+  return 
+    (regNo == SGP_REGB_OUTPUT) 
+    || 
+    ((regNo >= SGP_REGB_ACCUMS) && (regNo < SGP_REGB_VIRTUAL));
+}
+
+bool sgpVMachine::isSameRegister(const scDataNode &arg1, const scDataNode &arg2)
+{
+  return 
+    (getArgType(arg1) == gatfRegister) 
+    && 
+    (getArgType(arg2) == gatfRegister) 
+    && 
+    (getRegisterNo(arg1) == getRegisterNo(arg2));
+}
+
+// returns <true> if value of input argument is passed by function to output register 
+// without conversion: both registers are static typed with the same type which is 
+// handled natively by function
+bool sgpVMachine::isExactRegisterPass(const sgpLivenessInstr &instr, uint inputArgNo, const scDataNode &outputArg) const
+{
+  const scDataNode *argMeta = instr.functor->getArgMeta();
+  const scDataNode &inputArg = instr.args[inputArgNo];
+  uint dataType;
+  
+  if ((argMeta == SC_NULL) || (argMeta->size() <= inputArgNo))
+    return false;
+  
+  if ((getArgType(inputArg) != gatfRegister) || (getArgType(outputArg) != gatfRegister))
+    return false;
+    
+  if (!isStaticTypeRegister(getRegisterNo(inputArg)) || !isStaticTypeRegister(getRegisterNo(outputArg)))
+    return false;
+    
+  dataType = getRegisterDefaultDataType(getRegisterNo(inputArg));
+  if (dataType != getRegisterDefaultDataType(getRegisterNo(outputArg)))
+    return false;
+    
+  return 
+    ((getArgMetaParamUInt(*argMeta, 0, GASM_ARG_META_DATA_TYPE) & dataType) != 0)
+    &&
+    ((getArgMetaParamUInt(*argMeta, inputArgNo, GASM_ARG_META_DATA_TYPE) & dataType) != 0);
+}
+
+// returns <true> if arguments will be accepted on run without error, independently
+// from register values
+bool sgpVMachine::isValidOnPrepare(sgpFunction *functor, const scDataNode &args) const
 {
-  assert(!m_programState.activeRegs.empty());
-#ifdef DEBUG_VMACHINE
-  if (m_programState.activeRegs.empty())
-    throw scError("ActiveRegs are empty!");
-#endif      
-  if (value.size() > 0) { 
-    scDataNode element;
-    for(int i=0,epos = value.size(), cnt = 0; (i != epos) && (cnt < SGP_REGB_INPUT_MAX); i++, cnt++)
-    {
-      m_programState.activeRegs.setElement(SGP_REGB_INPUT + cnt, value.getElement(i));      
-    }  
-  } else { 
-  //not an array
-    m_programState.activeRegs.setElement(SGP_REGB_INPUT + 0, value);      
-  }  
+  if ((m_features & ggfValidateArgs) == 0)
+    return true;
+
+  sgpVMachine *machine = const_cast<sgpVMachine *>(this);  
+  const scDataNode *argMetaPtr = functor->getArgMeta();
+  bool staticTypes = false;
+  uint argNo;
+  
+  if ((argMetaPtr == SC_NULL) || !machine->checkArgCount(args, functor))
+    return false;
+  
+  return 
+    machine->checkArgMeta(args, *argMetaPtr, gatfInput+gatfOutput, argNo, staticTypes)
+    &&
+    staticTypes
+    &&
+    machine->checkArgsSupported(args, argNo);
 }
 
-// optimize code for repeated executions
-void sgpVMachine::prepareCode(sgpProgramCode &code) const
+bool sgpVMachine::findFunctionCode(const scString &name, uint &instrCodeRaw) const
 {
-  if ((gatfRef & m_supportedArgTypes) == 0)
-    stripUnusedCodeAfterLastOutWrite(code);
+  for(sgpFunctionMapColn::const_iterator it = m_functions.begin(), epos = m_functions.end(); it != epos; ++it)
+    if (it->second->getName() == name) {
+      instrCodeRaw = it->first;
+      return true;
+    }  
+  return false;
 }
 
-void sgpVMachine::stripUnusedCodeAfterLastOutWrite(sgpProgramCode &code) const
+// find effective instructions, repeated until nothing changes (because of backward jumps)
+void sgpVMachine::calcLiveness(sgpLivenessInstrVector &instrs)
 {
-  scDataNode blockCode;
-  cell_size_t instrOffsetForScan, stripPos, endOffset, argOffset;
-  uint instrCode, instrCodeRaw, argCount, argCountFound, argEpos;
-  uint skipSize, regNo, ioMode, argDataTypes;
-  const scDataNode *argMetaPtr;
-  scDataNode tempCode;
-  sgpFunction *functor; 
-  bool codeChanged;
-    
-  for(uint i = 0, epos = code.getBlockCount(); i != epos; i++)
-  {
-    code.getBlockCode(i, blockCode);  
-    codeChanged = false;
-
-    instrOffsetForScan = 0;
-    endOffset = blockCode.size();
-    stripPos = endOffset;
+  sgpGasmRegSet liveOut;
+  uint instrCount = instrs.size();
+  bool changed = true;
+  bool effective;
+  
+  while (changed) {
+    changed = false;
     
-    while(instrOffsetForScan < endOffset) {
-      skipSize = 1;
+    for(uint i = instrCount; i > 0; i--) {
+      sgpLivenessInstr &instr = instrs[i - 1];
       
-      if (blockCode.getElementType(instrOffsetForScan) == vt_uint) {
-        instrCode = blockCode.getUInt(instrOffsetForScan);      
-        decodeInstr(instrCode, instrCodeRaw, argCount);
-        functor = ::getFunctorForInstrCode(m_functions, instrCodeRaw);
-        argEpos = SC_MIN(instrOffsetForScan+1+argCount, endOffset);
-        argCountFound = argEpos - (instrOffsetForScan + 1);
-        argCount = SC_MIN(argCount, argCountFound);
-        if (functor != SC_NULL) 
-          argMetaPtr = functor->getArgMeta();
-        else
-          argMetaPtr = SC_NULL;  
+      if (i < instrCount) {
+        liveOut = instrs[i].liveIn;
+      } else {
+        liveOut.clear();
+        liveOut.insert(SGP_REGB_OUTPUT);
+      }
+      
+      for(uint j = 0, epos = instr.jumpTargets.size(); j != epos; j++) {
+        if (instr.jumpTargets[j] < instrCount) {
+          const sgpGasmRegSet &targetLiveIn = instrs[instr.jumpTargets[j]].liveIn;
+          liveOut.insert(targetLiveIn.begin(), targetLiveIn.end());
+        } else {
+          liveOut.insert(SGP_REGB_OUTPUT);
+        }  
+      }
+      
+      effective = instr.fixed;
+      for(sgpGasmRegSet::const_iterator it = instr.defs.begin(), epos = instr.defs.end(); 
+          !effective && (it != epos); ++it)
+        effective = (liveOut.find(*it) != liveOut.end());
         
-        if ((functor != SC_NULL) && (argMetaPtr != SC_NULL))
-        {
-          skipSize = 1 + argCount;
-          
-          if (!functor->isStrippable())
-          {
-            stripPos = instrOffsetForScan + skipSize;
-          } else {            
-            for(uint argNo=0,epos=SC_MIN(argCount, argMetaPtr->size()); argNo != epos; argNo++)
-            {
-              argOffset = instrOffsetForScan + 1 + argNo;
-              ioMode = sgpVMachine::getArgMetaParamUInt(*argMetaPtr, argNo, GASM_ARG_META_IO_MODE);    
-              argDataTypes = sgpVMachine::getArgMetaParamUInt(*argMetaPtr, argNo, GASM_ARG_META_DATA_TYPE);
-              argDataTypes &= m_supportedDataTypes;    
-              
-              if (getArgType(blockCode.getElement(argOffset)) == gatfRegister) {
-                if ((ioMode & gatfOutput) != 0) {              
-                // output reg
-                  regNo = sgpVMachine::getRegisterNo(blockCode.getElement(argOffset));
-                  if (regNo == SGP_REGB_OUTPUT) {
-                    stripPos = instrOffsetForScan + skipSize;
-                  }
-                } 
-              }  
-            } // for
-          } // strippable  
-        } // if functor OK
-      } // if instruction
-      instrOffsetForScan += skipSize;
-    } // while
+      if (effective) {
+        for(sgpGasmRegSet::const_iterator it = instr.kills.begin(), epos = instr.kills.end(); it != epos; ++it)
+          liveOut.erase(*it);
+        liveOut.insert(instr.uses.begin(), instr.uses.end());
+      }
+      
+      if ((effective != instr.effective) || (liveOut != instr.liveIn)) {
+        instr.effective = effective;
+        instr.liveIn = liveOut;
+        changed = true;
+      }
+    }
+  }
+}
+
+// returns <true> if code was changed
+bool sgpVMachine::stripNonEffectiveInstrs(const sgpLivenessInstrVector &instrs, scDataNode &blockCode)
+{
+  uint instrCount = instrs.size();
+  std::vector<cell_size_t> newOffsets(instrCount + 1);
+  cell_size_t newOffset = 0;
+  cell_size_t jumpSize, nextOffset, targetOffset, newSize;
+  scDataNode argCell;
+  bool changed = false;
+  
+  for(uint i = 0; i != instrCount; i++) {
+    newOffsets[i] = newOffset;
+    if (instrs[i].effective)
+      newOffset += (instrs[i].changed ? 1 + instrs[i].args.size() : instrs[i].size);
+    if (!instrs[i].effective || instrs[i].changed)
+      changed = true;  
+  }
+  newOffsets[instrCount] = newOffset;
+  
+  if (!changed)
+    return false;
     
-    if (stripPos < endOffset) {     
-      blockCode.eraseFrom(stripPos);
-      codeChanged = true;
-    }  
+  // update jump sizes before cells are moved (jump instructions are never replaced)
+  for(uint i = 0; i != instrCount; i++) {
+    const sgpLivenessInstr &instr = instrs[i];
     
-    if (codeChanged) {
-      code.setBlockCode(i, blockCode);
+    nextOffset = newOffsets[i] + instr.size;
+    for(uint j = 0, epos = instr.jumpTargets.size(); j != epos; j++) {
+      targetOffset = newOffsets[instr.jumpTargets[j]];
+      if (instr.jumpTargetOffsets[j] > instr.offset)
+        jumpSize = targetOffset - nextOffset;
+      else  
+        jumpSize = nextOffset - targetOffset;
+      blockCode.getElement(instr.offset + 1 + instr.jumpArgNos[j], argCell);  
+      argCell.assignValueFrom(scDataNode(ulong64(jumpSize)));
+      blockCode.setElement(instr.offset + 1 + instr.jumpArgNos[j], argCell);
     }
-  } // for
+  }
+  
+  for(uint i = instrCount; i > 0; i--) {
+    const sgpLivenessInstr &instr = instrs[i - 1];
+    if (!instr.effective) {
+      for(cell_size_t j = 0; j != instr.size; j++)
+        blockCode.eraseElement(instr.offset);
+    } else if (instr.changed) {
+    // replacement is never longer than original instruction
+      newSize = 1 + instr.args.size();
+      blockCode.setElement(instr.offset, scDataNode(instr.code));
+      for(cell_size_t j = 1; j != newSize; j++) {
+        argCell = instr.args[j - 1];
+        blockCode.setElement(instr.offset + j, argCell);
+      }  
+      for(cell_size_t j = newSize; j != instr.size; j++)
+        blockCode.eraseElement(instr.offset + newSize);
+    }
+  }
+  
+  return true;  
 }
 
 void sgpVMachine::expandCode(sgpProgramCode &code, uint firstBlockNo, bool validateOrder) const
@@ -3074,7 +5079,7 @@ bool sgpVMachine::checkArgMeta(const scDataNode &args, const scDataNode &meta, u
   std::auto_ptr<scDataNode> argElementGuard; 
   const scDataNode *argElementPtr = SC_NULL;
   uint argType, dataType;
-  static uint regNo;
+  uint regNo;
   bool useElement = args.isArray();
   bool useMetaElement = meta.isArray();
   
@@ -3140,90 +5145,866 @@ bool sgpVMachine::checkArgMeta(const scDataNode &args, const scDataNode &meta, u
      } // meta info complete
   } // for  
   
-  return res;
+  return res;
+}
+
+bool sgpVMachine::checkArgsSupported(const scDataNode &args, uint &argNo)
+{
+  bool res = true;
+
+  std::auto_ptr<scDataNode> argElementGuard; 
+  const scDataNode *argElementPtr;
+
+  bool useElement = args.isArray();
+
+  if (useElement && args.size()) {
+    argElementGuard.reset(new scDataNode());
+    argElementPtr = argElementGuard.get();
+  } else {
+    argElementPtr = SC_NULL;
+  } 
+ 
+  for(int i=0,epos=args.size(); i!=epos; i++)
+  {
+    if (useElement) 
+      args.getElement(i, *argElementGuard);
+    else
+      argElementPtr = &(args[i]);
+
+    if ((calcDataType(*argElementPtr) & m_supportedDataTypes) == 0)
+    {
+      res = false;
+      argNo = i;
+      break;
+    }    
+    if ((getArgType(*argElementPtr) & m_supportedArgTypes) == 0)
+    {
+      res = false;
+      argNo = i;
+      break;
+    }
+  }  
+  return res;
+}
+
+bool sgpVMachine::checkArgCount(const scDataNode &args, sgpFunction *functor)
+{
+  return checkArgCount(args.size(), functor);
+}
+
+bool sgpVMachine::checkArgCount(uint argCount, sgpFunction *functor)
+{
+  uint minArgCount, maxArgCount;
+  functor->getArgCount(minArgCount, maxArgCount);
+
+  if ((argCount < minArgCount) || ((maxArgCount > 0) && (argCount > maxArgCount))) 
+    return false;
+  else
+    return true;  
+}
+
+void sgpVMachine::lockReadRegError()
+{
+  m_readRegErrorLock++;
+}
+
+void sgpVMachine::unlockReadRegError()
+{
+  if (m_readRegErrorLock > 0)
+    m_readRegErrorLock--;
+}
+
+bool sgpVMachine::isReadRegErrorLocked() const
+{
+  return (m_readRegErrorLock > 0);
+}
+
+void sgpVMachine::skipCells(cell_size_t a_value)
+{
+  m_programState.nextCellNo = m_programState.nextCellNo + a_value;
+  if (m_programState.nextCellNo > m_programCode.getBlockLength(m_programState.activeBlockNo))
+    handleError(GVM_ERROR_WRONG_SKIP, "Invalid skip size: "+toString(a_value));
+}
+
+void sgpVMachine::forceInstrCache()
+{
+  m_instrCacheRequired = true;
+  m_decodedProgram.compile(m_programCode, m_functions);
+  m_instrCacheInvalid = false;
+}
+
+// Run program for each row of input matrix (laneCount x inputCount, row-major).
+// Supported programs are executed instruction by instruction for all rows at once,
+// rows which diverge in an unsupported way (and all rows of unsupported programs) 
+// are executed again one by one. Output & cost of each row is the same as after 
+// scalar run.
+void sgpVMachine::runBatch(const double *inputs, uint laneCount, uint inputCount, uint inputDataType,
+  scDataNode &outputs, sgpBatchCostVector &costs, uint instrLimit)
+{
+  uint blockNo = m_programState.activeBlockNo;
+  cell_size_t instrCount = 0;
+  uint execCost;
+  bool batchOk;
+  int outputSlot;
+  scDataNode element;
+  
+  outputs.clear();
+  costs.resize(laneCount);
+  
+  batchOk = sgpBatchLanes::isNumericType(inputDataType) && prepareBatchPlan(blockNo, instrLimit);
+  
+  if (batchOk) {
+    m_batchLanes.init(laneCount, m_batchSlotRegs.size(), m_programCode.getBlockLength(blockNo), m_errorLimit);
+
+    for(uint slot = 0, slotCount = m_batchSlotRegs.size(); slot != slotCount; slot++) {
+      uint regNo = m_batchSlotRegs[slot];
+      if ((regNo >= SGP_REGB_INPUT) && (regNo - SGP_REGB_INPUT < inputCount)) {
+        for(uint lane = 0; lane != laneCount; lane++)
+          m_batchLanes.setSlotValue(slot, lane, 
+            sgpBatchLanes::castValue(inputs[lane * inputCount + regNo - SGP_REGB_INPUT], inputDataType), 
+            inputDataType);
+      } else {
+        uint dataType;
+        double value;
+        m_registerTemplate.getElement(regNo, element);
+        dataType = castDataNodeToGasmType(element.getValueType());
+        if (dataType == gdtfBool)
+          value = (element.getAsBool() ? 1.0 : 0.0);
+        else if (sgpBatchLanes::isNumericType(dataType))  
+          value = element.getAsDouble();
+        else {
+          value = 0.0;
+          dataType = gdtfNull;
+        }    
+        for(uint lane = 0; lane != laneCount; lane++)
+          m_batchLanes.setSlotValue(slot, lane, value, dataType);
+      }
+    }
+
+    for(sgpBatchInstrVector::const_iterator it = m_batchInstrs.begin(), epos = m_batchInstrs.end(); it != epos; ++it)
+      m_batchLanes.setInstrCell(it->cellNo);
+      
+    for(sgpBatchInstrVector::const_iterator it = m_batchInstrs.begin(), epos = m_batchInstrs.end(); it != epos; ++it)
+    {
+      uint activeCount = m_batchLanes.beginInstr(*it, 
+        m_batchArgs.empty() ? SC_NULL : &m_batchArgs[0] + it->firstArg);
+      if (activeCount == 0)
+        continue;
+      
+      if (!it->instr->functor->executeBatch(m_batchLanes, execCost)) {
+        for(uint lane = 0; lane != laneCount; lane++)
+          if (m_batchLanes.isActive(lane))
+            m_batchLanes.abortLane(lane);
+      }      
+      m_batchLanes.endInstr(execCost);
+      instrCount += activeCount;
+    }
+  }
+
+  outputSlot = batchOk ? m_batchRegSlots[SGP_REGB_OUTPUT] : -1;
+  
+  for(uint lane = 0; lane != laneCount; lane++) {
+    if (!batchOk || (m_batchLanes.getLaneState(lane) == gblsScalar)) {
+      runBatchLaneScalar(inputs + lane * inputCount, inputCount, inputDataType, blockNo, instrLimit, 
+        element, costs[lane]);
+      instrCount += m_instrCount;  
+    } else {
+      if (outputSlot >= 0)
+        m_batchLanes.getSlotValue(outputSlot, lane, element);
+      else
+        m_registerTemplate.getElement(SGP_REGB_OUTPUT, element);
+      costs[lane] = m_batchLanes.getLaneCost(lane);
+    }
+    outputs.addChild(new scDataNode(element));
+  }
+  
+  m_instrCount = instrCount;
+}
+
+void sgpVMachine::runBatchLaneScalar(const double *inputs, uint inputCount, uint inputDataType, uint blockNo, 
+  uint instrLimit, scDataNode &output, ulong64 &cost)
+{
+  runNumeric(inputs, inputCount, inputDataType, blockNo, output, instrLimit);
+  cost = getTotalCost();
+}
+
+// Run program for a single row of numeric input values. 
+// In numeric profile block compiled on previous run is executed directly on 
+// raw input values: boxed registers, stacks & references are not touched, 
+// only unboxed registers are restored. Otherwise state is reset (warm way) 
+// and program is executed in normal way.
+void sgpVMachine::runNumeric(const double *inputs, uint inputCount, uint inputDataType, uint blockNo, 
+  scDataNode &output, uint instrLimit)
+{
+  if (!prepareNumericRun(inputCount, inputDataType, blockNo, instrLimit)) {
+    scDataNode input, element;
+    
+    for(uint i=0; i != inputCount; i++) {
+      sgpBatchLanes::buildValue(sgpBatchLanes::castValue(inputs[i], inputDataType), inputDataType, element);
+      input.addChild(new scDataNode(element));
+    }
+      
+    resetWarmWay();
+    setInput(input);
+    setStartBlockNo(blockNo);
+    run(instrLimit);
+    output = getOutput();
+    return;
+  }
+  
+  intRunNumeric(inputs, inputDataType, SC_NULL, 0, 0, SC_NULL, output);
+}
+
+// Run program for a single row of numeric input values, stores state of compiled block 
+// run in <checkpointCount> places (evenly distributed). Checkpoints are not created
+// if block is not executed natively.
+void sgpVMachine::runNumeric(const double *inputs, uint inputCount, uint inputDataType, uint blockNo, 
+  scDataNode &output, uint instrLimit, uint checkpointCount, sgpNumericCheckpointVector &checkpoints)
+{
+  if (!prepareNumericRun(inputCount, inputDataType, blockNo, instrLimit)) {
+    runNumeric(inputs, inputCount, inputDataType, blockNo, output, instrLimit);
+    return;
+  }  
+
+  intRunNumeric(inputs, inputDataType, SC_NULL, 0, checkpointCount, &checkpoints, output);
+}
+
+// Resume run of compiled block from checkpoint created for the same input values 
+// by program which code before checkpoint is the same as code of active program.
+// Returns <false> if run cannot be resumed - nothing is executed then.
+bool sgpVMachine::resumeNumeric(const sgpNumericCheckpoint &checkpoint, const double *inputs, uint inputCount, 
+  uint inputDataType, uint blockNo, scDataNode &output, uint instrLimit, 
+  uint checkpointCount, sgpNumericCheckpointVector &checkpoints)
+{
+  if (!prepareNumericRun(inputCount, inputDataType, blockNo, instrLimit))
+    return false;
+
+  // instructions are sorted by cell  
+  uint instrIdx = 0;
+  uint instrCount = m_nativeProgram.instrs.size();
+  
+  while ((instrIdx < instrCount) && (m_nativeProgram.instrs[instrIdx].cellNo < checkpoint.cellNo))
+    instrIdx++;
+    
+  if ((instrIdx < instrCount) && (m_nativeProgram.instrs[instrIdx].cellNo != checkpoint.cellNo))
+    return false;
+  if ((instrIdx == instrCount) && (m_nativeProgram.blockLength != checkpoint.cellNo))
+    return false;
+    
+  intRunNumeric(inputs, inputDataType, &checkpoint, instrIdx, checkpointCount, &checkpoints, output);
+  return true;
 }
 
-bool sgpVMachine::checkArgsSupported(const scDataNode &args, uint &argNo)
+// execute compiled block on raw input values, from the beginning or from checkpoint
+void sgpVMachine::intRunNumeric(const double *inputs, uint inputDataType, const sgpNumericCheckpoint *checkpoint, 
+  uint instrIdx, uint checkpointCount, sgpNumericCheckpointVector *checkpoints, scDataNode &output)
 {
-  bool res = true;
+  bool outputWritten = false;
+  uint checkpointStep = 0;
+  
+  for(uint i=0, epos = m_nativeProgram.inputRegs.size(); i != epos; i++) {
+    uint regNo = m_nativeProgram.inputRegs[i];
+    sgpTypedRegFile::setUnboxedValue(m_nativeIoRegs[regNo], inputDataType, 
+      inputs[regNo - SGP_REGB_INPUT]);
+  }
+  
+  m_programState.typedRegs = m_typedRegTemplate;
+  m_totalCost = 0;
+  clearErrors();
+  prepareRun();
+  
+  if (checkpoint != SC_NULL) {
+    std::copy(checkpoint->regs, checkpoint->regs + SGP_TYPED_REG_COUNT, m_programState.typedRegs.values);
+    m_nativeIoRegs[SGP_REGB_OUTPUT] = checkpoint->outputValue;
+    outputWritten = checkpoint->outputWritten;
+    m_totalCost = checkpoint->cost;
+    m_errorCount = checkpoint->errorCount;
+    m_instrCount = checkpoint->instrCount;
+  }
+  
+  if ((checkpoints != SC_NULL) && (checkpointCount > 0))
+    checkpointStep = std::max<uint>(1, m_nativeProgram.instrs.size() / (checkpointCount + 1));
+    
+  beforeRun();
+  runNativeChain(instrIdx, checkpointStep, checkpoints, outputWritten);
+  afterRun();
+  
+  if (outputWritten)
+    sgpTypedRegFile::getUnboxedValue(m_nativeIoRegs[SGP_REGB_OUTPUT], m_nativeProgram.outputType, output);
+  else
+    m_registerTemplate.getElement(SGP_REGB_OUTPUT, output);
+}
 
-  std::auto_ptr<scDataNode> argElementGuard; 
-  const scDataNode *argElementPtr;
+// returns <true> if numeric run can be performed using block compiled before
+bool sgpVMachine::prepareNumericRun(uint inputCount, uint inputDataType, uint blockNo, uint instrLimit)
+{
+  if (
+       ((ggfNumericProfile & m_features) == 0) || ((ggfNativeRun & m_features) == 0) 
+       || 
+       !m_typedRegsActive || !sgpBatchLanes::isNumericType(inputDataType)
+     )
+    return false;
 
-  bool useElement = args.isArray();
+  if (!m_nativeProgram.compiled || !m_nativeProgram.valid || (m_nativeProgram.blockNo != blockNo))
+    return false;
+    
+  if ((instrLimit > 0) && (m_nativeProgram.instrs.size() >= instrLimit))
+    return false;
+    
+  for(uint i=0, epos = m_nativeProgram.inputRegs.size(); i != epos; i++) {
+    if (
+         (m_nativeProgram.inputRegs[i] - SGP_REGB_INPUT >= inputCount) 
+         || 
+         (m_nativeProgram.inputTypes[i] != inputDataType)
+       )
+      return false;
+  }
+  
+  return true;
+}
 
-  if (useElement && args.size()) {
-    argElementGuard.reset(new scDataNode());
-    argElementPtr = argElementGuard.get();
-  } else {
-    argElementPtr = SC_NULL;
-  } 
- 
-  for(int i=0,epos=args.size(); i!=epos; i++)
-  {
-    if (useElement) 
-      args.getElement(i, *argElementGuard);
-    else
-      argElementPtr = &(args[i]);
+// returns <false> if block cannot be executed in batch mode
+bool sgpVMachine::prepareBatchPlan(uint blockNo, uint instrLimit)
+{
+  bool validateArgs = argValidationEnabled();
+  bool decoded, staticTypes;
+  const sgpDecodedInstr *instr;
+  const scDataNode *argMeta;
+  sgpBatchInstr batchInstr;
+  sgpBatchArg batchArg;
+  cell_size_t blockLength, cellNo;
+  
+  m_batchInstrs.clear();
+  m_batchArgs.clear();
+  m_batchSlotRegs.clear();
+  m_batchRegSlots.assign(SGP_REGB_VIRTUAL, -1);
 
-    if ((calcDataType(*argElementPtr) & m_supportedDataTypes) == 0)
-    {
-      res = false;
-      argNo = i;
+  // batch run follows threaded engine rules
+  if (((ggfThreadedRun & m_features) == 0) || ((ggfTraceEnabled & m_features) != 0) || isReferenceEnabled())
+    return false;
+  
+  if (!m_programCode.blockExists(blockNo))
+    return false;
+  
+  if (!m_instrCacheRequired || m_instrCacheInvalid || m_decodedProgram.empty())
+    forceInstrCache();
+    
+  blockLength = m_programCode.getBlockLength(blockNo);
+  cellNo = 1;
+    
+  while (cellNo < blockLength) {
+    instr = m_decodedProgram.getInstr(m_programCode, m_functions, blockNo, cellNo, decoded);
+    if ((instr->status != gdisOk) || !instr->functor->hasBatchKernel())
+      return false;
+      
+    argMeta = instr->functor->getArgMeta();
+    if ((argMeta == SC_NULL) || (argMeta->size() < instr->argCount))
+      return false;
+      
+    batchInstr.instr = instr;
+    batchInstr.cellNo = cellNo;
+    batchInstr.firstArg = m_batchArgs.size();
+    batchInstr.validateCost = 0;
+    staticTypes = true;
+    
+    for(uint i=0; i != instr->argCount; i++) {
+      if (!prepareBatchArg((*instr->args)[i], argMeta, i, validateArgs, batchArg, staticTypes))
+        return false;
+      m_batchArgs.push_back(batchArg);  
+    }
+    
+    if (validateArgs && !staticTypes)
+      batchInstr.validateCost = getOperCostById(SGP_OPER_COST_DYNAMIC_TYPE_ARGS);
+      
+    m_batchInstrs.push_back(batchInstr);  
+    cellNo += instr->nextCellOffset;
+  }
+  
+  // instruction limit is not checked inside of batch, block has to be shorter
+  if ((instrLimit > 0) && (m_batchInstrs.size() >= instrLimit))
+    return false;
+  
+  return true;  
+}
+
+// prepare argument for batch run using the same rules as checkInstrArgs & evaluateArg
+bool sgpVMachine::prepareBatchArg(const scDataNode &argCell, const scDataNode *argMeta, uint argNo, 
+  bool validateArgs, sgpBatchArg &output, bool &staticTypes)
+{
+  uint ioMode = getArgMetaParamUInt(*argMeta, argNo, GASM_ARG_META_IO_MODE);
+  uint dataType;
+  
+  output.argType = getArgType(argCell);
+  output.slot = 0;
+  output.regType = gdtfNull;
+  output.constValue = 0.0;
+  output.constType = gdtfNull;
+  output.evalCost = getOperCostById(SGP_OPER_COST_EVALUATE_ARG);
+  output.laneTypeMask = 0;
+  
+  if (argCell.isParent())
+    return false;
+  
+  switch (output.argType) {
+    case gatfRegister: {
+      uint regNo = getRegisterNo(argCell);
+      if (!isBatchRegisterSupported(regNo))
+        return false;
+      if (((ioMode & gatfInput) != 0) && !canReadRegister(regNo))  
+        return false;
+      if (((ioMode & gatfOutput) != 0) && !canWriteRegister(regNo))  
+        return false;
+        
+      if (m_batchRegSlots[regNo] < 0) {
+        m_batchRegSlots[regNo] = m_batchSlotRegs.size();
+        m_batchSlotRegs.push_back(regNo);
+      }  
+      output.slot = m_batchRegSlots[regNo];
+      
+      if (isStaticTypeRegister(regNo)) {
+        output.regType = getRegisterDefaultDataType(regNo);
+        dataType = output.regType;
+      } else {
+        output.regType = gdtfVariant;
+        dataType = 0;
+        staticTypes = false;
+      }
+      
+      if (isVariantRegisterFast(regNo))
+        output.evalCost += getOperCostById(SGP_OPER_COST_EVALUATE_VARIANT);
       break;
-    }    
-    if ((getArgType(*argElementPtr) & m_supportedArgTypes) == 0)
-    {
-      res = false;
-      argNo = i;
+    }  
+    case gatfConst: {
+      output.constType = castDataNodeToGasmType(argCell.getValueType());
+      if (output.constType == gdtfBool)
+        output.constValue = (argCell.getAsBool() ? 1.0 : 0.0);
+      else if (sgpBatchLanes::isNumericType(output.constType))
+        output.constValue = argCell.getAsDouble();
+      else
+        return false;  
+      dataType = output.constType;  
+      output.evalCost += getOperCostById(SGP_OPER_COST_EVALUATE_CONST);
       break;
+    }  
+    case gatfNull:
+      dataType = gdtfNull;
+      break;
+    default:
+      return false;
+  } // switch  
+  
+  if (validateArgs) {
+    uint allowedTypes = m_supportedDataTypes;
+    
+    if ((output.argType & m_supportedArgTypes) == 0)
+      return false;
+      
+    if ((ioMode & (gatfInput + gatfOutput)) != 0) {
+      if ((output.argType & getArgMetaParamUInt(*argMeta, argNo, GASM_ARG_META_ARG_TYPE)) == 0)
+        return false;
+      allowedTypes &= getArgMetaParamUInt(*argMeta, argNo, GASM_ARG_META_DATA_TYPE);
     }
-  }  
-  return res;
+    
+    if (dataType == 0)
+    // dynamic register - verified for each lane separately
+      output.laneTypeMask = allowedTypes;
+    else if ((dataType & allowedTypes) == 0)
+      return false;
+      
+    if (allowedTypes == 0)
+      return false;  
+  }
+    
+  return true;  
 }
 
-bool sgpVMachine::checkArgCount(const scDataNode &args, sgpFunction *functor)
+bool sgpVMachine::isBatchRegisterSupported(uint regNo) const
 {
-  return checkArgCount(args.size(), functor);
+  if ((regNo >= SGP_REGB_VIRTUAL) || (regNo >= m_registerTemplateSize))
+    return false;
+    
+  switch (m_registerDataTypes[regNo]) {
+    case gdtfVariant:
+    case gdtfInt:
+    case gdtfFloat:
+    case gdtfDouble:
+    case gdtfBool:
+      return true;
+    default:
+      return false;  
+  }  
 }
 
-bool sgpVMachine::checkArgCount(uint argCount, sgpFunction *functor)
+// returns <true> if active block can be executed as compiled chain of native functions
+bool sgpVMachine::prepareNativeRun()
 {
-  uint minArgCount, maxArgCount;
-  functor->getArgCount(minArgCount, maxArgCount);
+  uint blockNo = m_programState.activeBlockNo;
+  
+  if ((m_programState.activeCellNo != 1) || !m_programState.callStack.empty())
+    return false;
 
-  if ((argCount < minArgCount) || ((maxArgCount > 0) && (argCount > maxArgCount))) 
+  if (!m_nativeProgram.compiled || (m_nativeProgram.blockNo != blockNo))
+    m_nativeProgram.valid = compileNative(blockNo, m_nativeProgram);
+    
+  if (!m_nativeProgram.valid)
     return false;
-  else
-    return true;  
+
+  // instruction limit is not checked inside of compiled block, block has to be shorter
+  if ((m_instrLimit > 0) && (m_nativeProgram.instrs.size() >= m_instrLimit))
+    return false;
+    
+  // input types are fixed on compile  
+  for(uint i=0, epos = m_nativeProgram.inputRegs.size(); i != epos; i++) {
+    const scDataNode &value = m_programState.activeRegs[m_nativeProgram.inputRegs[i]];
+    if (castDataNodeToGasmType(value.getValueType()) != m_nativeProgram.inputTypes[i])
+      return false;
+  }
+  
+  return true;  
 }
 
-void sgpVMachine::lockReadRegError()
+// Compile block to chain of native functions with operands bound to unboxed registers.
+// Costs, errors & limits are calculated using the same rules as in threaded engine.
+// Note: functions with native version evaluate each input & set each output argument once.
+// Returns <false> if block cannot be executed natively.
+bool sgpVMachine::compileNative(uint blockNo, sgpNativeProgram &output)
+{
+  bool validateArgs = argValidationEnabled();
+  bool decoded, staticTypes;
+  const sgpDecodedInstr *instr;
+  const scDataNode *argMeta;
+  std::vector<const sgpDecodedInstr *> decodedInstrs;
+  std::vector<int> cellIndex;
+  sgpNativeInstr nativeInstr;
+  uint argTypes[SGP_NATIVE_MAX_ARG_COUNT];
+  uint allowedTypes[SGP_NATIVE_MAX_ARG_COUNT];
+  uint argCount = 0;
+  uint ioMode, argEvalCost, evalCost, setCost, validateCost, resultType, execCost;
+  int outputArgNo;
+  cell_size_t cellNo;
+  scDataNode jumpArgs;
+  
+  output.clear();
+  output.compiled = true;
+  output.blockNo = blockNo;
+  
+  // native run follows threaded engine rules, errors are not logged
+  if (
+       ((ggfThreadedRun & m_features) == 0) || ((ggfTraceEnabled & m_features) != 0) 
+       || 
+       ((ggfLogErrors & m_features) != 0) || !m_typedRegsActive
+     )
+    return false;
+  
+  if (!m_programCode.blockExists(blockNo))
+    return false;
+  
+  if (!m_instrCacheRequired || m_instrCacheInvalid || m_decodedProgram.empty())
+    forceInstrCache();
+    
+  output.blockLength = m_programCode.getBlockLength(blockNo);
+  cellIndex.assign(output.blockLength + 1, -1);
+  cellNo = 1;
+    
+  while (cellNo < output.blockLength) {
+    instr = m_decodedProgram.getInstr(m_programCode, m_functions, blockNo, cellNo, decoded);
+    if ((instr->status != gdisOk) || (instr->argCount > SGP_NATIVE_MAX_ARG_COUNT))
+      return false;
+    cellIndex[cellNo] = decodedInstrs.size();
+    decodedInstrs.push_back(instr);
+    argCount += instr->argCount;
+    cellNo += instr->nextCellOffset;
+  }
+  
+  if (cellNo == output.blockLength)
+    cellIndex[cellNo] = decodedInstrs.size();
+  
+  // arguments point to constants, so vector cannot be reallocated
+  output.consts.reserve(argCount);
+  output.instrs.reserve(decodedInstrs.size());
+  cellNo = 1;
+  
+  for(uint k=0, epos = decodedInstrs.size(); k != epos; k++) {
+    instr = decodedInstrs[k];
+    argMeta = instr->functor->getArgMeta();
+    if ((argMeta == SC_NULL) || (argMeta->size() < instr->argCount))
+      return false;
+      
+    nativeInstr.func = SC_NULL;
+    nativeInstr.jumpTarget = k + 1;
+    nativeInstr.cellNo = cellNo;
+    nativeInstr.writesOutput = false;
+    for(uint i=0; i != SGP_NATIVE_MAX_ARG_COUNT; i++)
+      nativeInstr.args[i] = SC_NULL;
+      
+    evalCost = setCost = validateCost = 0;
+    outputArgNo = -1;
+    staticTypes = true;
+    
+    for(uint i=0; i != instr->argCount; i++) {
+      if (!prepareNativeArg((*instr->args)[i], argMeta, i, validateArgs, output, 
+             nativeInstr.args[i], argTypes[i], argEvalCost, allowedTypes[i], staticTypes))
+        return false;
+        
+      ioMode = getArgMetaParamUInt(*argMeta, i, GASM_ARG_META_IO_MODE);
+      if ((ioMode & gatfInput) != 0)
+        evalCost += argEvalCost;
+      if ((ioMode & gatfOutput) != 0) {
+        setCost += getOperCostById(SGP_OPER_COST_SET_LVALUE);
+        if (nativeInstr.args[i] == &m_nativeIoRegs[SGP_REGB_OUTPUT]) {
+          nativeInstr.writesOutput = true;
+          outputArgNo = i;
+        }  
+      }  
+    }
+    
+    nativeInstr.func = instr->functor->getNativeFunc(argTypes, instr->argCount, resultType, execCost);
+    if (nativeInstr.func == SC_NULL)
+      return false;
+      
+    if (nativeInstr.writesOutput) {
+      if (output.outputType == gdtfNull)
+        output.outputType = resultType;
+      else if (output.outputType != resultType)  
+        return false;
+      // output register is empty before first write  
+      if (validateArgs && (
+           ((allowedTypes[outputArgNo] & gdtfNull) == 0) 
+           || 
+           ((allowedTypes[outputArgNo] & resultType) == 0)
+         ))
+        return false;  
+    }  
+    
+    if (instr->functor->isJumpAction()) {
+      ulong64 jumpSize;
+      cell_size_t targetCellNo;
+      int jumpArgNo;
+      
+      jumpArgs.clear();
+      instr->functor->getJumpArgs(jumpArgs);
+      if (jumpArgs.size() != 1)
+        return false;
+      jumpArgNo = jumpArgs.getInt(0) - 1;
+      if ((jumpArgNo < 0) || (jumpArgNo >= static_cast<int>(instr->argCount)))
+        return false;
+      if (getArgType((*instr->args)[jumpArgNo]) != gatfConst)
+        return false;
+        
+      jumpSize = (*instr->args)[jumpArgNo].getAsUInt64();
+      if (jumpSize > output.blockLength)
+        return false;
+      targetCellNo = cellNo + instr->nextCellOffset + jumpSize;
+      // target must be an instruction or block end
+      if ((targetCellNo > output.blockLength) || (cellIndex[targetCellNo] < 0))
+        return false;
+      nativeInstr.jumpTarget = cellIndex[targetCellNo];  
+    }
+    
+    if (validateArgs && !staticTypes)
+      validateCost = getOperCostById(SGP_OPER_COST_DYNAMIC_TYPE_ARGS);
+      
+    nativeInstr.cost = validateCost + evalCost + setCost + execCost;
+    nativeInstr.failCost = 
+      validateCost + evalCost 
+      + 
+      2 * getOperCostById(SGP_OPER_COST_ERROR) 
+      + 
+      getOperCostById(SGP_OPER_COST_FUNC_FAILED);
+      
+    output.instrs.push_back(nativeInstr);
+    cellNo += instr->nextCellOffset;
+  }
+  
+  return true;
+}
+
+// bind argument to unboxed storage using the same rules as checkInstrArgs & evaluateArg, 
+// returns <false> if argument is not supported
+bool sgpVMachine::prepareNativeArg(const scDataNode &argCell, const scDataNode *argMeta, uint argNo, 
+  bool validateArgs, sgpNativeProgram &program, sgpTypedRegValue *&argPtr, uint &argType, 
+  uint &evalCost, uint &allowedTypes, bool &staticTypes)
 {
-  m_readRegErrorLock++;
+  uint ioMode = getArgMetaParamUInt(*argMeta, argNo, GASM_ARG_META_IO_MODE);
+  uint cellType = getArgType(argCell);
+  bool outputReg = false;
+  
+  argPtr = SC_NULL;
+  argType = gdtfNull;
+  evalCost = getOperCostById(SGP_OPER_COST_EVALUATE_ARG);
+  allowedTypes = gdtfAll;
+  
+  if (argCell.isParent())
+    return false;
+
+  switch (cellType) {
+    case gatfRegister: {
+      uint regNo = getRegisterNo(argCell);
+      
+      if (((ioMode & gatfInput) != 0) && !canReadRegister(regNo))  
+        return false;
+      if (((ioMode & gatfOutput) != 0) && !canWriteRegister(regNo))  
+        return false;
+        
+      if (regNo == SGP_REGB_OUTPUT) {
+        if ((ioMode & gatfInput) != 0)
+          return false;
+        argPtr = &m_nativeIoRegs[regNo];
+        argType = ((program.outputType == gdtfNull) ? gdtfVariant : program.outputType);
+        outputReg = true;
+        staticTypes = false;
+      } else if (regNo < SGP_REGB_ACCUMS) {
+        if ((ioMode & gatfOutput) != 0)
+          return false;
+        argPtr = &m_nativeIoRegs[regNo];
+        argType = castDataNodeToGasmType(m_programState.activeRegs[regNo].getValueType());
+        if ((argType & gdtfAllScalars) == 0)
+          return false;
+        if (std::find(program.inputRegs.begin(), program.inputRegs.end(), regNo) == program.inputRegs.end()) {
+          program.inputRegs.push_back(regNo);
+          program.inputTypes.push_back(argType);
+        }  
+        staticTypes = false;
+      } else if (m_programState.typedRegs.isUnboxed(regNo)) {
+        argPtr = &m_programState.typedRegs.values[regNo - SGP_REGB_ACCUMS];
+        argType = m_programState.typedRegs.dataTypes[regNo - SGP_REGB_ACCUMS];
+      } else {
+        return false;
+      }
+      
+      if (isVariantRegisterFast(regNo))
+        evalCost += getOperCostById(SGP_OPER_COST_EVALUATE_VARIANT);
+      break;
+    }  
+    case gatfConst: {
+      argType = castDataNodeToGasmType(argCell.getValueType());
+      if ((argType & gdtfAllScalars) == 0)
+        return false;
+      program.consts.push_back(sgpTypedRegValue());  
+      argPtr = &program.consts.back();
+      sgpTypedRegFile::setUnboxedValue(*argPtr, argType, argCell);
+      evalCost += getOperCostById(SGP_OPER_COST_EVALUATE_CONST);
+      break;
+    }  
+    default:
+      return false;
+  } // switch  
+  
+  if (validateArgs) {
+    allowedTypes = m_supportedDataTypes;
+    
+    if ((cellType & m_supportedArgTypes) == 0)
+      return false;
+      
+    if ((ioMode & (gatfInput + gatfOutput)) != 0) {
+      if ((cellType & getArgMetaParamUInt(*argMeta, argNo, GASM_ARG_META_ARG_TYPE)) == 0)
+        return false;
+      allowedTypes &= getArgMetaParamUInt(*argMeta, argNo, GASM_ARG_META_DATA_TYPE);
+    }
+    
+    // output register type is verified after compile of instruction
+    if (!outputReg && ((argType & allowedTypes) == 0))
+      return false;
+  }
+    
+  return true;  
 }
 
-void sgpVMachine::unlockReadRegError()
+// Execute compiled block. Error limit is verified after each failed instruction. 
+// Jumps are forward only and block is shorter than instruction limit, so 
+// instruction limit cannot be reached.
+void sgpVMachine::intRunNative()
 {
-  if (m_readRegErrorLock > 0)
-    m_readRegErrorLock--;
+  bool outputWritten;
+  
+  for(uint i=0, epos = m_nativeProgram.inputRegs.size(); i != epos; i++) {
+    uint regNo = m_nativeProgram.inputRegs[i];
+    sgpTypedRegFile::setUnboxedValue(m_nativeIoRegs[regNo], m_nativeProgram.inputTypes[i], 
+      m_programState.activeRegs[regNo]);
+  }    
+    
+  m_programState.activeCellNo = runNativeChain(outputWritten);
+  
+  if (outputWritten) {
+    scDataNode value;
+    sgpTypedRegFile::getUnboxedValue(m_nativeIoRegs[SGP_REGB_OUTPUT], m_nativeProgram.outputType, value);
+    m_programState.activeRegs.setElement(SGP_REGB_OUTPUT, value);
+    m_programState.markRegAsModified(SGP_REGB_OUTPUT);
+  }  
+  
+  m_programState.nextCellNo = m_programState.activeCellNo;
 }
 
-bool sgpVMachine::isReadRegErrorLocked() const
+// execute compiled block on loaded I/O registers, returns number of cell where run stopped
+cell_size_t sgpVMachine::runNativeChain(bool &outputWritten)
 {
-  return (m_readRegErrorLock > 0);
+  outputWritten = false;
+  m_instrCount = 0;
+  return runNativeChain(0, 0, SC_NULL, outputWritten);
 }
 
-void sgpVMachine::skipCells(cell_size_t a_value)
+// execute compiled block starting from given instruction, checkpoint is added 
+// each <checkpointStep> instructions if step is not zero
+cell_size_t sgpVMachine::runNativeChain(uint instrIdx, uint checkpointStep, sgpNumericCheckpointVector *checkpoints, 
+  bool &outputWritten)
 {
-  m_programState.nextCellNo = m_programState.nextCellNo + a_value;
-  if (m_programState.nextCellNo > m_programCode.getBlockLength(m_programState.activeBlockNo))
-    handleError(GVM_ERROR_WRONG_SKIP, "Invalid skip size: "+toString(a_value));
+  const sgpNativeInstr *instrs = 
+    m_nativeProgram.instrs.empty() ? SC_NULL : &m_nativeProgram.instrs[0];
+  uint instrCount = m_nativeProgram.instrs.size();
+  uint nextCheckpointIdx = ((checkpointStep > 0) ? instrIdx + checkpointStep : UINT_MAX);
+  ulong64 cost = 0;
+  cell_size_t res = m_nativeProgram.blockLength;
+  
+  while (instrIdx < instrCount) {
+    if (instrIdx >= nextCheckpointIdx) {
+      addNumericCheckpoint(instrIdx, m_totalCost + cost, outputWritten, *checkpoints);
+      nextCheckpointIdx = instrIdx + checkpointStep;
+    }
+    
+    const sgpNativeInstr &instr = instrs[instrIdx];
+    uint funcRes = instr.func(instr);
+    
+    m_instrCount++;
+    instrIdx++;
+    
+    if (funcRes == gnfrFailed) {
+      cost += instr.failCost;
+      m_errorCount += 2;
+      // run stops on the next instruction, like in intRun
+      if ((m_errorLimit > 0) && (m_errorCount >= m_errorLimit)) {
+        if (instrIdx < instrCount)
+          res = instrs[instrIdx].cellNo;
+        break;
+      }  
+      continue;
+    }
+    
+    cost += instr.cost;
+    if (instr.writesOutput)
+      outputWritten = true;
+      
+    if ((funcRes == gnfrJump) && (instr.jumpTarget != instrIdx))
+      instrIdx = instr.jumpTarget;
+  }
+  
+  m_totalCost += cost;
+  return res;
 }
 
-void sgpVMachine::forceInstrCache()
+void sgpVMachine::addNumericCheckpoint(uint instrIdx, ulong64 cost, bool outputWritten, 
+  sgpNumericCheckpointVector &checkpoints) const
 {
-  m_instrCacheRequired = true;
+  checkpoints.push_back(sgpNumericCheckpoint());
+  sgpNumericCheckpoint &checkpoint = checkpoints.back();
+  
+  checkpoint.cellNo = m_nativeProgram.instrs[instrIdx].cellNo;
+  checkpoint.instrCount = m_instrCount;
+  checkpoint.cost = cost;
+  checkpoint.errorCount = m_errorCount;
+  checkpoint.outputWritten = outputWritten;
+  checkpoint.outputValue = m_nativeIoRegs[SGP_REGB_OUTPUT];
+  std::copy(m_programState.typedRegs.values, m_programState.typedRegs.values + SGP_TYPED_REG_COUNT, 
+    checkpoint.regs);
 }
 
 void sgpVMachine::getCounters(scDataNode &output)
@@ -3353,7 +6134,11 @@ void sgpVMachine::pushBlockState(const scDataNode &extraValue)
   guard->addChild(new scDataNode(m_programState.activeBlockNo)); 
   guard->addChild(new scDataNode(m_programState.activeCellNo)); 
   guard->addChild(new scDataNode(m_programState.nextCellNo)); 
-  guard->addChild(new scDataNode(m_programState.activeRegs)); 
+  m_programState.syncRegisters(m_registerTemplate);
+  std::auto_ptr<scDataNode> regsGuard(new scDataNode(m_programState.activeRegs));
+  if (m_typedRegsActive)
+    m_programState.typedRegs.storeTo(*regsGuard);
+  guard->addChild(regsGuard.release()); 
   guard->addChild(new scDataNode(m_programState.definedRegs)); 
 
   std::auto_ptr<scDataNode> refsGuard(new scDataNode());
@@ -3381,6 +6166,9 @@ void sgpVMachine::popBlockState(scDataNode &extraValue)
     m_programState.activeCellNo = oldState.getUInt(1);
     m_programState.nextCellNo = oldState.getUInt(2);
     m_programState.activeRegs = oldState.getElement(3);
+    m_programState.touchRegisters();
+    if (m_typedRegsActive)
+      m_programState.loadTypedRegisters();
     m_programState.definedRegs = oldState.getElement(4);
     m_programState.references.clear();
     scDataNode refs;
@@ -0,0 +1,265 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        GasmOptimizeCodeTest.cpp
+// Project:     sgpLib
+// Purpose:     Differential test of code optimization (ggfOptimizeCode).
+// Author:
+// Modified by:
+// Created:     17/10/2026
+/////////////////////////////////////////////////////////////////////////////
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file GasmOptimizeCodeTest.cpp
+///
+/// Standalone program which generates random programs built from instructions
+/// handled by the optimizer (constant folding, identity operations, double negation,
+/// self moves) and runs each of them on random inputs with ggfOptimizeCode, without it
+/// and without stripping of non-effective code (references enabled).
+/// Outputs must be identical, costs are only reported (optimized code is cheaper).
+/// Returns non-zero exit code if any output is different.
+/// Usage: GasmOptimizeCodeTest [seed]
+
+// ----------------------------------------------------------------------------
+// Headers
+// ----------------------------------------------------------------------------
+//std
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+
+//sc
+#include "sc/defs.h"
+#include "sc/utils.h"
+
+//sgp
+#include "sgp/GasmVMachine.h"
+#include "sgp/GasmFunLib.h"
+#include "sgp/GasmFunLibCore.h"
+#include "sgp/GasmAssembler.h"
+
+using namespace dtp;
+
+// ----------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------
+const uint TEST_PROGRAM_COUNT = 500;
+const uint TEST_PROGRAM_LENGTH = 24;
+const uint TEST_SAMPLE_COUNT = 20;
+const uint TEST_INSTR_LIMIT = 1000;
+const uint TEST_DEF_SEED = 1;
+
+// double accumulators & input, int accumulators
+const char *TEST_DOUBLE_REGS[] = {"#1", "#52", "#53", "#54"};
+const uint TEST_DOUBLE_REG_COUNT = 4;
+const char *TEST_DOUBLE_CONSTS[] = {"0.0D", "1.0D", "-1.0D", "2.5D", "-0.5D"};
+const uint TEST_DOUBLE_CONST_COUNT = 5;
+const char *TEST_INT_REGS[] = {"#34", "#35", "#36"};
+const uint TEST_INT_REG_COUNT = 3;
+const char *TEST_INT_CONSTS[] = {"0I", "1I", "-1I", "3I"};
+const uint TEST_INT_CONST_COUNT = 4;
+const char *TEST_ARITH_NAMES[] = {"add", "sub", "mult", "div"};
+const uint TEST_ARITH_COUNT = 4;
+
+// ----------------------------------------------------------------------------
+// Helper functions
+// ----------------------------------------------------------------------------
+uint testRandom(uint limit)
+{
+  return uint(std::rand()) % limit;
+}
+
+// register or constant, output registers (without input) are first elements
+// of register lists
+scString testRandomArg(bool intType)
+{
+  if (intType) {
+    if (testRandom(2) == 0)
+      return TEST_INT_CONSTS[testRandom(TEST_INT_CONST_COUNT)];
+    return TEST_INT_REGS[testRandom(TEST_INT_REG_COUNT)];
+  } else {
+    if (testRandom(2) == 0)
+      return TEST_DOUBLE_CONSTS[testRandom(TEST_DOUBLE_CONST_COUNT)];
+    return TEST_DOUBLE_REGS[testRandom(TEST_DOUBLE_REG_COUNT)];
+  }
+}
+
+scString testRandomOutReg(bool intType)
+{
+  if (intType)
+    return TEST_INT_REGS[testRandom(TEST_INT_REG_COUNT)];
+  return TEST_DOUBLE_REGS[1 + testRandom(TEST_DOUBLE_REG_COUNT - 1)];
+}
+
+void testGenerateProgram(scStringList &lines)
+{
+  bool intType;
+  scString outReg, typeName;
+
+  lines.clear();
+  lines.push_back(".block");
+  lines.push_back(".input double");
+  lines.push_back(".output double");
+  lines.push_back("move #52, #1");
+  lines.push_back("move #53, 0.0D");
+  lines.push_back("move #54, 1.0D");
+  lines.push_back("move #34, 2I");
+  lines.push_back("move #35, 0I");
+  lines.push_back("move #36, 1I");
+
+  for(uint i = 0; i != TEST_PROGRAM_LENGTH; i++) {
+    intType = (testRandom(3) == 0);
+    typeName = intType ? "int" : "double";
+    outReg = testRandomOutReg(intType);
+
+    switch (testRandom(5)) {
+      case 0: // double negation
+        lines.push_back("neg." + typeName + " " + outReg + ", " + testRandomArg(intType));
+        lines.push_back("neg." + typeName + " " + testRandomOutReg(intType) + ", " + outReg);
+        break;
+      case 1: // move, including move to itself
+        if (testRandom(2) == 0)
+          lines.push_back("move " + outReg + ", " + outReg);
+        else
+          lines.push_back("move " + outReg + ", " + testRandomArg(intType));
+        break;
+      default: // arithmetic with constant or register args
+        lines.push_back(scString(TEST_ARITH_NAMES[testRandom(TEST_ARITH_COUNT)]) + "." + typeName + " " + outReg + ", "
+          + testRandomArg(intType) + ", " + testRandomArg(intType));
+        break;
+    }
+  }
+
+  // output is written first, so all accumulators are used
+  lines.push_back("cast #0, #34, double");
+  lines.push_back("add.double #0, #0, #52");
+  lines.push_back("add.double #0, #0, #53");
+  lines.push_back("add.double #0, #0, #54");
+  lines.push_back(".end");
+}
+
+// code is stripped only if references are not supported
+void testInitVMachine(sgpVMachine &vmachine, const sgpFunctionMapColn &functions, bool stripCode, bool optimize)
+{
+  vmachine.setFunctionList(functions);
+  if ((vmachine.getSupportedArgTypes() & gatfRef) == 0)
+    vmachine.setSupportedArgTypes(vmachine.getSupportedArgTypes() | gatfRef);
+  if (stripCode)
+    vmachine.setSupportedArgTypes(vmachine.getSupportedArgTypes() ^ gatfRef);
+  if ((vmachine.getFeatures() & ggfLogErrors) != 0)
+    vmachine.setFeatures(vmachine.getFeatures() ^ ggfLogErrors);
+  // the same engines as in fitness function
+  vmachine.setFeatures(vmachine.getFeatures() | ggfTypedRegsEnabled | ggfThreadedRun | ggfNativeRun);
+  if (optimize)
+    vmachine.setFeatures(vmachine.getFeatures() | ggfOptimizeCode);
+}
+
+void testRun(sgpVMachine &vmachine, double inputValue, scDataNode &output, ulong64 &cost)
+{
+  scDataNode input;
+
+  input.addChild(new scDataNode(inputValue));
+  vmachine.resetWarmWay();
+  vmachine.setInput(input);
+  vmachine.run(TEST_INSTR_LIMIT);
+  output = vmachine.getOutput();
+  cost = vmachine.getTotalCost();
+}
+
+bool testSameOutput(const scDataNode &expected, const scDataNode &actual)
+{
+  if (expected.isNull() || actual.isNull())
+    return (expected.isNull() == actual.isNull());
+  if (expected.getValueType() != actual.getValueType())
+    return false;
+
+  double expValue = expected.getAsDouble();
+  double actValue = actual.getAsDouble();
+
+  return (expValue == actValue) || (isnan(expValue) && isnan(actValue));
+}
+
+void testListProgram(const scStringList &lines)
+{
+  for(uint i = 0, epos = lines.size(); i != epos; i++)
+    std::cout << "  " << lines[i] << std::endl;
+}
+
+// returns <false> if outputs of any sample are different
+bool testProgram(uint prgNo, const sgpFunctionMapColn &functions, ulong64 &baseCost, ulong64 &optCost)
+{
+  scStringList lines;
+  scDataNode code, fullOutput, baseOutput, optOutput;
+  sgpAssembler assembler;
+  sgpVMachine fullMachine, baseMachine, optMachine;
+  ulong64 cost;
+  double inputValue;
+
+  testGenerateProgram(lines);
+  assembler.setFunctionList(functions);
+  if (!assembler.parseText(lines, code))
+    throw scError("Test program cannot be assembled: " + toString(prgNo));
+
+  testInitVMachine(fullMachine, functions, false, false);
+  testInitVMachine(baseMachine, functions, true, false);
+  testInitVMachine(optMachine, functions, true, true);
+  fullMachine.setCompiledProgram(fullMachine.compileProgram(code));
+  baseMachine.setCompiledProgram(baseMachine.compileProgram(code));
+  optMachine.setCompiledProgram(optMachine.compileProgram(code));
+
+  for(uint i = 0; i != TEST_SAMPLE_COUNT; i++) {
+    inputValue = 20.0 * double(std::rand()) / double(RAND_MAX) - 10.0;
+
+    testRun(fullMachine, inputValue, fullOutput, cost);
+    testRun(baseMachine, inputValue, baseOutput, cost);
+    baseCost += cost;
+    testRun(optMachine, inputValue, optOutput, cost);
+    optCost += cost;
+
+    if (!testSameOutput(fullOutput, baseOutput) || !testSameOutput(fullOutput, optOutput)) {
+      std::cout << "Program " << prgNo << ", input " << inputValue << ": output "
+        << fullOutput.getAsString() << " changed to " << baseOutput.getAsString() 
+        << " (stripped), " << optOutput.getAsString() << " (optimized)" << std::endl;
+      testListProgram(lines);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Main
+// ----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  uint failCount = 0;
+  ulong64 baseCost = 0, optCost = 0;
+  sgpFunLib mainLib;
+  sgpFunctionMapColn functions;
+  uint seed = (argc > 1) ? stringToUInt(argv[1]) : TEST_DEF_SEED;
+
+  std::srand(seed);
+
+  try {
+    mainLib.addLib(new sgpFunLibCore());
+    sgpFunLib::prepareFuncList(scStringList(), scStringList(), functions);
+
+    for(uint i = 0; i != TEST_PROGRAM_COUNT; i++)
+      if (!testProgram(i, functions, baseCost, optCost))
+        failCount++;
+  }
+  catch(scError &excp) {
+    std::cout << "Exception (scError): " << excp.what() << ", details: " << excp.getDetails() << std::endl;
+    return 2;
+  }
+  catch(const std::exception& e) {
+    std::cout << "Exception (std): " << e.what() << std::endl;
+    return 2;
+  }
+
+  std::cout << "Seed: " << seed << ", programs: " << TEST_PROGRAM_COUNT << ", failed: " << failCount
+    << ", cost: " << baseCost << " -> " << optCost << std::endl;
+
+  return (failCount > 0) ? 1 : 0;
+}
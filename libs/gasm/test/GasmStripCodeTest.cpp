@@ -0,0 +1,287 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        GasmStripCodeTest.cpp
+// Project:     sgpLib
+// Purpose:     Differential test of non-effective code stripping.
+// Author:
+// Modified by:
+// Created:     17/10/2026
+/////////////////////////////////////////////////////////////////////////////
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file GasmStripCodeTest.cpp
+///
+/// Standalone program which runs programs containing instructions which can fail
+/// (division by zero) on vmachine with and without stripping of non-effective code.
+/// Failed instruction leaves it's output unchanged, so value written before
+/// it must be kept. Code is stripped only if references are not supported,
+/// so vmachine with references enabled is used as a base.
+/// Returns non-zero exit code if any output is different.
+/// Usage: GasmStripCodeTest [seed]
+
+// ----------------------------------------------------------------------------
+// Headers
+// ----------------------------------------------------------------------------
+//std
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+
+//sc
+#include "sc/defs.h"
+#include "sc/utils.h"
+
+//sgp
+#include "sgp/GasmVMachine.h"
+#include "sgp/GasmFunLib.h"
+#include "sgp/GasmFunLibCore.h"
+#include "sgp/GasmAssembler.h"
+
+using namespace dtp;
+
+// ----------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------
+const uint TEST_PROGRAM_COUNT = 500;
+const uint TEST_PROGRAM_LENGTH = 16;
+const uint TEST_SAMPLE_COUNT = 20;
+const uint TEST_INSTR_LIMIT = 1000;
+const uint TEST_DEF_SEED = 1;
+
+// value written before failing division is used as output
+const char *TEST_PRG_FAILED_DIV[] = {
+  ".block",
+  ".input double",
+  ".output double",
+  "move #52, #1",
+  "move #53, 0.0D",
+  "div.double #52, #1, #53",
+  "add.double #0, #52, 1.0D",
+  ".end",
+  SC_NULL
+};
+
+const char *TEST_PRG_FAILED_DIV_INT[] = {
+  ".block",
+  ".input double",
+  ".output double",
+  "move #34, 7I",
+  "move #35, 0I",
+  "div.int #34, #34, #35",
+  "cast #0, #34, double",
+  ".end",
+  SC_NULL
+};
+
+// input is the first register, zero constants make divisions fail
+const char *TEST_DOUBLE_REGS[] = {"#1", "#52", "#53", "#54"};
+const uint TEST_DOUBLE_REG_COUNT = 4;
+const char *TEST_DOUBLE_CONSTS[] = {"0.0D", "1.0D", "-2.0D"};
+const uint TEST_DOUBLE_CONST_COUNT = 3;
+const char *TEST_INT_REGS[] = {"#34", "#35", "#36"};
+const uint TEST_INT_REG_COUNT = 3;
+const char *TEST_INT_CONSTS[] = {"0I", "1I", "3I"};
+const uint TEST_INT_CONST_COUNT = 3;
+
+// ----------------------------------------------------------------------------
+// Helper functions
+// ----------------------------------------------------------------------------
+uint testRandom(uint limit)
+{
+  return uint(std::rand()) % limit;
+}
+
+scString testRandomArg(bool intType)
+{
+  if (intType) {
+    if (testRandom(2) == 0)
+      return TEST_INT_CONSTS[testRandom(TEST_INT_CONST_COUNT)];
+    return TEST_INT_REGS[testRandom(TEST_INT_REG_COUNT)];
+  } else {
+    if (testRandom(2) == 0)
+      return TEST_DOUBLE_CONSTS[testRandom(TEST_DOUBLE_CONST_COUNT)];
+    return TEST_DOUBLE_REGS[testRandom(TEST_DOUBLE_REG_COUNT)];
+  }
+}
+
+scString testRandomOutReg(bool intType)
+{
+  if (intType)
+    return TEST_INT_REGS[testRandom(TEST_INT_REG_COUNT)];
+  return TEST_DOUBLE_REGS[1 + testRandom(TEST_DOUBLE_REG_COUNT - 1)];
+}
+
+// each division is preceded by write to it's output, so stripping of this
+// write is visible in output if division fails
+void testGenerateProgram(scStringList &lines)
+{
+  bool intType;
+  scString outReg, typeName;
+
+  lines.clear();
+  lines.push_back(".block");
+  lines.push_back(".input double");
+  lines.push_back(".output double");
+  lines.push_back("move #52, #1");
+  lines.push_back("move #53, 0.0D");
+  lines.push_back("move #54, 1.0D");
+  lines.push_back("move #34, 2I");
+  lines.push_back("move #35, 0I");
+  lines.push_back("move #36, 1I");
+
+  for(uint i = 0; i != TEST_PROGRAM_LENGTH; i++) {
+    intType = (testRandom(3) == 0);
+    typeName = intType ? "int" : "double";
+    outReg = testRandomOutReg(intType);
+
+    switch (testRandom(3)) {
+      case 0:
+        lines.push_back("move " + outReg + ", " + testRandomArg(intType));
+        lines.push_back("div." + typeName + " " + outReg + ", " + testRandomArg(intType) + ", " + testRandomArg(intType));
+        break;
+      case 1:
+        lines.push_back("sub." + typeName + " " + outReg + ", " + testRandomArg(intType) + ", " + testRandomArg(intType));
+        break;
+      default:
+        lines.push_back("div." + typeName + " " + outReg + ", " + testRandomArg(intType) + ", " + testRandomArg(intType));
+        break;
+    }
+  }
+
+  // output is written first, so all accumulators are used
+  lines.push_back("cast #0, #34, double");
+  lines.push_back("add.double #0, #0, #52");
+  lines.push_back("add.double #0, #0, #53");
+  lines.push_back("add.double #0, #0, #54");
+  lines.push_back(".end");
+}
+
+void testLoadLines(const char *lines[], scStringList &output)
+{
+  output.clear();
+  for(uint i = 0; lines[i] != SC_NULL; i++)
+    output.push_back(lines[i]);
+}
+
+// code is stripped only if references are not supported
+void testInitVMachine(sgpVMachine &vmachine, const sgpFunctionMapColn &functions, bool stripCode)
+{
+  vmachine.setFunctionList(functions);
+  if ((vmachine.getSupportedArgTypes() & gatfRef) == 0)
+    vmachine.setSupportedArgTypes(vmachine.getSupportedArgTypes() | gatfRef);
+  if (stripCode)
+    vmachine.setSupportedArgTypes(vmachine.getSupportedArgTypes() ^ gatfRef);
+  if ((vmachine.getFeatures() & ggfLogErrors) != 0)
+    vmachine.setFeatures(vmachine.getFeatures() ^ ggfLogErrors);
+}
+
+void testRun(sgpVMachine &vmachine, double inputValue, scDataNode &output)
+{
+  scDataNode input;
+
+  input.addChild(new scDataNode(inputValue));
+  vmachine.resetWarmWay();
+  vmachine.setInput(input);
+  vmachine.run(TEST_INSTR_LIMIT);
+  output = vmachine.getOutput();
+}
+
+bool testSameOutput(const scDataNode &expected, const scDataNode &actual)
+{
+  if (expected.isNull() || actual.isNull())
+    return (expected.isNull() == actual.isNull());
+  if (expected.getValueType() != actual.getValueType())
+    return false;
+
+  double expValue = expected.getAsDouble();
+  double actValue = actual.getAsDouble();
+
+  return (expValue == actValue) || (isnan(expValue) && isnan(actValue));
+}
+
+void testListProgram(const scStringList &lines)
+{
+  for(uint i = 0, epos = lines.size(); i != epos; i++)
+    std::cout << "  " << lines[i] << std::endl;
+}
+
+// returns <false> if outputs of any sample are different
+bool testProgram(const scString &prgName, const scStringList &lines, const sgpFunctionMapColn &functions)
+{
+  scDataNode code, baseOutput, stripOutput;
+  sgpAssembler assembler;
+  sgpVMachine baseMachine, stripMachine;
+  double inputValue;
+
+  assembler.setFunctionList(functions);
+  if (!assembler.parseText(lines, code))
+    throw scError("Test program cannot be assembled: " + prgName);
+
+  testInitVMachine(baseMachine, functions, false);
+  testInitVMachine(stripMachine, functions, true);
+  baseMachine.setCompiledProgram(baseMachine.compileProgram(code));
+  stripMachine.setCompiledProgram(stripMachine.compileProgram(code));
+
+  for(uint i = 0; i != TEST_SAMPLE_COUNT; i++) {
+    // zero input makes divisions by input fail
+    inputValue = (i == 0) ? 0.0 : (20.0 * double(std::rand()) / double(RAND_MAX) - 10.0);
+
+    testRun(baseMachine, inputValue, baseOutput);
+    testRun(stripMachine, inputValue, stripOutput);
+
+    if (!testSameOutput(baseOutput, stripOutput)) {
+      std::cout << "Program " << prgName << ", input " << inputValue << ": output "
+        << baseOutput.getAsString() << " changed to " << stripOutput.getAsString() << std::endl;
+      testListProgram(lines);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Main
+// ----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  uint failCount = 0;
+  sgpFunLib mainLib;
+  sgpFunctionMapColn functions;
+  scStringList lines;
+  uint seed = (argc > 1) ? stringToUInt(argv[1]) : TEST_DEF_SEED;
+
+  std::srand(seed);
+
+  try {
+    mainLib.addLib(new sgpFunLibCore());
+    sgpFunLib::prepareFuncList(scStringList(), scStringList(), functions);
+
+    testLoadLines(TEST_PRG_FAILED_DIV, lines);
+    if (!testProgram("failed-div", lines, functions))
+      failCount++;
+
+    testLoadLines(TEST_PRG_FAILED_DIV_INT, lines);
+    if (!testProgram("failed-div-int", lines, functions))
+      failCount++;
+
+    for(uint i = 0; i != TEST_PROGRAM_COUNT; i++) {
+      testGenerateProgram(lines);
+      if (!testProgram(toString(i), lines, functions))
+        failCount++;
+    }
+  }
+  catch(scError &excp) {
+    std::cout << "Exception (scError): " << excp.what() << ", details: " << excp.getDetails() << std::endl;
+    return 2;
+  }
+  catch(const std::exception& e) {
+    std::cout << "Exception (std): " << e.what() << std::endl;
+    return 2;
+  }
+
+  std::cout << "Seed: " << seed << ", programs: " << TEST_PROGRAM_COUNT + 2 << ", failed: " << failCount << std::endl;
+
+  return (failCount > 0) ? 1 : 0;
+}
@@ -48,11 +48,14 @@ const uint SGP_GASM_INFO_VAR_LEN = 32;
 // ----------------------------------------------------------------------------
 class sgpEntityForGasm: public sgpEntityBase {
 public:
-  sgpEntityForGasm() {}
+  sgpEntityForGasm(): m_evalCost(0), m_evalCodeSize(0), m_evalCodeHash(0) {}
   
   sgpEntityForGasm(const sgpEntityForGasm &src) {
     m_programGenome = src.m_programGenome;
     m_programMeta = src.m_programMeta;
+    m_evalCost = src.m_evalCost;
+    m_evalCodeSize = src.m_evalCodeSize;
+    m_evalCodeHash = src.m_evalCodeHash;
     src.getFitness(m_fitness);
   }
 
@@ -70,6 +73,10 @@ public:
             src
         )).m_programMeta;
         
+      const sgpEntityForGasm &gasmSrc = dynamic_cast<const sgpEntityForGasm &>(src);
+      m_evalCost = gasmSrc.m_evalCost;
+      m_evalCodeSize = gasmSrc.m_evalCodeSize;
+      m_evalCodeHash = gasmSrc.m_evalCodeHash;
       src.getFitness(m_fitness);
     } 
     return *this;
@@ -116,6 +123,13 @@ public:
   void setInfoMap(sgpInfoBlockVarMap *value) {m_infoMap = value;}
   int getInfoValuePosInGenome(uint infoId) const;  
   void castValueAsUInt(const scDataNodeValue &ref, uint &output) const;
+
+  //--- evaluation statistics (not evolved, inherited by offspring)
+  ulong64 getEvalCost() const { return m_evalCost; }
+  ulong64 getEvalCodeSize() const { return m_evalCodeSize; }
+  void setEvalStats(ulong64 cost, ulong64 codeSize) { m_evalCost = cost; m_evalCodeSize = codeSize; }
+  ulong64 getEvalCodeHash() const { return m_evalCodeHash; }
+  void setEvalCodeHash(ulong64 value) { m_evalCodeHash = value; }
 protected:  
   bool getInfoValueIndex(uint infoId, uint &vindex) const;
   uint getInfoBlockSize() const;
@@ -123,6 +137,9 @@ protected:
   sgpGasmGenomeList m_programGenome; // evolved part - code
   scDataNode m_programMeta; // meta information - not evolved
   sgpInfoBlockVarMap *m_infoMap;
+  ulong64 m_evalCost;     // vmachine cost of last evaluation, 0 if not evaluated 
+  ulong64 m_evalCodeSize; // size of program on last evaluation
+  ulong64 m_evalCodeHash; // hash of prepared code on last evaluation, 0 if not evaluated
 };
 
 
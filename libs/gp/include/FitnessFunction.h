@@ -21,6 +21,10 @@
 // ----------------------------------------------------------------------------
 // Headers
 // ----------------------------------------------------------------------------
+#include <map>
+
+#include "boost/thread/mutex.hpp"
+
 #include "sgp\FitnessValue.h"
 #include "sgp\FitnessDefs.h"
 #include "sgp\EntityBase.h"
@@ -36,6 +40,9 @@ enum sgpGpStopStatus {
 typedef std::vector<bool> sgpObjectiveSet; 
 typedef std::vector<int> sgpObjectiveSigns; 
 
+// default maximum number of entries in fitness cache
+const uint SGP_FIT_CACHE_DEF_LIMIT = 20000;
+
 class sgpFitnessFunction {
 public:
   // construct
@@ -68,4 +75,108 @@ private:
    uint m_stopStatus;
 };
 
+/// Optional interface of fitness function - predicts relative cost of entity evaluation,
+/// used to schedule most expensive entities first
+class sgpEvalCostPredictorIntf {
+public:
+  virtual ~sgpEvalCostPredictorIntf() {}
+  virtual ulong64 predictEvalCost(const sgpEntityBase &entity) const = 0;
+};
+
+/// Optional interface of fitness function - entities can be evaluated in parallel 
+/// threads. Fitness functions without it are always evaluated sequentially.
+class sgpEvalParallelIntf {
+public:
+  virtual ~sgpEvalParallelIntf() {}
+  /// returns <true> if calc is thread-safe & result does not depend on evaluation order
+  virtual bool isParallelEvalSupported() const = 0;
+};
+
+/// Optional interface of fitness function - evaluation is stopped early (racing) 
+/// for entities which are proven to be worse than the worst survivor. 
+/// Evaluation operator publishes limit before each evaluation, using fitness 
+/// carried by survivors of selection and their offspring.
+class sgpEvalRacingIntf {
+public:
+  virtual ~sgpEvalRacingIntf() {}
+  /// <value> - minimum value of each objective among survivors
+  virtual void setSurvivalLimit(const sgpFitnessValue &value) = 0;
+};
+
+/// key of fitness cache: 128-bit hash of all genomes (code & info block) 
+/// together with version of fitness input data (samples)
+struct sgpFitnessCacheKey {
+  ulong64 hash1;
+  ulong64 hash2;
+  uint dataVersion;
+  
+  bool operator<(const sgpFitnessCacheKey &rhs) const {
+    if (hash1 != rhs.hash1)
+      return hash1 < rhs.hash1;
+    if (hash2 != rhs.hash2)
+      return hash2 < rhs.hash2;
+    return dataVersion < rhs.dataVersion;  
+  }
+};
+
+void initFitnessCacheKey(uint dataVersion, sgpFitnessCacheKey &output);
+void addToFitnessCacheKey(ulong64 value, sgpFitnessCacheKey &output);
+void addToFitnessCacheKey(const scDataNode &value, sgpFitnessCacheKey &output);
+/// calculate key using all genomes of entity
+void calcFitnessCacheKey(const sgpEntityBase &entity, uint dataVersion, sgpFitnessCacheKey &output);
+
+/// Cache of evaluation results for deterministic fitness functions, so unchanged 
+/// entities (elites, survivors) are not evaluated again.
+/// Can be used by concurrent evaluation threads.
+template<class ValueType>
+class sgpEvalResultCache {
+public:
+  // construct
+  sgpEvalResultCache(): m_limit(SGP_FIT_CACHE_DEF_LIMIT), m_dataVersion(0), m_hitCount(0), m_missCount(0) {}
+  virtual ~sgpEvalResultCache() {}
+  // properties
+  void setLimit(uint value) { m_limit = value; }
+  ulong64 getHitCount() const { 
+    boost::mutex::scoped_lock lock(m_mutex);
+    return m_hitCount; 
+  }
+  ulong64 getMissCount() const { 
+    boost::mutex::scoped_lock lock(m_mutex);
+    return m_missCount; 
+  }
+  // run
+  bool find(const sgpFitnessCacheKey &key, ValueType &output) {
+    boost::mutex::scoped_lock lock(m_mutex);
+    typename std::map<sgpFitnessCacheKey, ValueType>::const_iterator it = m_items.find(key);
+    if (it == m_items.end()) {
+      m_missCount++;
+      return false;
+    }
+    m_hitCount++;
+    output = it->second;
+    return true;
+  }
+  void insert(const sgpFitnessCacheKey &key, const ValueType &value) {
+    boost::mutex::scoped_lock lock(m_mutex);
+    if ((key.dataVersion != m_dataVersion) || (m_items.size() >= m_limit)) {
+      m_items.clear();
+      m_dataVersion = key.dataVersion;
+    }  
+    m_items[key] = value;
+  }
+  void clear() {
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_items.clear();
+  }
+protected:
+  mutable boost::mutex m_mutex;
+  std::map<sgpFitnessCacheKey, ValueType> m_items;
+  uint m_limit;
+  uint m_dataVersion; ///<-- entries for older versions are removed on insert
+  ulong64 m_hitCount;
+  ulong64 m_missCount;
+};
+
+typedef sgpEvalResultCache<sgpFitnessValue> sgpFitnessCache;
+
 #endif // _SGPFITFUNC_H__
@@ -17,11 +17,33 @@
 /// \file GasmOperatorEvaluateIslands.h
 ///
 /// File description
+///
+/// Entities can be evaluated by pool of worker threads (see setWorkerCount),
+/// by default one worker is started for each hardware thread.
+/// Each worker runs programs using it's own vmachine context, results are 
+/// written back to generation by calling thread in entity order.
+/// Entities are ordered by cost predicted by fitness function (if it supports
+/// sgpEvalCostPredictorIntf) and dealt to worker queues, idle workers steal 
+/// entities from queues of other workers.
 
 // ----------------------------------------------------------------------------
 // Headers
 // ----------------------------------------------------------------------------
+// stl
+#include <vector>
+#include <deque>
+
+// boost
+#include "boost/ptr_container/ptr_vector.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/condition_variable.hpp"
+
+// sc
+#include "sc/events/Events.h"
+
 #include "sgp/GaOperatorBasic.h"
+#include "sgp/FitnessFunction.h"
 
 // ----------------------------------------------------------------------------
 // Simple type definitions
@@ -34,10 +56,71 @@
 // ----------------------------------------------------------------------------
 // Constants
 // ----------------------------------------------------------------------------
+const uint SGP_EVAL_AUTO_WORKER_COUNT = 0; ///<-- number of hardware threads
+// used only if fitness function supports parallel evaluation (sgpEvalParallelIntf)
+const uint SGP_EVAL_DEF_WORKER_COUNT = SGP_EVAL_AUTO_WORKER_COUNT;
 
 // ----------------------------------------------------------------------------
 // Class definitions
 // ----------------------------------------------------------------------------
+/// status of entity in parallel evaluation
+enum sgpEvalItemState {
+  geisPending = 0,
+  geisOk = 1,
+  geisStop = 2,  ///<-- fitness function returned <false> 
+  geisError = 3  ///<-- exception was raised in fitness function
+};
+
+/// Entity queue of a single worker. Owner takes entities from front (most 
+/// expensive first), other workers steal from back.
+class sgpGasmEvalTaskQueue {
+public:
+  void clear();
+  void push(uint itemIndex);
+  bool popFront(uint &itemIndex);
+  bool popBack(uint &itemIndex);
+protected:
+  boost::mutex m_mutex;
+  std::deque<uint> m_items;
+};
+
+/// Pool of threads evaluating entities of generation with work stealing.
+/// Threads are kept between batches, so vmachine contexts of fitness 
+/// function are reused.
+class sgpGasmEvalWorkerPool {
+public:
+  // create
+  sgpGasmEvalWorkerPool(); 
+  virtual ~sgpGasmEvalWorkerPool();
+  // properties
+  uint getWorkerCount() const;
+  // run
+  void start(uint workerCount);
+  void stop();
+  void beginBatch(const sgpGaGeneration &generation, const sgpFitnessFunction &fitnessFunc);
+  uint waitForItem(uint itemIndex, sgpFitnessValue &fitness);
+  void endBatch(scString &errorMsg);
+protected:
+  void runWorker(uint workerNo);
+  void dispatchItems(const sgpGaGeneration &generation, const sgpFitnessFunction &fitnessFunc);
+  bool fetchItem(uint workerNo, uint &itemIndex);
+  void evaluateItem(uint itemIndex);
+protected:
+  boost::ptr_vector<boost::thread> m_threads;
+  boost::ptr_vector<sgpGasmEvalTaskQueue> m_queues;
+  uint m_workerCount;
+  boost::mutex m_mutex;
+  boost::condition_variable m_workReady;
+  boost::condition_variable m_itemDone;
+  bool m_stopped;
+  uint m_batchNo;
+  const sgpGaGeneration *m_generation;
+  const sgpFitnessFunction *m_fitnessFunc;
+  std::vector<sgpFitnessValue> m_results;
+  std::vector<uint> m_states;
+  scString m_errorMsg; ///<-- first error of batch
+};
+
 class sgpGasmOperatorEvaluateIslands: public sgpGaOperatorEvaluateBasic {
 public:
   // create
@@ -45,13 +128,23 @@ public:
   virtual ~sgpGasmOperatorEvaluateIslands();
   // properties
   void setIslandLimit(uint value);
+  void setWorkerCount(uint value);
+  uint getWorkerCount() const;
+  void setYieldSignal(scSignal *value);
   // run
   virtual bool execute(uint stepNo, bool isNewGen, sgpGaGeneration &generation);
 protected:
   virtual bool processIsland(uint stepNo, uint islandNo, bool isNewGen, sgpGaGeneration &generation);
   virtual bool processBuffer(sgpGaGeneration &generation);    
+  void publishSurvivalLimit(const sgpGaGeneration &generation);
+  bool isParallelEvalEnabled() const;
+  bool evaluateAllParallel(sgpGaGeneration &generation);
+  virtual void signalNextEntity();
 protected:
   uint m_islandLimit;  
+  uint m_workerCount;
+  scSignal *m_yieldSignal;
+  std::auto_ptr<sgpGasmEvalWorkerPool> m_workerPool;
 };
 
 #endif // _COREMODULE_H__
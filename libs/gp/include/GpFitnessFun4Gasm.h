@@ -22,6 +22,10 @@
 // ----------------------------------------------------------------------------
 // Headers
 // ----------------------------------------------------------------------------
+// boost
+#include "boost/thread/tss.hpp"
+#include "boost/thread/mutex.hpp"
+
 #include "sgp/GaEvolver.h"
 #include "sgp/GasmVMachine.h"
 #include "sgp/GasmFunLib.h"
@@ -40,20 +44,71 @@
 const scString TIMER_RUNPRG = "gp-run-prg";
 const scString TIMER_RUNPRG_CORE = "gp-run-prg-core";
 const scString TIMER_PREPARE_CODE = "gp-prep-code";
+const scString COUNTER_RUNPRG_INSTR = "gp-run-prg-instr";
+// instructions before & after code preparation - together give effective code ratio
+const scString COUNTER_PREPARE_CODE_INSTR = "gp-prep-code-instr";
+const scString COUNTER_PREPARE_CODE_EFF_INSTR = "gp-prep-code-eff-instr";
+// numeric runs resumed from checkpoint of other program
+const scString COUNTER_RUNPRG_RESUMED = "gp-run-prg-resumed";
+
+// number of checkpoints stored for each sample
+const uint SGP_EVAL_CHECKPOINT_COUNT = 4;
 
 // ----------------------------------------------------------------------------
 // Class definitions
 // ----------------------------------------------------------------------------
 
-/// Class which keeps context of execution of Gasm program
-/// This includes:
-/// - function list
-/// - library list
-/// - vmachine
-/// - feature list
-/// - allowed data types
-//class sgpFitGasmContext {
-//};
+/// Checkpoints of numeric runs of compiled program for each sample. Not modified 
+/// after run, so it can be used by other threads to resume runs of programs 
+/// with the same code prefix.
+class sgpNumericRunCheckpoints {
+public:
+  sgpNumericRunCheckpoints(const sgpCompiledProgramTransporter &program, uint sampleCount): 
+    m_program(program), m_samples(sampleCount) {}
+  const sgpCompiledProgram &getProgram() const { return *m_program; }
+  uint getSampleCount() const { return m_samples.size(); }
+  const sgpNumericCheckpointVector &getSample(uint sampleNo) const { return m_samples[sampleNo]; }
+  sgpNumericCheckpointVector &getSample(uint sampleNo) { return m_samples[sampleNo]; }
+protected:
+  sgpCompiledProgramTransporter m_program;
+  std::vector<sgpNumericCheckpointVector> m_samples;
+};
+
+typedef boost::shared_ptr<sgpNumericRunCheckpoints> sgpNumericRunCheckpointsGuard;
+typedef boost::shared_ptr<const sgpNumericRunCheckpoints> sgpNumericRunCheckpointsTransporter;
+
+/// Class which keeps context of execution of Gasm program for a single 
+/// evaluation thread. Vmachine is initialized with function list, feature list 
+/// & allowed data types of fitness function, compiled programs are shared.
+class sgpFitGasmContext {
+public:
+  sgpFitGasmContext(uint epoch): m_epoch(epoch), m_commonCodeLength(0) {}
+  sgpVMachine &getVMachine() { return m_vmachine; }
+  uint getEpoch() const { return m_epoch; }
+  // checkpoint run
+  sgpNumericRunCheckpoints *getRecorded() { return m_recorded.get(); }
+  const sgpNumericRunCheckpoints *getSource() const { return m_source.get(); }
+  cell_size_t getCommonCodeLength() const { return m_commonCodeLength; }
+  void beginCheckpointRun(const sgpNumericRunCheckpointsGuard &recorded, 
+    const sgpNumericRunCheckpointsTransporter &source, cell_size_t commonCodeLength) 
+  {
+    m_recorded = recorded;
+    m_source = source;
+    m_commonCodeLength = commonCodeLength;
+  }
+  sgpNumericRunCheckpointsTransporter endCheckpointRun() {
+    sgpNumericRunCheckpointsTransporter res(m_recorded);
+    m_recorded.reset();
+    m_source.reset();
+    return res;
+  }
+protected:
+  sgpVMachine m_vmachine;
+  uint m_epoch; ///<-- value of fitness function epoch on init
+  sgpNumericRunCheckpointsGuard m_recorded;       ///<-- checkpoints of active program
+  sgpNumericRunCheckpointsTransporter m_source;   ///<-- checkpoints of program with similar code
+  cell_size_t m_commonCodeLength;                 ///<-- length of code common for both programs
+};
 
 class sgpFitnessFun4Gasm: public sgpFitnessFunction {
   typedef sgpFitnessFunction inherited;
@@ -68,6 +123,8 @@ public:
   virtual uint getProgramStepLimit() const;
   sgpFunctionMapColn &getFunctions();
   void setSupportedDataTypes(uint mask);
+  void setOptimizeCodeEnabled(bool value);
+  bool isOptimizeCodeEnabled() const;
   virtual uint getExpectedInstrCount() = 0;
   virtual uint getExpectedSize() = 0;
 
@@ -79,16 +136,31 @@ protected:
   virtual void initLibs(sgpFunLib &mainLib) = 0;
   virtual void getFunctionList(scStringList &output) = 0;
   void initFunctionList();
+  sgpFitGasmContext &getContext() const;
+  sgpVMachine &getVMachine() const;
+  sgpCompiledProgramTransporter compileProgram(const sgpVMachine &vmachine, const scDataNode &code) const;
   void setVMachineProgram(sgpVMachine &vmachine, const scDataNode &code) const;
   void prepareFunctions();
   void runProgram(const scDataNode &input, scDataNode &output, uint startBlockNo) const;
+  void runProgramNumeric(const double *inputs, uint inputCount, scDataNode &output, uint startBlockNo) const;
+  void runProgramNumeric(uint sampleNo, const double *inputs, uint inputCount, scDataNode &output, 
+    uint startBlockNo) const;
+  void beginCheckpointRun(const sgpCompiledProgramTransporter &program, uint blockNo, uint sampleCount, 
+    const sgpNumericRunCheckpointsTransporter &source) const;
+  sgpNumericRunCheckpointsTransporter endCheckpointRun() const;
+  bool isCheckpointRunActive() const;
+  bool runProgramBatch(const sgpBatchInputVector &inputs, uint inputCount, 
+    scDataNode &outputs, sgpBatchCostVector &costs, uint startBlockNo) const;
   virtual void intPrepare();
 protected:
   bool m_prepared;
   uint m_supportedDataTypes;
+  bool m_optimizeCodeEnabled; ///<-- ggfOptimizeCode, off by default
   sgpFunctionMapColn m_functions;
   std::auto_ptr<sgpFunLib> m_mainLib;
-  std::auto_ptr<sgpVMachine> m_vmachine;
+  uint m_contextEpoch; ///<-- changed with function list or data types, contexts with different epoch are initialized again
+  mutable boost::thread_specific_ptr<sgpFitGasmContext> m_contexts;
+  mutable boost::mutex m_contextMutex;
 };
 
 #endif // _SGPGPFITFUNGASM_H__
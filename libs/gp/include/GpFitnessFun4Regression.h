@@ -23,6 +23,8 @@
 //std
 #include <list>
 #include <queue>
+#include <vector>
+#include <memory>
 
 //base
 #include "base/algorithm.h"
@@ -42,6 +44,7 @@
 // ----------------------------------------------------------------------------
 typedef sgpFitnessValue sgpFitDoubleVector;
 typedef boost::shared_ptr<sgpFitDoubleVector> sgpFitDoubleVectorGuard;
+typedef std::vector<uint> sgpSampleRowList;
 
 const uint SGP_OBJ_IDX_SSE           = 1;
 const uint SGP_OBJ_IDX_ERROR_STDDEV  = 2;
@@ -93,13 +96,37 @@ const uint FUN_REGR_OBJ_IDX_ERROR_MAX                      = FUN_REGR_OBJ_IDX_ER
 // ----------------------------------------------------------------------------
 // Forward class definitions
 // ----------------------------------------------------------------------------
+class sgpGasmScannerForFitBlock;
+class sgpFitDataSetMapping;
 
 // ----------------------------------------------------------------------------
 // Constants
 // ----------------------------------------------------------------------------
 
+// number of samples for functions with generated samples
 const uint SAMPLE_COUNT = 200;
 const uint MIN_OUTPUT_DISTINCT_CNT = 2 + (SAMPLE_COUNT / 100);
+// each entry keeps output vectors for all samples
+const uint SGP_PRG_OUTPUT_CACHE_DEF_LIMIT = 2000;
+const uint SGP_PRG_OUTPUT_CACHE_SAMPLE_BUDGET = SGP_PRG_OUTPUT_CACHE_DEF_LIMIT * SAMPLE_COUNT;
+// each entry keeps SGP_EVAL_CHECKPOINT_COUNT register snapshots for all samples
+const uint SGP_EVAL_CHECKPOINT_CACHE_DEF_LIMIT = 200;
+const uint SGP_EVAL_CHECKPOINT_CACHE_SAMPLE_BUDGET = SGP_EVAL_CHECKPOINT_CACHE_DEF_LIMIT * SAMPLE_COUNT;
+// number of data set rows executed by VM in one batch
+const uint SGP_DATASET_BATCH_LANES = 256;
+// mini-batch: number of generations between re-scoring of best entities on all samples
+const uint SGP_MINI_BATCH_DEF_FULL_EVAL_INTERVAL = 10;
+// mini-batch: number of best entities re-scored on all samples
+const uint SGP_MINI_BATCH_DEF_FULL_EVAL_ELITE = 5;
+// number of samples executed between checks of racing limit
+const uint SGP_RACE_CHUNK_SIZE = 20;
+// values shared by objectives, calculated on demand
+const uint SGP_REGR_OBJ_DEP_BLOCK_SCAN = 1; ///<-- scan of first code block
+const uint SGP_REGR_OBJ_DEP_OUTPUT_VAR = 2; ///<-- output variability rating, requires block scan
+const uint SGP_REGR_OBJ_DEP_ALL_SAMPLES = 4; ///<-- output of all samples, value for constant output is used after lost race
+
+const scString TIMER_OBJ_DEP_BLOCK_SCAN = "gp-obj-dep-block-scan";
+const scString TIMER_OBJ_DEP_OUTPUT_VAR = "gp-obj-dep-output-var";
 
 // ----------------------------------------------------------------------------
 // Class definitions
@@ -135,12 +162,86 @@ public:
 
 typedef std::queue<sgpGpEvalPrgOutput> sgpGpEvalPrgOutputList; 
 
+/// Statistics of program output over all evaluated samples
+struct sgpGpOutputStats {
+  double errorSse;
+  double errorSseAbs;
+  double errorSum;
+  uint hitCount;
+  double fxStdDev;
+  double errorStdDev;
+  double correlYFx;
+  uint fxDistinctCnt; ///<-- counted up to MIN_OUTPUT_DISTINCT_CNT
+};
+
+/// Data available for objective evaluators of a single entity
+struct sgpRegrObjContext {
+  const sgpEntityForGasm *info;
+  const scDataNode *code;
+  const sgpGpEvalPrgOutput *prgOutput;
+  const sgpGpOutputStats *outputStats;
+  sgpGasmScannerForFitPrg *prgScanner;
+  sgpGasmScannerForFitBlock *blockScanner; ///<-- initialized by SGP_REGR_OBJ_DEP_BLOCK_SCAN
+  sgpVMachine *vmachine;
+  uint sampleCount;
+  double sampleScale;
+  ulong64 stepSize;
+  uint readyDeps;                          ///<-- SGP_REGR_OBJ_DEP_* already calculated
+  // calculated by SGP_REGR_OBJ_DEP_OUTPUT_VAR
+  double constToAllArgRatio;
+  double regDistRead;
+  double regDistWrite;
+  double variableOutputRating;
+  bool constOutput;
+};
+
+typedef double (sgpGpFitnessFun4Regression::*sgpRegrObjEvalMethod)(sgpRegrObjContext &context) const;
+
+/// Calculates value of a single objective
+struct sgpRegrObjEvaluator {
+  uint objIndex;
+  sgpRegrObjEvalMethod method;
+  uint dependencies;  ///<-- combination of SGP_REGR_OBJ_DEP_*
+  scString timerName;
+};
+
+typedef std::vector<sgpRegrObjEvaluator> sgpRegrObjEvaluatorList;
+
+/// Copyable program output, stored in cache of program outputs.
+/// Target values are the same for all programs, so they are not stored.
+class sgpGpPrgRunOutput {
+public:
+  void assign(const sgpGpEvalPrgOutput &src) {
+    fxVect = src.fxVect();
+    revFxVect = src.revFxVect();
+    notNullCnt = src.notNullCnt;
+    totalCost = src.totalCost;
+    totalTypeDiff = src.totalTypeDiff;
+  }
+  void copyTo(sgpGpEvalPrgOutput &output) const {
+    output.fxVect() = fxVect;
+    output.revFxVect() = revFxVect;
+    output.notNullCnt = notNullCnt;
+    output.totalCost = totalCost;
+    output.totalTypeDiff = totalTypeDiff;
+  }
+public:  
+  sgpFitDoubleVector fxVect;
+  sgpFitDoubleVector revFxVect;
+  uint notNullCnt;
+  long64 totalCost;
+  long64 totalTypeDiff;
+};
+
+/// Target values of program output are shared with fitness function,
+/// they are valid only until samples are changed.
 class sgpHandleProgramOutputEvent {
 public:
   virtual void execute(const sgpEntityForGasm &workInfo, const sgpGpEvalPrgOutput &prgOutput) = 0;
 };
 
-class sgpGpFitnessFun4Regression: public sgpFitnessFun4Gasm {
+class sgpGpFitnessFun4Regression: public sgpFitnessFun4Gasm, public sgpEvalCostPredictorIntf, public sgpEvalRacingIntf, 
+  public sgpEvalParallelIntf {
   typedef sgpFitnessFun4Gasm inherited;
 public:
     //-- construction
@@ -159,6 +260,14 @@ public:
     void setMaxReqUniqInstrCodeRatio(double value);
     void setRestartsEnabled(bool value);
     bool getRestartsEnabled();
+    void setFitnessCacheEnabled(bool value);
+    void setPrgOutputCacheEnabled(bool value);
+    void setIncrementalEvalEnabled(bool value);
+    void setRacingEnabled(bool value);
+    void setMiniBatchSize(uint value);
+    void setMiniBatchStratified(bool value);
+    void setFullEvalInterval(uint value);
+    void setFullEvalEliteCount(uint value);
 
     virtual uint getObjectiveCount() const;
     virtual void getObjectiveWeights(sgpWeightVector &output) const;
@@ -167,10 +276,16 @@ public:
     virtual uint getExpectedSize() const;
     virtual uint getInputCount() = 0;
     void getStats(uint &totalCalc);
+    void getCacheStats(ulong64 &hitCount, ulong64 &missCount) const;
+    void getPrgOutputCacheStats(ulong64 &hitCount, ulong64 &missCount) const;
+    void getRacingStats(uint &lostCount, ulong64 &savedRunCount) const;
 
     //-- run
     void init() {if (!m_prepared) prepare(); }
     virtual void prepare();
+    virtual ulong64 predictEvalCost(const sgpEntityBase &entity) const;
+    virtual void setSurvivalLimit(const sgpFitnessValue &value);
+    virtual bool isParallelEvalSupported() const;
 protected:
     virtual void fillObjectiveSet();
     virtual void getObjectiveSet(sgpObjectiveSet &output) const;
@@ -183,17 +298,28 @@ protected:
     void initLibs(sgpFunLib &mainLib);
 
     virtual void initProcess(sgpGaGeneration &newGeneration);
+    virtual bool postProcess(sgpGaGeneration &newGeneration);
+    bool rescoreOnAllSamples(sgpGaGeneration &generation);
+    virtual bool selectSampleRows(uint rowLimit, bool stratified);
+    virtual uint getTotalSampleCount() const;
+    double getSampleScale() const;
     void invokeEntityHandled() const;
+    bool isFitnessCacheEnabled() const;
+    bool isPrgOutputCacheEnabled() const;
+    bool isIncrementalEvalEnabled() const;
+    void calcCheckpointKey(ulong64 codeHash, sgpFitnessCacheKey &output) const;
+    bool isRacingActive() const;
 
     virtual bool calc(uint entityIndex, const sgpEntityBase *entity, sgpFitnessValue &fitness) const;
 
     virtual bool evaluateProgram(const sgpEntityForGasm &info, const scDataNode &code, sgpFitnessValue &fitness, 
-      uint entityIndex) const;
+      uint entityIndex, bool &raceLost) const;
 
-    void runProgramForSamplesSeq(
-      const scDataNode &code,
-      sgpFitDoubleVector &fxVect, sgpFitDoubleVector &yVect, 
-      uint &notNullCnt, long64 &totalCost, long64 &totalTypeDiff) const;
+    bool runProgramForSamplesSeq(
+      const sgpCompiledProgramTransporter &program,
+      sgpFitDoubleVector &fxVect, 
+      uint &notNullCnt, long64 &totalCost, long64 &totalTypeDiff, 
+      uint &runSampleCount) const;
 
     void runProgramForRevFxInRange(
       uint first, uint last,
@@ -208,10 +334,11 @@ protected:
 
     virtual void runProgramForSamplesInRange(
       uint first, uint last,
-      sgpFitDoubleVector &fxVect, sgpFitDoubleVector &yVect, 
+      sgpFitDoubleVector &fxVect, 
       uint &notNullCnt, long64 &totalCost, long64 &totalTypeDiff) const = 0;        
 
     void handleSamplesChanged();
+    void adjustEvalCacheLimits();
 
     double calcReverseFuncObj(const sgpEntityForGasm &info, 
       const sgpFitDoubleVector &fxVect, const sgpFitDoubleVector &yVect, const sgpFitDoubleVector &revFxVect) const;
@@ -219,10 +346,10 @@ protected:
     uint getReverseFuncMacroNo(const sgpEntityForGasm &info) const;
 
     void calcOutputStats(const sgpFitDoubleVector &fxVect, const sgpFitDoubleVector &yVect, 
-      double &errorSse, double &errorSseAbs, double &errorSum, uint &hitCount, sgpFitDoubleVector &errors) const;
+      sgpGpOutputStats &output) const;
 
-    void calcOutputVarRating(uint countNotNullOutput, uint fxDistinctCnt, double fxStdDev, double constToAllArgRatio, 
-      double regDistRead, double regDistWrite,
+    void calcOutputVarRating(uint sampleCount, uint countNotNullOutput, uint fxDistinctCnt, double fxStdDev, 
+      double constToAllArgRatio, double regDistRead, double regDistWrite,
       double &variableOutputRating, bool &constOutput) const;
 
     virtual void getSampleRange(int dimNo, double &minVal, double &maxVal);
@@ -232,6 +359,40 @@ protected:
     void prepareObjFreqY(const sgpFitDoubleVector &yVect, sgpFitDoubleVector &output);
     void prepareObjAmpliY(const sgpFitDoubleVector &yVect, sgpFitDoubleVector &output);
 
+    //-- objective evaluators
+    void initObjEvaluators();
+    void registerObjEvaluator(uint objIndex, sgpRegrObjEvalMethod method, uint dependencies, const scString &name);
+    void prepareObjDependencies(uint dependencies, sgpRegrObjContext &context) const;
+    double calcObjSse(sgpRegrObjContext &context) const;
+    double calcObjStdDev(sgpRegrObjContext &context) const;
+    double calcObjRegDistRead(sgpRegrObjContext &context) const;
+    double calcObjRegDistWrite(sgpRegrObjContext &context) const;
+    double calcObjRegDist(sgpRegrObjContext &context) const;
+    double calcObjVarLevel(sgpRegrObjContext &context) const;
+    double calcObjTypeDiff(sgpRegrObjContext &context) const;
+    double calcObjTotalCost(sgpRegrObjContext &context) const;
+    double calcObjProgramSize(sgpRegrObjContext &context) const;
+    double calcObjFailedWrites(sgpRegrObjContext &context) const;
+    double calcObjFailedReads(sgpRegrObjContext &context) const;
+    double calcObjWriteToInput(sgpRegrObjContext &context) const;
+    double calcObjUniqInstrCodeRatio(sgpRegrObjContext &context) const;
+    double calcObjMaxInstrSeq(sgpRegrObjContext &context) const;
+    double calcObjRelHitCount(sgpRegrObjContext &context) const;
+    double calcObjDistanceToEndOfLastWrite(sgpRegrObjContext &context) const;
+    double calcObjConstToArgRatio(sgpRegrObjContext &context) const;
+    double calcObjConstOnlyArgInstrToTotal(sgpRegrObjContext &context) const;
+    double calcObjStdDevDiffDfx(sgpRegrObjContext &context) const;
+    double calcObjStdDevDiffD2fx(sgpRegrObjContext &context) const;
+    double calcObjWriteToOutToTotalWriteCnt(sgpRegrObjContext &context) const;
+    double calcObjOutCorrel(sgpRegrObjContext &context) const;
+    double calcObjFadingMaOutDiff(sgpRegrObjContext &context) const;
+    double calcObjExtremaRelError(sgpRegrObjContext &context) const;
+    double calcObjErrorSseAbs(sgpRegrObjContext &context) const;
+    double calcObjFreqDiff(sgpRegrObjContext &context) const;
+    double calcObjAmpliDiff(sgpRegrObjContext &context) const;
+    double calcObjRevFx(sgpRegrObjContext &context) const;
+    double calcObjRegIoDist(sgpRegrObjContext &context) const;
+
 protected:
   void signalYield() const;
   float readPrgOutputAsFloat(const scDataNode &value, float defValue) const;
@@ -249,6 +410,26 @@ protected:
   uint m_sampleChangeInterval;
   uint m_expectedSize;
   mutable uint m_totalCalc;  
+  mutable boost::mutex m_calcMutex; ///<-- guards counters & events used by concurrent calc calls
+  mutable sgpFitnessCache m_fitnessCache;
+  mutable sgpEvalResultCache<sgpGpPrgRunOutput> m_prgOutputCache; ///<-- outputs by effective code
+  mutable sgpEvalResultCache<sgpNumericRunCheckpointsTransporter> m_checkpointCache; ///<-- run checkpoints by effective code
+  bool m_incrementalEvalEnabled;
+  bool m_racingEnabled;          ///<-- racing is not active with mini-batch
+  bool m_survivalLimitSet;
+  double m_survivalSseLimit;     ///<-- SSE of the worst survivor 
+  uint m_survivalLimitVersion;   ///<-- data version used for calculation of limit
+  mutable uint m_raceLostCount;  ///<-- entities which lost race in current generation
+  mutable ulong64 m_raceSavedRunCount; ///<-- sample runs saved by racing in current generation
+  uint m_miniBatchSize;          ///<-- number of samples evaluated in generation, 0 = all
+  bool m_miniBatchStratified;    ///<-- samples selected from strata of target values
+  uint m_fullEvalInterval;       ///<-- generations between re-scoring on all samples, 0 = never
+  uint m_fullEvalEliteCount;
+  uint m_miniBatchStepNo;
+  bool m_fitnessCacheEnabled;
+  bool m_prgOutputCacheEnabled;
+  bool m_deterministicRun;  ///<-- <false> if programs can use random numbers
+  uint m_fitDataVersion;    ///<-- changed when samples or objectives are changed
   double m_minConstToArgRatio;
   double m_maxReqUniqInstrCodeRatio;
 
@@ -257,9 +438,11 @@ protected:
   sgpHandleProgramOutputEvent *m_onHandleProgramOutput;
 
   uint m_objCacheExtremeCount;
+  sgpFitDoubleVector m_targetValues;    ///<-- target output for each sample, read-only during evaluation
   sgpFitDoubleVector m_objCacheFreqY;   
   sgpFitDoubleVector m_objCacheAmpliY; 
   sgpObjectiveSet m_objectiveSet;
+  sgpRegrObjEvaluatorList m_objEvaluators; ///<-- in order of calculation
 };
 
 // ----------------------------------------------------------------------------
@@ -283,7 +466,7 @@ protected:
   virtual uint calcEntityClassForTargetFuncNI1O(const sgpFitDoubleVector &fxVect, const sgpFitDoubleVector &yVect) const;
   virtual void runProgramForSamplesInRange(
     uint first, uint last,
-    sgpFitDoubleVector &fxVect, sgpFitDoubleVector &yVect, 
+    sgpFitDoubleVector &fxVect, 
     uint &notNullCnt, long64 &totalCost, long64 &totalTypeDiff) const;        
   virtual double calcTargetFunction(double x) const = 0;
   virtual void prepareObjData();
@@ -315,7 +498,7 @@ protected:
   virtual uint calcEntityClassForTargetFuncNI1O(const sgpFitDoubleVector &fxVect, const sgpFitDoubleVector &yVect) const;
   virtual void runProgramForSamplesInRange(
     uint first, uint last,
-    sgpFitDoubleVector &fxVect, sgpFitDoubleVector &yVect, 
+    sgpFitDoubleVector &fxVect, 
     uint &notNullCnt, long64 &totalCost, long64 &totalTypeDiff) const;        
   virtual uint calcEntityClass(const sgpFitDoubleVector &input1, const sgpFitDoubleVector &input2, 
     const sgpFitDoubleVector &output, const sgpFitDoubleVector &target) const;
@@ -330,5 +513,82 @@ protected:
   sgpFitDoubleVector m_inputValuesX2;
 };
 
+// ----------------------------------------------------------------------------
+// sgpFitDataSet
+// ----------------------------------------------------------------------------
+/// Samples loaded at runtime: N input columns followed by target column.
+/// Values are stored column by column. 
+/// Binary files are mapped into memory, so rows are not copied on load.
+/// CSV files are imported into memory - use saveToFile to convert big CSV 
+/// files to binary format once.
+///
+/// Binary format: header (sgpFitDataSetFileHeader) followed by 
+/// columnCount * rowCount values of type double, column by column.
+class sgpFitDataSet {
+public:
+  // construction
+  sgpFitDataSet();
+  virtual ~sgpFitDataSet();
+  // properties
+  uint getInputCount() const;
+  uint getRowCount() const;
+  bool empty() const;
+  const double *getInputColumn(uint inputNo) const;
+  const double *getTargetColumn() const;
+  // run
+  void loadFromFile(const scString &fileName);
+  void importFromCsv(const scString &fileName, bool hasHeader = true, char separator = ',');
+  void saveToFile(const scString &fileName) const;
+  void clear();
+protected:
+  std::auto_ptr<sgpFitDataSetMapping> m_mapping; ///<-- mapped binary file, empty if not loaded
+  std::vector<double> m_ownedValues; ///<-- values imported from CSV
+  const double *m_values;            ///<-- first value of first column
+  uint m_columnCount;
+  uint m_rowCount;
+};
+
+typedef boost::shared_ptr<sgpFitDataSet> sgpFitDataSetTransporter;
+
+// ----------------------------------------------------------------------------
+// sgpGpFitnessFunDataset
+// ----------------------------------------------------------------------------
+/// Regression for N inputs and one output with samples from data set
+class sgpGpFitnessFunDataset: public sgpGpFitnessFun4Regression {
+  typedef sgpGpFitnessFun4Regression inherited;
+public:
+  // construction
+  sgpGpFitnessFunDataset(): sgpGpFitnessFun4Regression() {};
+  virtual ~sgpGpFitnessFunDataset() {};
+  // properties
+  virtual uint getInputCount();
+  void setDataSet(const sgpFitDataSetTransporter &value);
+  const sgpFitDataSet *getDataSet() const;
+protected:  
+  virtual void initInputValues();
+  virtual void generateInputValues();
+  virtual uint getSampleCount() const;
+  virtual double calcStdErrorDeriveNForTargetFuncNI1O(const sgpFitDoubleVector &yVect, const sgpFitDoubleVector &fxVect, uint level) const;
+  virtual uint calcEntityClassForTargetFuncNI1O(const sgpFitDoubleVector &fxVect, const sgpFitDoubleVector &yVect) const;
+  virtual void runProgramForSamplesInRange(
+    uint first, uint last,
+    sgpFitDoubleVector &fxVect, 
+    uint &notNullCnt, long64 &totalCost, long64 &totalTypeDiff) const;        
+  virtual void fillObjectiveSet();
+  virtual void prepareObjData();
+  virtual uint getInputArgCount() const;
+  virtual bool selectSampleRows(uint rowLimit, bool stratified);
+  virtual uint getTotalSampleCount() const;
+  void selectRandomRows(uint rowLimit, sgpSampleRowList &output) const;
+  void selectStratifiedRows(uint rowLimit, sgpSampleRowList &output);
+  uint getSampleRowNo(uint sampleNo) const { 
+    return m_sampleRows.empty() ? sampleNo : m_sampleRows[sampleNo]; 
+  }
+protected:
+  sgpFitDataSetTransporter m_dataSet;
+  sgpSampleRowList m_sampleRows;    ///<-- rows evaluated in current generation, empty = all
+  sgpSampleRowList m_rowsByTarget;  ///<-- all rows ordered by target value, for stratified selection
+};
+
 
 #endif // _GPFITNESSFUN4REGRESSION_H__
@@ -7,8 +7,103 @@
 // Created:     14/07/2013
 /////////////////////////////////////////////////////////////////////////////
 
+#include <cstring>
+
 #include "sgp\FitnessFunction.h"
 
+// FNV-1a 64-bit parameters, second hash uses other offset basis & (odd) multiplier, 
+// so together they give 128-bit key
+const ulong64 SGP_FIT_HASH1_OFFSET = 0xCBF29CE484222325;
+const ulong64 SGP_FIT_HASH1_PRIME = 0x100000001B3;
+const ulong64 SGP_FIT_HASH2_OFFSET = 0x6A09E667F3BCC908;
+const ulong64 SGP_FIT_HASH2_PRIME = 0x9E3779B97F4A7C15;
+
+static void addToFitHash(const void *data, uint size, sgpFitnessCacheKey &key)
+{
+  const unsigned char *ptr = static_cast<const unsigned char *>(data);
+  for(uint i = 0; i != size; i++)
+  {
+    key.hash1 = (key.hash1 ^ ptr[i]) * SGP_FIT_HASH1_PRIME;
+    key.hash2 = (key.hash2 ^ ptr[i]) * SGP_FIT_HASH2_PRIME;
+  }  
+}
+
+// hash scalar value using it's exact bits
+template<class ValueType>
+static void addScalarToFitHash(const ValueType &value, sgpFitnessCacheKey &key)
+{
+  scDataNodeValueType valueType = value.getValueType();
+  addToFitnessCacheKey(static_cast<ulong64>(valueType), key);
+  
+  switch (valueType) {
+    case vt_null:
+      break;
+    case vt_bool: case vt_byte: case vt_uint: case vt_uint64:
+      addToFitnessCacheKey(value.getAsUInt64(), key);
+      break;
+    case vt_int: case vt_int64:
+      addToFitnessCacheKey(static_cast<ulong64>(value.getAsInt64()), key);
+      break;
+    case vt_float: {
+      float fvalue = value.getAsFloat();
+      addToFitHash(&fvalue, sizeof(fvalue), key);
+      break;
+    }  
+    case vt_double: {
+      double dvalue = value.getAsDouble();
+      addToFitHash(&dvalue, sizeof(dvalue), key);
+      break;
+    }  
+    default: {
+      // exact text representation for other types (xdouble has padding bytes)
+      scString svalue = value.getAsString();
+      addToFitHash(svalue.c_str(), svalue.length() * sizeof(scChar), key);
+    }  
+  }
+}
+
+void initFitnessCacheKey(uint dataVersion, sgpFitnessCacheKey &output)
+{
+  output.hash1 = SGP_FIT_HASH1_OFFSET;
+  output.hash2 = SGP_FIT_HASH2_OFFSET;
+  output.dataVersion = dataVersion;
+}
+
+void addToFitnessCacheKey(ulong64 value, sgpFitnessCacheKey &output)
+{
+  addToFitHash(&value, sizeof(value), output);
+}
+
+void addToFitnessCacheKey(const scDataNode &value, sgpFitnessCacheKey &output)
+{
+  if (value.isArray() || value.isParent()) {
+    scDataNode element;
+    addToFitnessCacheKey(static_cast<ulong64>(value.size()), output);
+    for(uint i = 0, epos = value.size(); i != epos; i++)
+    {
+      value.getElement(i, element);
+      addToFitnessCacheKey(element, output);
+    }
+  } else {
+    addScalarToFitHash(value, output);
+  }
+}
+
+void calcFitnessCacheKey(const sgpEntityBase &entity, uint dataVersion, sgpFitnessCacheKey &output)
+{
+  sgpGaGenome genome;
+  
+  initFitnessCacheKey(dataVersion, output);
+  
+  for(uint i = 0, epos = entity.getGenomeCount(); i != epos; i++)
+  {
+    entity.getGenome(i, genome);
+    addToFitnessCacheKey(static_cast<ulong64>(genome.size()), output);
+    for(uint j = 0, eposj = genome.size(); j != eposj; j++)
+      addScalarToFitHash(genome[j], output);
+  }
+}
+
 // ----------------------------------------------------------------------------
 // sgpFitnessFunction
 // ----------------------------------------------------------------------------
@@ -36,4 +131,3 @@ void sgpFitnessFunction::getObjectiveSigns(sgpObjectiveSigns &output) const
 {
   throw scNotImplementedError();
 }
-
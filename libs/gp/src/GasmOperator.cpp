@@ -507,16 +507,13 @@ bool sgpGasmCodeProcessor::buildRandomInstr(const sgpFunctionMapColn &functions,
   uint argCnt = 0;
   uint argNo = 0;
   
-  sgpFunctionMapColnIterator p = const_cast<sgpFunctionMapColn &>(functions).find(instrCode);
-  sgpFunction *functor;
+  sgpFunction *functor = functions.getFunctor(instrCode);
   
-  if (p == functions.end()) {
+  if (functor == SC_NULL) {
     return false;
   } 
   
-  sgpFunctionTransporter transporter = p->second;
   uint minArgCount, maxArgCount;
-  functor = &(*transporter);
   scDataNodeValue newCell;
   uint instrCodeEnc;
 
@@ -8,13 +8,244 @@
 // Created:     05/06/2010
 /////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+
+#include "boost/bind.hpp"
+
+#include "sc/defs.h"
+
 #include "sgp/GasmOperatorEvaluateIslands.h"
 
 #ifdef DEBUG_MEM
 #include "sc/DebugMem.h"
 #endif
 
+// ----------------------------------------------------------------------------
+// sgpGasmEvalTaskQueue
+// ----------------------------------------------------------------------------
+void sgpGasmEvalTaskQueue::clear()
+{
+  boost::mutex::scoped_lock lock(m_mutex);
+  m_items.clear();
+}
+
+void sgpGasmEvalTaskQueue::push(uint itemIndex)
+{
+  boost::mutex::scoped_lock lock(m_mutex);
+  m_items.push_back(itemIndex);
+}
+
+bool sgpGasmEvalTaskQueue::popFront(uint &itemIndex)
+{
+  boost::mutex::scoped_lock lock(m_mutex);
+  if (m_items.empty())
+    return false;
+  itemIndex = m_items.front();
+  m_items.pop_front();
+  return true;
+}
+
+bool sgpGasmEvalTaskQueue::popBack(uint &itemIndex)
+{
+  boost::mutex::scoped_lock lock(m_mutex);
+  if (m_items.empty())
+    return false;
+  itemIndex = m_items.back();
+  m_items.pop_back();
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// sgpGasmEvalWorkerPool
+// ----------------------------------------------------------------------------
+sgpGasmEvalWorkerPool::sgpGasmEvalWorkerPool(): m_workerCount(0), m_stopped(false), m_batchNo(0),
+  m_generation(SC_NULL), m_fitnessFunc(SC_NULL)
+{
+}
+
+sgpGasmEvalWorkerPool::~sgpGasmEvalWorkerPool()
+{
+  stop();
+}
+
+uint sgpGasmEvalWorkerPool::getWorkerCount() const
+{
+  return m_workerCount;
+}
+
+void sgpGasmEvalWorkerPool::start(uint workerCount)
+{
+  stop();
+  m_stopped = false;
+  m_workerCount = workerCount;
+  for(uint i = 0; i != workerCount; i++)
+    m_queues.push_back(new sgpGasmEvalTaskQueue());
+  for(uint i = 0; i != workerCount; i++)
+    m_threads.push_back(new boost::thread(boost::bind(&sgpGasmEvalWorkerPool::runWorker, this, i)));
+}
+
+void sgpGasmEvalWorkerPool::stop()
+{
+  if (m_workerCount == 0)
+    return;
+    
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_stopped = true;
+  }
+  m_workReady.notify_all();
+  
+  for(uint i = 0, epos = m_threads.size(); i != epos; i++)
+    m_threads[i].join();
+  m_threads.clear();
+  m_queues.clear();
+  m_workerCount = 0;
+}
+
+// start evaluation of all entities, fitness function has to be prepared already
+void sgpGasmEvalWorkerPool::beginBatch(const sgpGaGeneration &generation, const sgpFitnessFunction &fitnessFunc)
+{
+  uint itemCount = generation.size();
+  
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_generation = &generation;
+    m_fitnessFunc = &fitnessFunc;
+    m_results.resize(itemCount);
+    m_states.assign(itemCount, geisPending);
+    m_errorMsg.clear();
+  }
+  
+  dispatchItems(generation, fitnessFunc);
+  
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_batchNo++;
+  }
+  m_workReady.notify_all();
+}
+
+static bool isEvalCostGreater(const std::pair<ulong64, uint> &lhs, const std::pair<ulong64, uint> &rhs)
+{
+  return (lhs.first > rhs.first) || ((lhs.first == rhs.first) && (lhs.second < rhs.second));
+}
+
+// deal entities to worker queues in order of decreasing predicted cost, 
+// so each worker starts with it's most expensive entity
+void sgpGasmEvalWorkerPool::dispatchItems(const sgpGaGeneration &generation, const sgpFitnessFunction &fitnessFunc)
+{
+  uint itemCount = generation.size();
+  const sgpEvalCostPredictorIntf *predictor = dynamic_cast<const sgpEvalCostPredictorIntf *>(&fitnessFunc);
+  std::vector<std::pair<ulong64, uint> > order(itemCount);
+  
+  for(uint i = 0; i != itemCount; i++)
+  {
+    order[i].first = (predictor != SC_NULL) ? predictor->predictEvalCost(generation.at(i)) : 0;
+    order[i].second = i;
+  }  
+  
+  if (predictor != SC_NULL)
+    std::sort(order.begin(), order.end(), isEvalCostGreater);
+
+  for(uint i = 0; i != m_workerCount; i++)
+    m_queues[i].clear();
+    
+  for(uint i = 0; i != itemCount; i++)
+    m_queues[i % m_workerCount].push(order[i].second);
+}
+
+// wait until entity is evaluated, returns sgpEvalItemState
+uint sgpGasmEvalWorkerPool::waitForItem(uint itemIndex, sgpFitnessValue &fitness)
+{
+  boost::mutex::scoped_lock lock(m_mutex);
+  while(m_states[itemIndex] == geisPending)
+    m_itemDone.wait(lock);
+  fitness = m_results[itemIndex];
+  return m_states[itemIndex];
+}
+
+// finish batch, all items have to be processed already
+void sgpGasmEvalWorkerPool::endBatch(scString &errorMsg)
+{
+  boost::mutex::scoped_lock lock(m_mutex);
+  errorMsg = m_errorMsg;
+}
+
+void sgpGasmEvalWorkerPool::runWorker(uint workerNo)
+{
+  uint doneBatchNo = 0;
+  uint itemIndex;
+  
+  while(true) {
+    {
+      boost::mutex::scoped_lock lock(m_mutex);
+      while(!m_stopped && (m_batchNo == doneBatchNo))
+        m_workReady.wait(lock);
+      if (m_stopped) 
+        break;
+      doneBatchNo = m_batchNo;
+    }
+
+    while(fetchItem(workerNo, itemIndex))
+      evaluateItem(itemIndex);
+  }  
+}
+
+// take next entity from own queue or steal one from other worker
+bool sgpGasmEvalWorkerPool::fetchItem(uint workerNo, uint &itemIndex)
+{
+  if (m_queues[workerNo].popFront(itemIndex))
+    return true;
+    
+  for(uint i = 1; i < m_workerCount; i++)
+    if (m_queues[(workerNo + i) % m_workerCount].popBack(itemIndex))
+      return true;
+      
+  return false;
+}
+
+// calculate fitness of a single entity, result slot is owned by the calling worker 
+// until state is changed
+void sgpGasmEvalWorkerPool::evaluateItem(uint itemIndex)
+{
+  uint state;
+  scString errorMsg;
+  
+  try {
+    if (m_fitnessFunc->calc(itemIndex, &(m_generation->at(itemIndex)), m_results[itemIndex]))
+      state = geisOk;
+    else
+      state = geisStop;  
+  }
+  catch(scError &excp) {
+    state = geisError;
+    errorMsg = scString("Exception (scError): ") + excp.what()+", details: "+excp.getDetails();
+  }
+  catch(const std::exception& e) {
+    state = geisError;
+    errorMsg = scString("Exception (std): ") + e.what();
+  }
+  catch(...) {
+    // state has to be changed, otherwise waitForItem never returns
+    state = geisError;
+    errorMsg = scString("Exception (unknown)");
+  }
+  
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_states[itemIndex] = state;
+    if ((state == geisError) && m_errorMsg.empty())
+      m_errorMsg = errorMsg;
+  }
+  m_itemDone.notify_all();
+}
+
+// ----------------------------------------------------------------------------
+// sgpGasmOperatorEvaluateIslands
+// ----------------------------------------------------------------------------
 sgpGasmOperatorEvaluateIslands::sgpGasmOperatorEvaluateIslands(): sgpGaOperatorEvaluateBasic() {
+  m_workerCount = SGP_EVAL_DEF_WORKER_COUNT;
+  m_yieldSignal = SC_NULL;
 }
  
 sgpGasmOperatorEvaluateIslands::~sgpGasmOperatorEvaluateIslands()
@@ -27,6 +258,26 @@ void sgpGasmOperatorEvaluateIslands::setIslandLimit(uint value)
   m_islandLimit = value;
 }
 
+/// number of threads used for evaluation, 1 = evaluate in calling thread,
+/// SGP_EVAL_AUTO_WORKER_COUNT = one thread for each hardware thread
+void sgpGasmOperatorEvaluateIslands::setWorkerCount(uint value)
+{
+  m_workerCount = value;
+}
+
+uint sgpGasmOperatorEvaluateIslands::getWorkerCount() const
+{
+  if (m_workerCount != SGP_EVAL_AUTO_WORKER_COUNT)
+    return m_workerCount;
+  // can be 0 if not known  
+  return std::max<uint>(boost::thread::hardware_concurrency(), 1);
+}
+
+void sgpGasmOperatorEvaluateIslands::setYieldSignal(scSignal *value)
+{
+  m_yieldSignal = value;
+}
+
 // run
 bool sgpGasmOperatorEvaluateIslands::execute(uint stepNo, bool isNewGen, sgpGaGeneration &generation)
 {
@@ -54,6 +305,7 @@ bool sgpGasmOperatorEvaluateIslands::processBuffer(sgpGaGeneration &generation)
   if (m_fitnessFunc == SC_NULL) 
     return res;
 
+  publishSurvivalLimit(generation);
   m_fitnessFunc->initProcess(generation);    
 
 #ifdef DEBUG_OPER_EVAL
@@ -61,7 +313,10 @@ bool sgpGasmOperatorEvaluateIslands::processBuffer(sgpGaGeneration &generation)
 #endif  
     
   //res = m_fitnessFunc->evaluateAll(&generation);
-  res = evaluateAll(&generation);
+  if (isParallelEvalEnabled())
+    res = evaluateAllParallel(generation);
+  else
+    res = evaluateAll(&generation);
 
 #ifdef DEBUG_OPER_EVAL
   scLog::addDebug("gasm-oper-island-eval-a2");  
@@ -77,3 +332,101 @@ bool sgpGasmOperatorEvaluateIslands::processBuffer(sgpGaGeneration &generation)
   return res;  
 }
 
+// Inform fitness function about the worst survivor of last selection (racing).
+// Generation contains survivors (elite, tournament winners) and their offspring
+// which carry fitness of parent until evaluated, so minimum of each objective 
+// over evaluated entities is the limit of survival. New entities have no fitness yet.
+void sgpGasmOperatorEvaluateIslands::publishSurvivalLimit(const sgpGaGeneration &generation)
+{
+  sgpEvalRacingIntf *racing = dynamic_cast<sgpEvalRacingIntf *>(m_fitnessFunc);
+  if (racing == SC_NULL)
+    return;
+    
+  uint objCount = m_fitnessFunc->getObjectiveCount();
+  sgpFitnessValue survivalLimit;
+  bool survivalLimitSet = false;
+  
+  for(uint i = 0, epos = generation.size(); i != epos; i++)
+  {
+    const sgpFitnessValue &fitness = generation.at(i).getFitnessVector();
+    if (fitness.size() < objCount)
+      continue;
+      
+    if (!survivalLimitSet) {
+      survivalLimit = fitness;
+      survivalLimitSet = true;
+      continue;
+    }
+    
+    for(uint j = 0; j != objCount; j++)
+      if (fitness[j] < survivalLimit[j])
+        survivalLimit[j] = fitness[j];
+  }
+  
+  // empty limit disables racing
+  racing->setSurvivalLimit(survivalLimit);
+}
+
+bool sgpGasmOperatorEvaluateIslands::isParallelEvalEnabled() const
+{
+#if defined(TRACE_ENTITY_BIO) || defined(TRACE_TIME)
+  // entity tracer & timers are global, evaluation order has to be preserved
+  return false;
+#else
+  // fitness function has to declare that it can be evaluated in parallel
+  const sgpEvalParallelIntf *parallel = dynamic_cast<const sgpEvalParallelIntf *>(m_fitnessFunc);
+  return 
+    (parallel != SC_NULL) && parallel->isParallelEvalSupported() 
+    && 
+    (getWorkerCount() > 1);
+#endif
+}
+
+// evaluate generation using worker pool, fitness is written back in entity order
+bool sgpGasmOperatorEvaluateIslands::evaluateAllParallel(sgpGaGeneration &generation)
+{
+  bool res = true;
+  uint itemCount = generation.size();
+  sgpFitnessValue fitness;
+  scString errorMsg;
+  
+  if (itemCount == 0)
+    return res;
+
+  if (m_workerPool.get() == SC_NULL)
+    m_workerPool.reset(new sgpGasmEvalWorkerPool());
+
+  if (m_workerPool->getWorkerCount() != getWorkerCount())
+    m_workerPool->start(getWorkerCount());
+
+  m_workerPool->beginBatch(generation, *m_fitnessFunc);
+
+  for(uint i = 0; i != itemCount; i++)
+  {
+    switch (m_workerPool->waitForItem(i, fitness)) {
+      case geisOk:
+        generation.at(i).setFitness(fitness);
+        break;
+      case geisStop:
+        generation.at(i).setFitness(fitness);
+        res = false;
+        break;
+      default: // error, entity is not updated
+        res = false;
+    }
+    signalNextEntity();
+  }
+
+  m_workerPool->endBatch(errorMsg);
+  
+  if (!errorMsg.empty())
+    throw scError(errorMsg);
+      
+  return res;
+}
+
+void sgpGasmOperatorEvaluateIslands::signalNextEntity()
+{
+  if (m_yieldSignal != SC_NULL)
+    m_yieldSignal->execute();
+}
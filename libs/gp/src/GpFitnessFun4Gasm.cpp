@@ -10,11 +10,13 @@
 
 #include "sc/defs.h"
 #include "sc/timer.h"
+#include "sc/counter.h"
 #include "sc/log.h"
 
 #include "sgp/GpFitnessFun4Gasm.h"
 
-sgpFitnessFun4Gasm::sgpFitnessFun4Gasm(): inherited(), m_prepared(false)
+sgpFitnessFun4Gasm::sgpFitnessFun4Gasm(): inherited(), m_prepared(false), m_optimizeCodeEnabled(false), 
+  m_contextEpoch(0)
 {
   m_mainLib.reset(new sgpFunLib());
   m_supportedDataTypes = gdtfAll;
@@ -36,14 +38,54 @@ sgpFunctionMapColn &sgpFitnessFun4Gasm::getFunctions()
 
 void sgpFitnessFun4Gasm::setSupportedDataTypes(uint mask)
 {
+  if (m_supportedDataTypes == mask)
+    return;
   m_supportedDataTypes = mask;
+  // vmachine features depend on data types
+  m_contextEpoch++;
+}
+
+// Optimization of prepared code (constant folding, identity operations). 
+// Cost of program is the cost of optimized code (foldable or identity 
+// instructions cost as move), so it changes value of cost objective.
+void sgpFitnessFun4Gasm::setOptimizeCodeEnabled(bool value)
+{
+  if (m_optimizeCodeEnabled == value)
+    return;
+  m_optimizeCodeEnabled = value;
+  m_contextEpoch++;
+}
+
+bool sgpFitnessFun4Gasm::isOptimizeCodeEnabled() const
+{
+  return m_optimizeCodeEnabled;
 }
 
 void sgpFitnessFun4Gasm::initProcess(sgpGaGeneration &newGeneration)
 {
   prepare();
-  m_vmachine.reset(new sgpVMachine());
-  initVMachine(*m_vmachine);  
+  getVMachine();
+}
+
+// returns context of calling thread, context is created on first use
+sgpFitGasmContext &sgpFitnessFun4Gasm::getContext() const
+{
+  sgpFitGasmContext *context = m_contexts.get();
+  
+  if ((context == SC_NULL) || (context->getEpoch() != m_contextEpoch)) {
+    // function library is not thread-safe
+    boost::mutex::scoped_lock lock(m_contextMutex);
+    context = new sgpFitGasmContext(m_contextEpoch);
+    m_contexts.reset(context);
+    initVMachine(context->getVMachine());
+  }
+  
+  return *context;
+}
+
+sgpVMachine &sgpFitnessFun4Gasm::getVMachine() const
+{
+  return getContext().getVMachine();
 }
 
 void sgpFitnessFun4Gasm::initVMachine(sgpVMachine &vmachine) const 
@@ -60,7 +102,18 @@ void sgpFitnessFun4Gasm::initVMachine(sgpVMachine &vmachine) const
   if (!isFunctionSupported("ref.build"))
     if ((vmachine.getSupportedArgTypes() & gatfRef) != 0)
       vmachine.setSupportedArgTypes((vmachine.getSupportedArgTypes() ^ gatfRef));
-      
+
+  // unboxed accumulators, threaded engine, native run of statically typed programs - for speed
+  vmachine.setFeatures(vmachine.getFeatures() | ggfTypedRegsEnabled | ggfThreadedRun | ggfNativeRun);
+
+  // optional - changes cost of program
+  if (m_optimizeCodeEnabled)
+    vmachine.setFeatures(vmachine.getFeatures() | ggfOptimizeCode);
+
+  // numeric programs - run compiled blocks directly on input values
+  if (sgpVMachine::isNumericProfileSupported(m_functions, m_supportedDataTypes))
+    vmachine.setFeatures(vmachine.getFeatures() | ggfNumericProfile);
+
   vmachine.setMaxStackDepth(10);
 }  
 
@@ -82,22 +135,26 @@ bool sgpFitnessFun4Gasm::isFunctionSupported(const scString &aName) const
   return res;
 }
 
-void sgpFitnessFun4Gasm::setVMachineProgram(sgpVMachine &vmachine, const scDataNode &code) const
+// returns program which can be executed by vmachine of any thread
+sgpCompiledProgramTransporter sgpFitnessFun4Gasm::compileProgram(const sgpVMachine &vmachine, 
+  const scDataNode &code) const
 {
-  _TRCSTEP_;
-  sgpProgramCode prg;    
-  prg.setFullCode(code);
 #ifdef TRACE_TIME  
   scTimer::start(TIMER_PREPARE_CODE);  
 #endif  
-  vmachine.expandCode(prg);  
-  vmachine.prepareCode(prg);
+  sgpCompiledProgramTransporter res = vmachine.compileProgram(code);
 #ifdef TRACE_TIME  
   scTimer::stop(TIMER_PREPARE_CODE);  
+  scCounter::inc(COUNTER_PREPARE_CODE_INSTR, res->getInstrCount());
+  scCounter::inc(COUNTER_PREPARE_CODE_EFF_INSTR, res->getEffInstrCount());
 #endif  
+  return res;
+}
+
+void sgpFitnessFun4Gasm::setVMachineProgram(sgpVMachine &vmachine, const scDataNode &code) const
+{
   _TRCSTEP_;
-  vmachine.setProgramCode(prg);
-  vmachine.forceInstrCache();
+  vmachine.setCompiledProgram(compileProgram(vmachine, code));
   _TRCSTEP_;
 }  
 
@@ -129,6 +186,8 @@ void sgpFitnessFun4Gasm::intPrepare()
   initLibs(*m_mainLib);
   initFunctionList();
   prepareFunctions();
+  // vmachines of all threads are initialized again with new function list
+  m_contextEpoch++;
 }
 
 void sgpFitnessFun4Gasm::prepareFunctions()
@@ -141,23 +200,179 @@ void sgpFitnessFun4Gasm::prepareFunctions()
 
 void sgpFitnessFun4Gasm::runProgram(const scDataNode &input, scDataNode &output, uint startBlockNo) const
 {      
+  sgpVMachine &vmachine = getVMachine();
+#ifdef TRACE_TIME
+  scTimer::start(TIMER_RUNPRG_CORE);
+#endif
+  try {              
+    vmachine.resetWarmWay();
+    vmachine.setInput(input);
+    vmachine.setStartBlockNo(startBlockNo);
+    vmachine.run(getProgramStepLimit());
+  } 
+  catch(scError &excp) {
+    scLog::addError(scString("Exception (scError): ") + excp.what()+", details: "+excp.getDetails());
+  }
+  catch(const std::exception& e) {
+    scLog::addError(scString("Exception (std): ") + e.what());
+  }
+  output = vmachine.getOutput();
+#ifdef TRACE_TIME
+  scTimer::stop(TIMER_RUNPRG_CORE);
+  // together with TIMER_RUNPRG_CORE gives instructions/sec of vmachine engine
+  scCounter::inc(COUNTER_RUNPRG_INSTR, vmachine.getInstrCount());
+#endif
+}
+
+// run program for a single row of numeric input values, fast path for numeric profile
+void sgpFitnessFun4Gasm::runProgramNumeric(const double *inputs, uint inputCount, scDataNode &output, 
+  uint startBlockNo) const
+{      
+  sgpVMachine &vmachine = getVMachine();
+#ifdef TRACE_TIME
+  scTimer::start(TIMER_RUNPRG_CORE);
+#endif
+  try {              
+    vmachine.runNumeric(inputs, inputCount, gdtfFloat, startBlockNo, output, getProgramStepLimit());
+  } 
+  catch(scError &excp) {
+    scLog::addError(scString("Exception (scError): ") + excp.what()+", details: "+excp.getDetails());
+    output = vmachine.getOutput();
+  }
+  catch(const std::exception& e) {
+    scLog::addError(scString("Exception (std): ") + e.what());
+    output = vmachine.getOutput();
+  }
+#ifdef TRACE_TIME
+  scTimer::stop(TIMER_RUNPRG_CORE);
+  scCounter::inc(COUNTER_RUNPRG_INSTR, vmachine.getInstrCount());
+#endif
+}
+
+// Run program for a given sample, store checkpoints of run if checkpoint run is active.
+// If program with the same code prefix was executed before for the same sample, 
+// run is resumed from the last of it's checkpoints inside of common code.
+void sgpFitnessFun4Gasm::runProgramNumeric(uint sampleNo, const double *inputs, uint inputCount, 
+  scDataNode &output, uint startBlockNo) const
+{      
+  sgpFitGasmContext &context = getContext();
+  sgpNumericRunCheckpoints *recorded = context.getRecorded();
+  
+  if ((recorded == SC_NULL) || (sampleNo >= recorded->getSampleCount())) {
+    runProgramNumeric(inputs, inputCount, output, startBlockNo);
+    return;
+  }
+  
+  sgpVMachine &vmachine = context.getVMachine();
+  const sgpNumericRunCheckpoints *source = context.getSource();
+  sgpNumericCheckpointVector &checkpoints = recorded->getSample(sampleNo);
+  const sgpNumericCheckpoint *resumePoint = SC_NULL;
+  
+  checkpoints.clear();
+  
+  // checkpoints inside of common code are valid for both programs
+  if ((source != SC_NULL) && (sampleNo < source->getSampleCount())) {
+    const sgpNumericCheckpointVector &sourceCheckpoints = source->getSample(sampleNo);
+    for(uint i=0, epos = sourceCheckpoints.size(); i != epos; i++) {
+      if (sourceCheckpoints[i].cellNo > context.getCommonCodeLength())
+        break;
+      checkpoints.push_back(sourceCheckpoints[i]);
+    }  
+    if (!checkpoints.empty())
+      resumePoint = &checkpoints.back();
+  }
+    
 #ifdef TRACE_TIME
   scTimer::start(TIMER_RUNPRG_CORE);
 #endif
   try {              
-    m_vmachine->resetWarmWay();
-    m_vmachine->setInput(input);
-    m_vmachine->setStartBlockNo(startBlockNo);
-    m_vmachine->run(getProgramStepLimit());
+    bool resumed = 
+      (resumePoint != SC_NULL) 
+      && 
+      vmachine.resumeNumeric(*resumePoint, inputs, inputCount, gdtfFloat, startBlockNo, output, 
+        getProgramStepLimit(), SGP_EVAL_CHECKPOINT_COUNT, checkpoints);
+        
+    if (!resumed) {
+      checkpoints.clear();
+      vmachine.runNumeric(inputs, inputCount, gdtfFloat, startBlockNo, output, 
+        getProgramStepLimit(), SGP_EVAL_CHECKPOINT_COUNT, checkpoints);
+    }
+#ifdef TRACE_TIME
+    else {
+      scCounter::inc(COUNTER_RUNPRG_RESUMED, 1);
+    }  
+#endif    
   } 
   catch(scError &excp) {
     scLog::addError(scString("Exception (scError): ") + excp.what()+", details: "+excp.getDetails());
+    checkpoints.clear();
+    output = vmachine.getOutput();
   }
   catch(const std::exception& e) {
     scLog::addError(scString("Exception (std): ") + e.what());
+    checkpoints.clear();
+    output = vmachine.getOutput();
   }
-  output = m_vmachine->getOutput();
 #ifdef TRACE_TIME
   scTimer::stop(TIMER_RUNPRG_CORE);
+  scCounter::inc(COUNTER_RUNPRG_INSTR, vmachine.getInstrCount());
 #endif
 }
+
+// Start recording checkpoints of numeric runs of program block, <source> - checkpoints 
+// of other program (e.g. parent of evaluated entity) which can be used to resume runs
+void sgpFitnessFun4Gasm::beginCheckpointRun(const sgpCompiledProgramTransporter &program, uint blockNo, 
+  uint sampleCount, const sgpNumericRunCheckpointsTransporter &source) const
+{
+  cell_size_t commonCodeLength = 0;
+  
+  if (source)
+    commonCodeLength = program->getCommonCodeLength(source->getProgram(), blockNo);
+    
+  getContext().beginCheckpointRun(
+    sgpNumericRunCheckpointsGuard(new sgpNumericRunCheckpoints(program, sampleCount)), 
+    source, commonCodeLength);
+}
+
+// returns checkpoints recorded since beginCheckpointRun
+sgpNumericRunCheckpointsTransporter sgpFitnessFun4Gasm::endCheckpointRun() const
+{
+  return getContext().endCheckpointRun();
+}
+
+bool sgpFitnessFun4Gasm::isCheckpointRunActive() const
+{
+  return (getContext().getRecorded() != SC_NULL);
+}
+
+// run program for all rows of input matrix at once, returns <false> on exception - 
+// rows have to be executed again using runProgram then
+bool sgpFitnessFun4Gasm::runProgramBatch(const sgpBatchInputVector &inputs, uint inputCount, 
+  scDataNode &outputs, sgpBatchCostVector &costs, uint startBlockNo) const
+{
+  bool res = true;
+  
+  if (inputs.empty() || (inputCount == 0))
+    return false;
+
+  sgpVMachine &vmachine = getVMachine();
+    
+#ifdef TRACE_TIME
+  scTimer::start(TIMER_RUNPRG_CORE);
+#endif
+  try {              
+    vmachine.resetWarmWay();
+    vmachine.setStartBlockNo(startBlockNo);
+    vmachine.runBatch(&inputs[0], inputs.size() / inputCount, inputCount, gdtfFloat, 
+      outputs, costs, getProgramStepLimit());
+  } 
+  catch(...) {
+  // error is logged when rows are executed again
+    res = false;
+  }
+#ifdef TRACE_TIME
+  scTimer::stop(TIMER_RUNPRG_CORE);
+  scCounter::inc(COUNTER_RUNPRG_INSTR, vmachine.getInstrCount());
+#endif
+  return res;
+}
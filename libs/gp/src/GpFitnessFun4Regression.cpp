@@ -11,6 +11,13 @@
 #include <limits>
 #include <algorithm>
 #include <numeric>
+#include <fstream>
+#include <set>
+#include <cstring>
+#include <cstdlib>
+
+// boost
+#include "boost/iostreams/device/mapped_file.hpp"
 
 // sc
 #include "sc/defs.h"
@@ -105,6 +112,11 @@ const double NULL_INC_DIFF = 100.0;
 const uint EXTREME_COUNT_GAP = 1;
 const uint REV_FX_NULL_MACRO_NO = 0;
 
+// guard of vector owned by fitness function
+struct sgpNullDeleter {
+  void operator()(const void *) const {}
+};
+
 
 
 //#define COUT_ENABLED
@@ -122,6 +134,43 @@ bool less_2dims( dim2rec const &lhs, dim2rec const &rhs )
   return ((lhs.second < rhs.second) || ((lhs.second == rhs.second) && (lhs.first < rhs.first)));
 }
 
+// part of SSE objective for a single sample
+inline double calcSampleErrorForSse(double fx, double y)
+{
+  double sampleErrorForSse = 1.0 + relativeErrorMinMax<double>(fx, y);
+  return (sampleErrorForSse * sampleErrorForSse);
+}
+
+// number of distinct values, counting stops at <limit> (<= MIN_OUTPUT_DISTINCT_CNT)
+// all NaN values are counted as a single value (NaN is not equal to itself)
+uint countDistinctValues(const double *values, uint count, uint limit)
+{
+  double found[MIN_OUTPUT_DISTINCT_CNT];
+  uint foundCnt = 0;
+  uint valueCnt = 0;
+  bool nanFound = false;
+  uint j;
+  
+  for(uint i = 0; (i != count) && (foundCnt < limit); i++) {
+    if (isnan(values[i])) {
+      if (!nanFound) {
+        nanFound = true;
+        foundCnt++;
+      }  
+      continue;
+    }
+    for(j = 0; j != valueCnt; j++)
+      if (found[j] == values[i])
+        break;
+    if (j == valueCnt) {
+      found[valueCnt++] = values[i];
+      foundCnt++;
+    }  
+  }
+  
+  return foundCnt;
+}
+
 sgpGpFitnessFun4Regression::sgpGpFitnessFun4Regression(): sgpFitnessFun4Gasm() {
   m_restartsEnabled = true;   
 
@@ -139,8 +188,27 @@ sgpGpFitnessFun4Regression::sgpGpFitnessFun4Regression(): sgpFitnessFun4Gasm() {
   m_adfsEnabled = false;
   m_stepCounter = 0;
   m_totalCalc = 0; 
+  m_fitnessCacheEnabled = false;
+  m_prgOutputCacheEnabled = false;
+  m_deterministicRun = false;
+  m_fitDataVersion = 0;
+  m_prgOutputCache.setLimit(SGP_PRG_OUTPUT_CACHE_DEF_LIMIT);
+  m_checkpointCache.setLimit(SGP_EVAL_CHECKPOINT_CACHE_DEF_LIMIT);
+  m_incrementalEvalEnabled = false;
+  m_racingEnabled = false;
+  m_survivalLimitSet = false;
+  m_survivalSseLimit = 0.0;
+  m_survivalLimitVersion = 0;
+  m_raceLostCount = 0;
+  m_raceSavedRunCount = 0;
+  m_miniBatchSize = 0;
+  m_miniBatchStratified = false;
+  m_fullEvalInterval = SGP_MINI_BATCH_DEF_FULL_EVAL_INTERVAL;
+  m_fullEvalEliteCount = SGP_MINI_BATCH_DEF_FULL_EVAL_ELITE;
+  m_miniBatchStepNo = 0;
 
   m_expectedSize = 0;
+  initObjEvaluators();
 }
 
 
@@ -206,6 +274,106 @@ void sgpGpFitnessFun4Regression::getObjectiveSet(sgpObjectiveSet &output) const
 void sgpGpFitnessFun4Regression::setObjectiveSet(const sgpObjectiveSet &value)
 {
   m_objectiveSet = value;
+  m_fitDataVersion++;
+}
+
+void sgpGpFitnessFun4Regression::setFitnessCacheEnabled(bool value)
+{
+  m_fitnessCacheEnabled = value;
+}
+
+bool sgpGpFitnessFun4Regression::isFitnessCacheEnabled() const
+{
+#ifdef TRACE_ENTITY_BIO
+  // tracer needs to be informed about each evaluation 
+  return false;
+#else
+  return m_fitnessCacheEnabled && m_deterministicRun;
+#endif
+}
+
+// Program output cache: outputs of programs with the same effective code are 
+// calculated only once for a given version of data.
+void sgpGpFitnessFun4Regression::setPrgOutputCacheEnabled(bool value)
+{
+  m_prgOutputCacheEnabled = value;
+}
+
+bool sgpGpFitnessFun4Regression::isPrgOutputCacheEnabled() const
+{
+  return m_prgOutputCacheEnabled && m_deterministicRun;
+}
+
+// Incremental evaluation: samples are executed one by one with checkpoints of run 
+// stored for each of them, so offspring can resume runs from checkpoints of parent
+// placed before first code change. 
+void sgpGpFitnessFun4Regression::setIncrementalEvalEnabled(bool value)
+{
+  m_incrementalEvalEnabled = value;
+}
+
+bool sgpGpFitnessFun4Regression::isIncrementalEvalEnabled() const
+{
+  return m_incrementalEvalEnabled && m_deterministicRun;
+}
+
+void sgpGpFitnessFun4Regression::calcCheckpointKey(ulong64 codeHash, sgpFitnessCacheKey &output) const
+{
+  initFitnessCacheKey(m_fitDataVersion, output);
+  addToFitnessCacheKey(codeHash, output);
+}
+
+// Racing: samples are executed in chunks, evaluation is stopped when partial SSE 
+// is already worse than SSE of the worst survivor of last selection. 
+// Such entity receives the worst possible SSE, other objectives are rated 
+// using output of executed samples.
+// Limit is valid only for data version it was calculated for, so racing is not 
+// active with mini-batch (rows are selected again in each generation).
+void sgpGpFitnessFun4Regression::setRacingEnabled(bool value)
+{
+  m_racingEnabled = value;
+}
+
+void sgpGpFitnessFun4Regression::setSurvivalLimit(const sgpFitnessValue &value)
+{
+  if (value.size() <= FUN_REGR_OBJ_IDX_ERROR_Sse) {
+    m_survivalLimitSet = false;
+    return;
+  }  
+  
+  m_survivalSseLimit = -value[FUN_REGR_OBJ_IDX_ERROR_Sse];
+  m_survivalLimitVersion = m_fitDataVersion;
+  m_survivalLimitSet = true;
+}
+
+// random numbers are drawn from shared generator in order of evaluation,
+// so only deterministic programs can be evaluated in parallel
+bool sgpGpFitnessFun4Regression::isParallelEvalSupported() const
+{
+  return m_deterministicRun;
+}
+
+bool sgpGpFitnessFun4Regression::isRacingActive() const
+{
+#ifdef TRACE_ENTITY_BIO
+  // tracer needs real fitness of each entity
+  return false;
+#else
+  return 
+    m_racingEnabled && m_survivalLimitSet 
+    && 
+    (m_survivalLimitVersion == m_fitDataVersion) 
+    && 
+    m_objectiveSet[FUN_REGR_OBJ_IDX_ERROR_Sse];
+#endif
+}
+
+// returns statistics of current generation
+void sgpGpFitnessFun4Regression::getRacingStats(uint &lostCount, ulong64 &savedRunCount) const
+{
+  boost::mutex::scoped_lock lock(m_calcMutex);
+  lostCount = m_raceLostCount;
+  savedRunCount = m_raceSavedRunCount;
 }
 
 void sgpGpFitnessFun4Regression::setRestartsEnabled(bool value)
@@ -262,6 +430,29 @@ void sgpGpFitnessFun4Regression::setSampleChangeInterval(uint value)
   m_sampleChangeInterval = value;
 }
 
+// Mini-batch: each generation is evaluated on a new subset of samples, 
+// sums over samples are scaled to the total number of samples. 
+// Best entities are re-scored on all samples every <fullEvalInterval> generations.
+void sgpGpFitnessFun4Regression::setMiniBatchSize(uint value)
+{
+  m_miniBatchSize = value;
+}
+
+void sgpGpFitnessFun4Regression::setMiniBatchStratified(bool value)
+{
+  m_miniBatchStratified = value;
+}
+
+void sgpGpFitnessFun4Regression::setFullEvalInterval(uint value)
+{
+  m_fullEvalInterval = value;
+}
+
+void sgpGpFitnessFun4Regression::setFullEvalEliteCount(uint value)
+{
+  m_fullEvalEliteCount = value;
+}
+
 void sgpGpFitnessFun4Regression::setSampleSide(int value)
 {
   m_sampleSide = value;
@@ -271,6 +462,18 @@ void sgpGpFitnessFun4Regression::getStats(uint &totalCalc) {
   totalCalc = m_totalCalc;
 }  
 
+void sgpGpFitnessFun4Regression::getCacheStats(ulong64 &hitCount, ulong64 &missCount) const
+{
+  hitCount = m_fitnessCache.getHitCount();
+  missCount = m_fitnessCache.getMissCount();
+}
+
+void sgpGpFitnessFun4Regression::getPrgOutputCacheStats(ulong64 &hitCount, ulong64 &missCount) const
+{
+  hitCount = m_prgOutputCache.getHitCount();
+  missCount = m_prgOutputCache.getMissCount();
+}
+
 void sgpGpFitnessFun4Regression::getObjectiveWeights(sgpWeightVector &output) const
 {
   output.resize(getObjectiveCount());
@@ -336,19 +539,85 @@ void sgpGpFitnessFun4Regression::prepare() {
   inherited::prepare();
   fillObjectiveSet();
   initInputValues();
+  // the same program gives the same fitness - if random numbers are not used
+  m_deterministicRun = !isFunctionSupported("rand.randomf") && !isFunctionSupported("rand.randomi");
 }
 
 void sgpGpFitnessFun4Regression::initProcess(sgpGaGeneration &newGeneration) {
   inherited::initProcess(newGeneration);
+  m_raceLostCount = 0;
+  m_raceSavedRunCount = 0;
 
   if (m_stepCounter == 0) {
     generateInputValues();
+    m_fitDataVersion++;
   } 
    
   if (m_sampleChangeInterval > 0)
     m_stepCounter = (m_stepCounter + 1) % m_sampleChangeInterval;    
   else 
     m_stepCounter = 1;     
+
+  if ((m_miniBatchSize > 0) && selectSampleRows(m_miniBatchSize, m_miniBatchStratified)) 
+    m_fitDataVersion++;
+}
+
+bool sgpGpFitnessFun4Regression::postProcess(sgpGaGeneration &newGeneration)
+{
+  if ((m_fullEvalInterval == 0) || (getSampleCount() >= getTotalSampleCount()))
+    return true;
+    
+  m_miniBatchStepNo++;
+  if (m_miniBatchStepNo % m_fullEvalInterval != 0)
+    return true;
+    
+  return rescoreOnAllSamples(newGeneration);
+}
+
+// evaluate best entities on all samples, so they are reported with exact fitness
+bool sgpGpFitnessFun4Regression::rescoreOnAllSamples(sgpGaGeneration &generation)
+{
+  bool res = true;
+  sgpWeightVector weights;
+  sgpEntityIndexList idList;
+  sgpFitnessValue fitness;
+  
+  if (!selectSampleRows(0, false))
+    return res;
+  m_fitDataVersion++;  
+    
+  getObjectiveWeights(weights);
+  sgpGaEvolver::getTopGenomesByWeights(generation, m_fullEvalEliteCount, weights, idList);
+  
+  for(uint i=0, epos = idList.size(); i != epos; i++) {
+    if (!calc(idList[i], &(generation.at(idList[i])), fitness))
+      res = false;
+    generation.at(idList[i]).setFitness(fitness);  
+  }  
+
+  scCounter::inc("gp-mini-batch-rescored", idList.size());
+  return res;
+}
+
+// select rows evaluated in next generation, <rowLimit> = 0 selects all rows
+// returns <false> if samples cannot be selected
+bool sgpGpFitnessFun4Regression::selectSampleRows(uint rowLimit, bool stratified)
+{
+  return false;
+}
+
+uint sgpGpFitnessFun4Regression::getTotalSampleCount() const
+{
+  return getSampleCount();
+}
+
+// scale of sums over evaluated samples to sums over all samples
+double sgpGpFitnessFun4Regression::getSampleScale() const
+{
+  uint sampleCount = getSampleCount();
+  if (sampleCount == 0)
+    return 1.0;
+  return double(getTotalSampleCount()) / double(sampleCount);
 }
 
 void sgpGpFitnessFun4Regression::invokeEntityHandled() const
@@ -364,17 +633,60 @@ void sgpGpFitnessFun4Regression::signalYield() const
 
 bool sgpGpFitnessFun4Regression::calc(uint entityIndex, const sgpEntityBase *entity, sgpFitnessValue &fitness) const
 {
+  {
+    boost::mutex::scoped_lock lock(m_calcMutex);
+    m_totalCalc++;
+  }
+
+  sgpFitnessCacheKey cacheKey;
+  bool useCache = isFitnessCacheEnabled();
+  
+  if (useCache) {
+    calcFitnessCacheKey(*entity, m_fitDataVersion, cacheKey);
+    if (m_fitnessCache.find(cacheKey, fitness))
+      return true;
+  }  
+
   fitness.resize(getObjectiveCount()); 
   scDataNode code;
   const sgpEntityForGasm *gasmEntity = checked_cast<const sgpEntityForGasm *>(entity);
   gasmEntity->getProgramCode(code);
-  bool res = evaluateProgram(*gasmEntity, code, fitness, entityIndex);
-  m_totalCalc++;
+  bool raceLost = false;
+  bool res = evaluateProgram(*gasmEntity, code, fitness, entityIndex, raceLost);
+  
+  // stop request is not cached, so it is reported each time, 
+  // fitness of entity which lost race depends on survival limit
+  if (useCache && res && !raceLost)
+    m_fitnessCache.insert(cacheKey, fitness);
+    
   return res; 
 }
 
+// predict cost of evaluation using cost of last run (inherited from parent) 
+// scaled by change of program size, for new entities - size of program only
+ulong64 sgpGpFitnessFun4Regression::predictEvalCost(const sgpEntityBase &entity) const
+{
+  const sgpEntityForGasm *gasmEntity = checked_cast<const sgpEntityForGasm *>(&entity);
+  scDataNode code;
+  sgpGasmScannerForFitPrg prgScanner;
+  
+  gasmEntity->getProgramCode(code);
+  prgScanner.setEntity(const_cast<sgpEntityForGasm *>(gasmEntity));
+  prgScanner.setCode(&code);
+  prgScanner.init();
+
+  ulong64 codeSize = prgScanner.calcProgramSize();
+  ulong64 lastCost = gasmEntity->getEvalCost();
+  ulong64 lastCodeSize = gasmEntity->getEvalCodeSize();
+  
+  if ((lastCost == 0) || (lastCodeSize == 0))
+    return codeSize * getSampleCount();
+  else  
+    return round<ulong64>(double(lastCost) * double(codeSize) / double(lastCodeSize));
+}
+
 bool sgpGpFitnessFun4Regression::evaluateProgram(const sgpEntityForGasm &info, const scDataNode &code, sgpFitnessValue &fitness, 
-  uint entityIndex
+  uint entityIndex, bool &raceLost
 ) const
 {     
 #ifdef DEBUG_FITFUN_TEST
@@ -382,34 +694,104 @@ bool sgpGpFitnessFun4Regression::evaluateProgram(const sgpEntityForGasm &info, c
 #endif  
   sgpGpEvalPrgOutput prgOutput;
 
-  prgOutput.fxVect().resize(SAMPLE_COUNT);
-  prgOutput.yVect().resize(SAMPLE_COUNT);
-  prgOutput.revFxVect().resize(SAMPLE_COUNT);
+  uint sampleCount = getSampleCount();
+
+  raceLost = false;
+  prgOutput.fxVect().resize(sampleCount);
+  // target values are read directly, without copy for each entity
+  prgOutput.yVectGuard.reset(const_cast<sgpFitDoubleVector *>(&m_targetValues), sgpNullDeleter());
+  prgOutput.revFxVect().resize(sampleCount);
 
 #ifdef DEBUG_FITFUN_TEST
   scLog::addDebug("fit-fun-e-1");
 #endif  
 
   uint revFxMacroNo = getReverseFuncMacroNo(info);
+  sgpCompiledProgramTransporter program = compileProgram(getVMachine(), code);
+  
+  // outputs depend only on effective code - offspring which differs from 
+  // parent only by introns reuses outputs of parent
+  sgpFitnessCacheKey codeKey, outputKey, checkpointKey;
+  sgpGpPrgRunOutput runOutput;
+  sgpNumericRunCheckpointsTransporter parentCheckpoints;
+  uint runSampleCount = sampleCount;
+  bool useCache = isPrgOutputCacheEnabled();
+  bool useCheckpoints = isIncrementalEvalEnabled();
+  
+  if (useCache || useCheckpoints) {
+    initFitnessCacheKey(0, codeKey);
+    addToFitnessCacheKey(program->getCode().getFullCode(), codeKey);
+  }  
+  
+  if (useCache) {
+    initFitnessCacheKey(m_fitDataVersion, outputKey);
+    addToFitnessCacheKey(static_cast<ulong64>(revFxMacroNo), outputKey);
+    addToFitnessCacheKey(codeKey.hash1, outputKey);
+    addToFitnessCacheKey(codeKey.hash2, outputKey);
+  }  
   
 #ifdef TRACE_TIME
   scTimer::start(TIMER_RUNPRG);
 #endif
   
-  runProgramForSamplesSeq(
-    code, 
-    prgOutput.fxVect(), prgOutput.yVect(), 
-    prgOutput.notNullCnt, prgOutput.totalCost, prgOutput.totalTypeDiff);
+  if (useCache && m_prgOutputCache.find(outputKey, runOutput)) {
+    runOutput.copyTo(prgOutput);
+  } else {
+    // evaluation statistics are inherited, so hash identifies code of parent
+    if (useCheckpoints) {
+      if (info.getEvalCodeHash() != 0) {
+        calcCheckpointKey(info.getEvalCodeHash(), checkpointKey);
+        m_checkpointCache.find(checkpointKey, parentCheckpoints);
+      }  
+      beginCheckpointRun(program, SGP_GASM_MAIN_BLOCK_INDEX, getSampleCount(), parentCheckpoints);
+    }  
+    
+    raceLost = !runProgramForSamplesSeq(
+      program, 
+      prgOutput.fxVect(), 
+      prgOutput.notNullCnt, prgOutput.totalCost, prgOutput.totalTypeDiff, 
+      runSampleCount);
+      
+    // checkpoints of aborted run do not cover all samples
+    if (useCheckpoints) {
+      sgpNumericRunCheckpointsTransporter checkpoints = endCheckpointRun();
+      if (!raceLost) {
+        calcCheckpointKey(codeKey.hash1, checkpointKey);
+        m_checkpointCache.insert(checkpointKey, checkpoints);
+      }  
+    }  
     
-  runProgramForRevFxInRange(        
-    0, getSampleCount() - 1, 
-    prgOutput.fxVect(), prgOutput.yVect(), prgOutput.revFxVect(), 
-    revFxMacroNo);
+    if (!raceLost) {
+      runProgramForRevFxInRange(        
+        0, getSampleCount() - 1, 
+        prgOutput.fxVect(), prgOutput.yVect(), prgOutput.revFxVect(), 
+        revFxMacroNo);
+      
+      if (useCache) {
+        runOutput.assign(prgOutput);
+        m_prgOutputCache.insert(outputKey, runOutput);
+      }  
+    }  
+  }  
+  
+  // after lost race offspring resume from checkpoints of ancestor
+  if (useCheckpoints && !raceLost)
+    const_cast<sgpEntityForGasm &>(info).setEvalCodeHash(codeKey.hash1);
 
 #ifdef TRACE_TIME
   scTimer::stop(TIMER_RUNPRG);
 #endif
 
+  // rate output of executed samples only
+  if (raceLost) {
+    prgOutput.fxVect().resize(runSampleCount);
+    prgOutput.yVectGuard.reset(new sgpFitDoubleVector());
+    prgOutput.yVect().resize(runSampleCount);
+    for(uint i = 0; i != runSampleCount; i++)
+      prgOutput.yVect()[i] = m_targetValues[i];
+    prgOutput.revFxVect().resize(runSampleCount);
+  }  
+
 #ifdef DEBUG_FITFUN_TEST
   scLog::addDebug("fit-fun-e-2");
 #endif  
@@ -438,7 +820,7 @@ void sgpGpFitnessFun4Regression::runProgramForRevFxInRange(
   double y;
   const double DEF_REV_FX_VALUE = 0.0;
   scDataNode revInput, revOutput;
-  uint blockCount = m_vmachine->blockGetCount();  
+  uint blockCount = getVMachine().blockGetCount();  
   bool revFxEnabled = (revFxMacroNo != REV_FX_NULL_MACRO_NO) && (revFxMacroNo < blockCount);
   
   revInput.clear();
@@ -467,26 +849,19 @@ bool sgpGpFitnessFun4Regression::rateProgram(uint entityIndex, const sgpEntityFo
 {  
   _TRCSTEP_;
   bool res = true;
-  double errorSse;
-  double errorSseAbs;
-  double errorStdDev = 0.0;
-  double errorSum;
-  scDataNode input, output;    
-  sgpFitDoubleVector errors(SAMPLE_COUNT);    
+  sgpGpOutputStats outputStats;
   const sgpFitDoubleVector &fxVect = prgOutput.fxVect();    
   const sgpFitDoubleVector &yVect = prgOutput.yVect();    
-  const sgpFitDoubleVector &revFxVect = prgOutput.revFxVect();    
-  long64 totalCost = prgOutput.totalCost;
-  uint countNotNullOutput = prgOutput.notNullCnt;
-  long64 totalTypeDiff = prgOutput.totalTypeDiff;
-  uint hitCount = 0;
+  uint sampleCount = fxVect.size();
+  // entity lost race - output of first samples only
+  bool partialOutput = (sampleCount < getSampleCount());
   
   _TRCSTEP_;
   // calculate statistics
-  calcOutputStats(fxVect, yVect, errorSse, errorSseAbs, errorSum, hitCount, errors);  
+  calcOutputStats(fxVect, yVect, outputStats);  
   _TRCSTEP_;
 
-  if (hitCount == SAMPLE_COUNT) {
+  if (!partialOutput && (outputStats.hitCount == sampleCount)) {
 #ifdef COUT_ENABLED  
     cout << "--> 100% hit found! " << endl;
 #endif    
@@ -495,9 +870,6 @@ bool sgpGpFitnessFun4Regression::rateProgram(uint entityIndex, const sgpEntityFo
 #endif    
   }
 
-  sgpGaGenome genome;
-  sgpGaGenomeMetaList codeMeta;
-
   sgpGasmScannerForFitPrg prgScanner;
   sgpGasmScannerForFitBlock blockScanner;
 
@@ -505,315 +877,559 @@ bool sgpGpFitnessFun4Regression::rateProgram(uint entityIndex, const sgpEntityFo
   prgScanner.setCode(const_cast<scDataNode *>(&code));
   prgScanner.init();
 
-  blockScanner.setFunctions(const_cast<sgpFunctionMapColn *>(&m_functions));
-  blockScanner.scanFirstBlockCode(info, code);
-  blockScanner.init();
-
   ulong64 stepSize = prgScanner.calcProgramSize();
-  scCounter::inc("gp-prg-size-step", stepSize);
-  scCounter::inc("gx-workload-step", stepSize * SAMPLE_COUNT);
+  ulong64 evalCost = static_cast<ulong64>(prgOutput.totalCost);
+  if (partialOutput)
+    evalCost = round<ulong64>(double(evalCost) * double(getSampleCount()) / double(sampleCount));
+  // used for prediction of evaluation cost of offspring
+  const_cast<sgpEntityForGasm &>(info).setEvalStats(evalCost, stepSize);
+  {
+    boost::mutex::scoped_lock lock(m_calcMutex);
+    scCounter::inc("gp-prg-size-step", stepSize);
+    scCounter::inc("gx-workload-step", stepSize * sampleCount);
+  }
 
-//TODO: scan all blocks of code if jumping to other blocks is possible (set_next_block, call)    
-  double fxStdDev;
+  sgpRegrObjContext context;
   
-  //fxStdDev = calcStdDev(fxVect);
-  fxStdDev = std_dev(fxVect.begin(), fxVect.end(), 0.0);
-  
-  uint fxDistinctCnt = calcDistinctCount(fxVect);
-  double constToAllArgRatio = blockScanner.calcConstantToArgRatio(m_minConstToArgRatio);       
-
-  sgpVMachine &vmachine = *m_vmachine;
-
-  double regDistRead = 
-    blockScanner.calcRegDistance(SGP_REGB_INPUT, SGP_REGB_INPUT + getInputArgCount() - 1, SGP_MAX_REG_NO + 1, gatfInput, vmachine);
+  context.info = &info;
+  context.code = &code;
+  context.prgOutput = &prgOutput;
+  context.outputStats = &outputStats;
+  context.prgScanner = &prgScanner;
+  context.blockScanner = &blockScanner;
+  context.vmachine = &getVMachine();
+  context.sampleCount = sampleCount;
+  // mini-batch, lost race: sums estimated for all samples
+  context.sampleScale = getSampleScale();
+  if (partialOutput)
+    context.sampleScale *= double(getSampleCount()) / double(sampleCount);
+  context.stepSize = stepSize;
+  context.readyDeps = 0;
+
+  // only enabled objectives are calculated, together with their dependencies
+  for(uint i=0, epos = m_objEvaluators.size(); i != epos; i++) {
+    const sgpRegrObjEvaluator &evaluator = m_objEvaluators[i];
+    if (evaluator.objIndex >= fitness.size())
+      continue;
+      
+    if (!m_objectiveSet[evaluator.objIndex]) {
+      fitness[evaluator.objIndex] = 1.0;
+      continue;
+    }  
 
-  double regDistWrite = 
-    blockScanner.calcRegDistance(SGP_REGB_OUTPUT, SGP_REGB_OUTPUT, SGP_MAX_REG_NO + 1, gatfOutput, vmachine);
+    prepareObjDependencies(evaluator.dependencies, context);
+#ifdef TRACE_TIME
+    scTimer::start(evaluator.timerName);
+#endif
+    if (partialOutput && (evaluator.dependencies & SGP_REGR_OBJ_DEP_ALL_SAMPLES)) {
+      // output of remaining samples is unknown
+      bool constOutput = context.constOutput;
+      context.constOutput = true;
+      fitness[evaluator.objIndex] = (this->*(evaluator.method))(context);
+      context.constOutput = constOutput;
+    } else {  
+      fitness[evaluator.objIndex] = (this->*(evaluator.method))(context);
+    }  
+#ifdef TRACE_TIME
+    scTimer::stop(evaluator.timerName);
+#endif
+  }
+    
+  _TRCSTEP_;
 
-  bool constOutput;
-  double variableOutputRating;
+#ifdef TRACE_ENTITY_BIO
+  if (entityIndex != UINT_MAX) {
+    sgpEntityTracer::handleEntityEvaluated(entityIndex, fitness, info);
+    sgpEntityTracer::handleSetEntityClass(entityIndex, 
+      calcEntityClassForTargetFuncNI1O(fxVect, yVect));
+  } 
+#endif
+  
+  return res;
+}
 
-  calcOutputVarRating(countNotNullOutput, fxDistinctCnt, fxStdDev, constToAllArgRatio, 
-    regDistRead, regDistWrite, variableOutputRating, constOutput);
+// ----------------------------------------------------------------------------
+// objective evaluators
+// ----------------------------------------------------------------------------
+void sgpGpFitnessFun4Regression::initObjEvaluators()
+{
+  const uint depNone = 0;
+  const uint depBlock = SGP_REGR_OBJ_DEP_BLOCK_SCAN;
+  const uint depVar = SGP_REGR_OBJ_DEP_OUTPUT_VAR;
+  const uint depAll = SGP_REGR_OBJ_DEP_ALL_SAMPLES;
   
-  if (constOutput) {    
-    errorSse = CONST_OUT_ERROR_SSE;
-    errorSseAbs = CONST_OUT_ERROR_SSE_ABS;
-  }  
+  m_objEvaluators.clear();
   
-  if (constOutput)
-    errorStdDev = CONST_OUT_ERROR_STD_DEV;
-  else  
-    errorStdDev = std_dev(errors.begin(), errors.end(), 0.0);
-
-  double revFxObj;
-  if (constOutput || !m_objectiveSet[FUN_REGR_OBJ_IDX_ERROR_RevFx]) {
-    revFxObj = CONST_OUT_REV_FX * getSampleCount();
-  } else { 
-    revFxObj = calcReverseFuncObj(info, fxVect, yVect, revFxVect);  
-  }  
-
-  double regIoDist;
-  if (constOutput || !m_objectiveSet[FUN_REGR_OBJ_IDX_ERROR_RegIoDist]) {
-    regIoDist = CONST_OUT_REG_IO_DIST;
-  } else { 
-    regIoDist = blockScanner.calcRegIoDist();  
-  }  
-
-  _TRCSTEP_;
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_Sse, &sgpGpFitnessFun4Regression::calcObjSse, depVar | depAll, "sse");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_StdDev, &sgpGpFitnessFun4Regression::calcObjStdDev, depVar, "std-dev");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_RegDistRead, &sgpGpFitnessFun4Regression::calcObjRegDistRead, depVar, "reg-dist-read");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_RegDistWrite, &sgpGpFitnessFun4Regression::calcObjRegDistWrite, depVar, "reg-dist-write");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_RegDist, &sgpGpFitnessFun4Regression::calcObjRegDist, depBlock, "reg-dist");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_VarLevel, &sgpGpFitnessFun4Regression::calcObjVarLevel, depVar, "var-level");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_TypeDiff, &sgpGpFitnessFun4Regression::calcObjTypeDiff, depNone, "type-diff");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_TotalCost, &sgpGpFitnessFun4Regression::calcObjTotalCost, depVar, "total-cost");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_ProgramSize, &sgpGpFitnessFun4Regression::calcObjProgramSize, depVar, "prg-size");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_FailedWrites, &sgpGpFitnessFun4Regression::calcObjFailedWrites, depVar, "failed-writes");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_FailedReads, &sgpGpFitnessFun4Regression::calcObjFailedReads, depBlock, "failed-reads");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_WriteToInput, &sgpGpFitnessFun4Regression::calcObjWriteToInput, depBlock, "write-to-input");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_UniqInstrCodeRatio, &sgpGpFitnessFun4Regression::calcObjUniqInstrCodeRatio, depBlock, "uniq-instr-codes");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_MaxInstrSeq, &sgpGpFitnessFun4Regression::calcObjMaxInstrSeq, depBlock, "max-instr-seq");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_RelHitCount, &sgpGpFitnessFun4Regression::calcObjRelHitCount, depNone, "rel-hit-count");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_DistanceToEndOfLastWrite, &sgpGpFitnessFun4Regression::calcObjDistanceToEndOfLastWrite, depBlock, "dist-to-end");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_ConstToArgRatio, &sgpGpFitnessFun4Regression::calcObjConstToArgRatio, depVar, "const-to-arg");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_ConstOnlyArgInstrToTotal, &sgpGpFitnessFun4Regression::calcObjConstOnlyArgInstrToTotal, depBlock, "const-only-instr");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_StdDevDiffDfx, &sgpGpFitnessFun4Regression::calcObjStdDevDiffDfx, depVar | depAll, "std-dev-dfx");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_StdDevDiffD2fx, &sgpGpFitnessFun4Regression::calcObjStdDevDiffD2fx, depVar | depAll, "std-dev-d2fx");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_WriteToOutToTotalWriteCnt, &sgpGpFitnessFun4Regression::calcObjWriteToOutToTotalWriteCnt, depBlock, "write-to-out");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_OutCorrel, &sgpGpFitnessFun4Regression::calcObjOutCorrel, depVar, "out-correl");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_FadingMaOutDiff, &sgpGpFitnessFun4Regression::calcObjFadingMaOutDiff, depVar | depAll, "fading-ma");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_ExtremaRelError, &sgpGpFitnessFun4Regression::calcObjExtremaRelError, depVar | depAll, "extrema");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_ErrorSseAbs, &sgpGpFitnessFun4Regression::calcObjErrorSseAbs, depVar, "sse-abs");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_FreqDiff, &sgpGpFitnessFun4Regression::calcObjFreqDiff, depVar | depAll, "freq-diff");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_AmpliDiff, &sgpGpFitnessFun4Regression::calcObjAmpliDiff, depVar | depAll, "ampli-diff");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_RevFx, &sgpGpFitnessFun4Regression::calcObjRevFx, depVar | depAll, "rev-fx");
+  registerObjEvaluator(FUN_REGR_OBJ_IDX_ERROR_RegIoDist, &sgpGpFitnessFun4Regression::calcObjRegIoDist, depVar, "reg-io-dist");
+}
 
-  double regDist1 = (
-    blockScanner.calcRegDistance(SGP_REGB_INPUT, SGP_REGB_INPUT + getInputArgCount() - 1, SGP_MAX_REG_NO + 1, gatfAnyIo, vmachine)
-    +
-    blockScanner.calcRegDistance(SGP_REGB_OUTPUT, SGP_REGB_OUTPUT, SGP_MAX_REG_NO + 1, gatfAnyIo, vmachine)
-  );
-        
-  double failedWrites;
+// add evaluator of objective, evaluator registered before for the same objective is replaced
+void sgpGpFitnessFun4Regression::registerObjEvaluator(uint objIndex, sgpRegrObjEvalMethod method, uint dependencies, 
+  const scString &name)
+{
+  sgpRegrObjEvaluator evaluator;
   
-  if (constOutput)
-    failedWrites = CONST_OUT_FAILED_WRITES;
-  else  
-    failedWrites = blockScanner.calcWritesNotUsed(SGP_MAX_REG_NO + 1, MIN_FAILED_WRITES);
+  evaluator.objIndex = objIndex;
+  evaluator.method = method;
+  evaluator.dependencies = dependencies;
+  evaluator.timerName = scString("gp-obj-") + name;
   
-  failedWrites = sqrt(failedWrites);  
+  for(uint i=0, epos = m_objEvaluators.size(); i != epos; i++)
+    if (m_objEvaluators[i].objIndex == objIndex) {
+      m_objEvaluators[i] = evaluator;
+      return;
+    }
     
-  double failedReads = 
-    blockScanner.calcUninitializedReads(SGP_MAX_REG_NO + 1, SGP_REGB_INPUT, SGP_REGB_INPUT + getInputArgCount() - 1);
+  m_objEvaluators.push_back(evaluator);
+}
 
-  double writesToInput = 
-    blockScanner.calcWritesToInput(SGP_MAX_REG_NO + 1, SGP_REGB_INPUT, SGP_REGB_INPUT + getInputArgCount() - 1);
+// calculate values shared by objectives, each of them only once per entity
+void sgpGpFitnessFun4Regression::prepareObjDependencies(uint dependencies, sgpRegrObjContext &context) const
+{
+  if (dependencies & SGP_REGR_OBJ_DEP_OUTPUT_VAR)
+    dependencies |= SGP_REGR_OBJ_DEP_BLOCK_SCAN;
     
-  double writesToOutput =
-    blockScanner.calcWritesToOutput(SGP_MAX_REG_NO + 1, SGP_REGB_OUTPUT, SGP_REGB_OUTPUT);  
+  uint missing = dependencies & ~context.readyDeps;
+  
+  if (missing & SGP_REGR_OBJ_DEP_BLOCK_SCAN) {
+#ifdef TRACE_TIME
+    scTimer::start(TIMER_OBJ_DEP_BLOCK_SCAN);
+#endif
+    context.blockScanner->setFunctions(const_cast<sgpFunctionMapColn *>(&m_functions));
+    context.blockScanner->scanFirstBlockCode(*context.info, *context.code);
+    context.blockScanner->init();
+    context.readyDeps |= SGP_REGR_OBJ_DEP_BLOCK_SCAN;
+#ifdef TRACE_TIME
+    scTimer::stop(TIMER_OBJ_DEP_BLOCK_SCAN);
+#endif
+  }  
 
-  double outputDistToEnd =
-    blockScanner.calcOutputDistanceToEnd(SGP_MAX_REG_NO + 1, SGP_REGB_OUTPUT, SGP_REGB_OUTPUT, MIN_OUT_DIST_TO_END);  
+//TODO: scan all blocks of code if jumping to other blocks is possible (set_next_block, call)    
+  if (missing & SGP_REGR_OBJ_DEP_OUTPUT_VAR) {
+#ifdef TRACE_TIME
+    scTimer::start(TIMER_OBJ_DEP_OUTPUT_VAR);
+#endif
+    sgpGasmScannerForFitBlock &blockScanner = *context.blockScanner;
     
-  double uniqueInstrCodesRatio = 
-    blockScanner.calcUniqueInstrCodes(m_maxReqUniqInstrCodeRatio);        
+    context.constToAllArgRatio = blockScanner.calcConstantToArgRatio(m_minConstToArgRatio);       
 
-  double sameInstrCodeRatio = 
-    blockScanner.calcSameInstrCodeRatio();  
+    context.regDistRead = 
+      blockScanner.calcRegDistance(SGP_REGB_INPUT, SGP_REGB_INPUT + getInputArgCount() - 1, SGP_MAX_REG_NO + 1, gatfInput, *context.vmachine);
 
-  _TRCSTEP_;
+    context.regDistWrite = 
+      blockScanner.calcRegDistance(SGP_REGB_OUTPUT, SGP_REGB_OUTPUT, SGP_MAX_REG_NO + 1, gatfOutput, *context.vmachine);
 
-  // calc number of extreme values
-  double extremeCntRel;
-  
-  if (constOutput || (!m_objectiveSet[FUN_REGR_OBJ_IDX_ERROR_ExtremaRelError]))
-    extremeCntRel = CONST_OUT_EXTREME_REL;    
-  else
-    extremeCntRel =     
-    relativeErrorMinMax<double>(
-      static_cast<double>(m_objCacheExtremeCount),
-      static_cast<double>(countExtremeValuesWithNoiseFilter(fxVect, EXREME_NOISE_FILTER_STEP))
-    );  
-    
-  // calc error on derive level 1 = stdDev(sub(dfx(i) - dy(i))
-  double stdErrorDerive1;
-  
-  if (constOutput || !m_objectiveSet[FUN_REGR_OBJ_IDX_ERROR_StdDevDiffDfx])
-    stdErrorDerive1 = CONST_OUT_ERROR_STD_DEV;
-  else  
-    stdErrorDerive1 = calcStdErrorDeriveNForTargetFuncNI1O(yVect, fxVect, 1);
+    calcOutputVarRating(context.sampleCount, context.prgOutput->notNullCnt, context.outputStats->fxDistinctCnt, context.outputStats->fxStdDev, 
+      context.constToAllArgRatio, context.regDistRead, context.regDistWrite, 
+      context.variableOutputRating, context.constOutput);
       
-  // calcStdErrorDeriveN(m_inputValues, yVect, fxVect, 1);
-  
-  // calc error on derive level 2 = stdDev(sub(d2fx(i) - d2y(i))
-  double stdErrorDerive2;
-  
-  if (constOutput || !m_objectiveSet[FUN_REGR_OBJ_IDX_ERROR_StdDevDiffD2fx])
-    stdErrorDerive2 = CONST_OUT_ERROR_STD_DEV;
-  else  
-    stdErrorDerive2 = calcStdErrorDeriveNForTargetFuncNI1O(yVect, fxVect, 2);
+    context.readyDeps |= SGP_REGR_OBJ_DEP_OUTPUT_VAR;
+#ifdef TRACE_TIME
+    scTimer::stop(TIMER_OBJ_DEP_OUTPUT_VAR);
+#endif
+  }
+}
 
-  double correlYNFx;
-  
-  if (constOutput)
-    correlYNFx = CONST_OUT_CORREL;
-  else
-    correlYNFx = 2.0+calcCorrel(yVect, fxVect);
-  
-  double constOnlyInstrRatio = blockScanner.calcConstOnlyInstr(MIN_CONST_ONLY_INSTR_RATIO);
-  
-//  double foundRegs = calcUsedRegs(info, code, genome, codeMeta, 
-//    SGP_MAX_REG_NO + 1, SGP_REGB_INPUT, SGP_REGB_INPUT + m_inputArgCount - 1);
+double sgpGpFitnessFun4Regression::calcObjSse(sgpRegrObjContext &context) const
+{
+  if (context.constOutput)
+    return -CONST_OUT_ERROR_SSE;
+  return -(context.outputStats->errorSse * context.sampleScale);
+}
 
-  long64 totalSizeRawL = stepSize; //calcProgramSize(code);      
-  double totalSize;
-  
-  if (constOutput)
-    totalSize = CONST_OUT_SIZE;
-  else {  
-    ulong64 totalSizeL = calcProgramSizeScore(info, &prgScanner);  
-    totalSize = std::fabs(log10(double(10+totalSizeL)));
-  }  
+double sgpGpFitnessFun4Regression::calcObjStdDev(sgpRegrObjContext &context) const
+{
+  if (context.constOutput)
+    return -CONST_OUT_ERROR_STD_DEV;
+  return -std::fabs(context.outputStats->errorStdDev);
+}
 
-  double fadingMaDiff;
-  
-  if (constOutput || (!m_objectiveSet[FUN_REGR_OBJ_IDX_ERROR_FadingMaOutDiff]))
-    fadingMaDiff = CONST_OUT_FADING_DIFF;
-  else  
-    fadingMaDiff = calcFadingMaDiff(yVect, fxVect);
-  
-  double freqDiff;
-  
-  if (constOutput || !m_objectiveSet[FUN_REGR_OBJ_IDX_ERROR_FreqDiff])
-    freqDiff = CONST_OUT_FREQ_DIFF;
-  else
-    //freqDiff = calcFreqDiff(yVect, fxVect);
-    freqDiff = calcFreqDiffPrepared(m_objCacheFreqY, fxVect);
-    
-  double ampliDiff;
-  
-  if (constOutput || !m_objectiveSet[FUN_REGR_OBJ_IDX_ERROR_AmpliDiff])
-    ampliDiff = CONST_OUT_AMPLI_DIFF;
-  else
-    //ampliDiff = calcAmplitudeDiff(yVect, fxVect);
-    ampliDiff = calcAmplitudeDiffPrepared(m_objCacheAmpliY, fxVect);
-    
-  //double incDiff = NULL_INC_DIFF; //calcIncreasesDiff(yVect, fxVect);
-  
-  double totalCostD;
+double sgpGpFitnessFun4Regression::calcObjRegDistRead(sgpRegrObjContext &context) const
+{
+  return -context.regDistRead;
+}
 
-  if (constOutput)
-    totalCostD = CONST_OUT_CODE_COST;  
-  else
-    totalCostD = std::fabs(log10(10.0 + (double(totalCost) / double(totalSizeRawL))));
-             
-  _TRCSTEP_;
-  fitness[FUN_REGR_OBJ_IDX_ERROR_Sse] = -errorSse; 
+double sgpGpFitnessFun4Regression::calcObjRegDistWrite(sgpRegrObjContext &context) const
+{
+  return -context.regDistWrite;
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_StdDev] = -std::fabs(errorStdDev);
+double sgpGpFitnessFun4Regression::calcObjRegDist(sgpRegrObjContext &context) const
+{
+  double regDist1 = (
+    context.blockScanner->calcRegDistance(SGP_REGB_INPUT, SGP_REGB_INPUT + getInputArgCount() - 1, SGP_MAX_REG_NO + 1, gatfAnyIo, *context.vmachine)
+    +
+    context.blockScanner->calcRegDistance(SGP_REGB_OUTPUT, SGP_REGB_OUTPUT, SGP_MAX_REG_NO + 1, gatfAnyIo, *context.vmachine)
+  );
+  return -regDist1;
+}
+
+double sgpGpFitnessFun4Regression::calcObjVarLevel(sgpRegrObjContext &context) const
+{
+  return context.variableOutputRating;
+}
+
+double sgpGpFitnessFun4Regression::calcObjTypeDiff(sgpRegrObjContext &context) const
+{
+  return -std::fabs(double(context.prgOutput->totalTypeDiff) * context.sampleScale);
+}
+
+double sgpGpFitnessFun4Regression::calcObjTotalCost(sgpRegrObjContext &context) const
+{
+  if (context.constOutput)
+    return -CONST_OUT_CODE_COST;
+  return -std::fabs(log10(10.0 + (double(context.prgOutput->totalCost) * context.sampleScale / double(context.stepSize))));
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_RegDistRead] = -regDistRead;
+double sgpGpFitnessFun4Regression::calcObjProgramSize(sgpRegrObjContext &context) const
+{
+  if (context.constOutput)
+    return -CONST_OUT_SIZE;
+  ulong64 totalSizeL = calcProgramSizeScore(*context.info, context.prgScanner);  
+  return -std::fabs(log10(double(10+totalSizeL)));
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_RegDistWrite] = -regDistWrite;
+double sgpGpFitnessFun4Regression::calcObjFailedWrites(sgpRegrObjContext &context) const
+{
+  double failedWrites;
+  
+  if (context.constOutput)
+    failedWrites = CONST_OUT_FAILED_WRITES;
+  else  
+    failedWrites = context.blockScanner->calcWritesNotUsed(SGP_MAX_REG_NO + 1, MIN_FAILED_WRITES);
+  
+  return -sqrt(failedWrites);  
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_RegDist] = -regDist1;
+double sgpGpFitnessFun4Regression::calcObjFailedReads(sgpRegrObjContext &context) const
+{
+  return -context.blockScanner->calcUninitializedReads(SGP_MAX_REG_NO + 1, SGP_REGB_INPUT, SGP_REGB_INPUT + getInputArgCount() - 1);
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_VarLevel] = variableOutputRating;
+double sgpGpFitnessFun4Regression::calcObjWriteToInput(sgpRegrObjContext &context) const
+{
+  return -context.blockScanner->calcWritesToInput(SGP_MAX_REG_NO + 1, SGP_REGB_INPUT, SGP_REGB_INPUT + getInputArgCount() - 1);
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_TypeDiff] = -std::fabs(double(totalTypeDiff));
+double sgpGpFitnessFun4Regression::calcObjUniqInstrCodeRatio(sgpRegrObjContext &context) const
+{
+  return context.blockScanner->calcUniqueInstrCodes(m_maxReqUniqInstrCodeRatio);        
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_TotalCost] = -totalCostD;
+double sgpGpFitnessFun4Regression::calcObjMaxInstrSeq(sgpRegrObjContext &context) const
+{
+  return context.blockScanner->calcSameInstrCodeRatio();  
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_ProgramSize] = -totalSize;
+double sgpGpFitnessFun4Regression::calcObjRelHitCount(sgpRegrObjContext &context) const
+{
+  return double(context.outputStats->hitCount)/double(context.sampleCount);
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_FailedWrites] = -failedWrites;
+double sgpGpFitnessFun4Regression::calcObjDistanceToEndOfLastWrite(sgpRegrObjContext &context) const
+{
+  return -context.blockScanner->calcOutputDistanceToEnd(SGP_MAX_REG_NO + 1, SGP_REGB_OUTPUT, SGP_REGB_OUTPUT, MIN_OUT_DIST_TO_END);  
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_FailedReads] = -failedReads;
+double sgpGpFitnessFun4Regression::calcObjConstToArgRatio(sgpRegrObjContext &context) const
+{
+  return -context.constToAllArgRatio;
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_WriteToInput] = -writesToInput;
+double sgpGpFitnessFun4Regression::calcObjConstOnlyArgInstrToTotal(sgpRegrObjContext &context) const
+{
+  return -context.blockScanner->calcConstOnlyInstr(MIN_CONST_ONLY_INSTR_RATIO);
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_UniqInstrCodeRatio] = uniqueInstrCodesRatio;    
+// error on derive level 1 = stdDev(sub(dfx(i) - dy(i))
+double sgpGpFitnessFun4Regression::calcObjStdDevDiffDfx(sgpRegrObjContext &context) const
+{
+  double stdErrorDerive1;
+  
+  if (context.constOutput)
+    stdErrorDerive1 = CONST_OUT_ERROR_STD_DEV;
+  else  
+    stdErrorDerive1 = calcStdErrorDeriveNForTargetFuncNI1O(context.prgOutput->yVect(), context.prgOutput->fxVect(), 1);
+    
+  return -std::fabs(log10(double(10.0+stdErrorDerive1)));
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_MaxInstrSeq] = sameInstrCodeRatio;
+// error on derive level 2 = stdDev(sub(d2fx(i) - d2y(i))
+double sgpGpFitnessFun4Regression::calcObjStdDevDiffD2fx(sgpRegrObjContext &context) const
+{
+  double stdErrorDerive2;
+  
+  if (context.constOutput)
+    stdErrorDerive2 = CONST_OUT_ERROR_STD_DEV;
+  else  
+    stdErrorDerive2 = calcStdErrorDeriveNForTargetFuncNI1O(context.prgOutput->yVect(), context.prgOutput->fxVect(), 2);
+    
+  return -std::fabs(log10(double(10.0+stdErrorDerive2)));
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_RelHitCount] = double(hitCount)/double(SAMPLE_COUNT); //was fxStdDev;
+double sgpGpFitnessFun4Regression::calcObjWriteToOutToTotalWriteCnt(sgpRegrObjContext &context) const
+{
+  return -context.blockScanner->calcWritesToOutput(SGP_MAX_REG_NO + 1, SGP_REGB_OUTPUT, SGP_REGB_OUTPUT);  
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_DistanceToEndOfLastWrite] = -outputDistToEnd;
+double sgpGpFitnessFun4Regression::calcObjOutCorrel(sgpRegrObjContext &context) const
+{
+  if (context.constOutput)
+    return CONST_OUT_CORREL;
+  return 2.0+context.outputStats->correlYFx;
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_ConstToArgRatio] = -constToAllArgRatio;
+double sgpGpFitnessFun4Regression::calcObjFadingMaOutDiff(sgpRegrObjContext &context) const
+{
+  if (context.constOutput)
+    return -CONST_OUT_FADING_DIFF;
+  return -calcFadingMaDiff(context.prgOutput->yVect(), context.prgOutput->fxVect());
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_ConstOnlyArgInstrToTotal] = -constOnlyInstrRatio;
+// relative error of number of extreme values
+double sgpGpFitnessFun4Regression::calcObjExtremaRelError(sgpRegrObjContext &context) const
+{
+  double extremeCntRel;
   
-  fitness[FUN_REGR_OBJ_IDX_ERROR_StdDevDiffDfx] = -std::fabs(log10(double(10.0+
-      stdErrorDerive1
-  )));
-    
-  fitness[FUN_REGR_OBJ_IDX_ERROR_StdDevDiffD2fx] = -std::fabs(log10(double(10.0+
-      stdErrorDerive2
-  )));
-    
-  fitness[FUN_REGR_OBJ_IDX_ERROR_WriteToOutToTotalWriteCnt] = -writesToOutput; //was (-foundRegs)
+  if (context.constOutput)
+    extremeCntRel = CONST_OUT_EXTREME_REL;    
+  else
+    extremeCntRel =     
+    relativeErrorMinMax<double>(
+      static_cast<double>(m_objCacheExtremeCount),
+      static_cast<double>(countExtremeValuesWithNoiseFilter(context.prgOutput->fxVect(), EXREME_NOISE_FILTER_STEP))
+    );  
     
-  fitness[FUN_REGR_OBJ_IDX_ERROR_OutCorrel] = correlYNFx;
+  return -(1.0 + extremeCntRel);  
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_FadingMaOutDiff] = -fadingMaDiff;
-    
-  fitness[FUN_REGR_OBJ_IDX_ERROR_ExtremaRelError] = -(1.0 + extremeCntRel);  
+double sgpGpFitnessFun4Regression::calcObjErrorSseAbs(sgpRegrObjContext &context) const
+{
+  if (context.constOutput)
+    return -CONST_OUT_ERROR_SSE_ABS;
+  return -(context.outputStats->errorSseAbs * context.sampleScale);
+}
+
+double sgpGpFitnessFun4Regression::calcObjFreqDiff(sgpRegrObjContext &context) const
+{
+  double freqDiff;
+  
+  if (context.constOutput)
+    freqDiff = CONST_OUT_FREQ_DIFF;
+  else
+    freqDiff = calcFreqDiffPrepared(m_objCacheFreqY, context.prgOutput->fxVect());
     
-  fitness[FUN_REGR_OBJ_IDX_ERROR_ErrorSseAbs] = -errorSseAbs;
+  return -(1.0 + freqDiff);
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_FreqDiff] = -(1.0 + freqDiff);
+double sgpGpFitnessFun4Regression::calcObjAmpliDiff(sgpRegrObjContext &context) const
+{
+  double ampliDiff;
+  
+  if (context.constOutput)
+    ampliDiff = CONST_OUT_AMPLI_DIFF;
+  else
+    ampliDiff = calcAmplitudeDiffPrepared(m_objCacheAmpliY, context.prgOutput->fxVect());
     
-  fitness[FUN_REGR_OBJ_IDX_ERROR_AmpliDiff] = -(1.0 + ampliDiff);
+  return -(1.0 + ampliDiff);
+}
 
-  fitness[FUN_REGR_OBJ_IDX_ERROR_RevFx] = -(1.0 + revFxObj);  
+double sgpGpFitnessFun4Regression::calcObjRevFx(sgpRegrObjContext &context) const
+{
+  double revFxObj;
   
-  fitness[FUN_REGR_OBJ_IDX_ERROR_RegIoDist] = 1.0 + regIoDist;
+  if (context.constOutput) {
+    revFxObj = CONST_OUT_REV_FX * context.sampleCount;
+  } else { 
+    revFxObj = calcReverseFuncObj(*context.info, 
+      context.prgOutput->fxVect(), context.prgOutput->yVect(), context.prgOutput->revFxVect());  
+  }  
   
-  //fitness[28] = -(1.0 + incDiff);
-
-  for (uint i=1, epos = getObjectiveCount(); i < epos; i++)
-    if (!m_objectiveSet[i])
-      fitness[i] = 1.0;
-    
-  _TRCSTEP_;
+  return -(1.0 + revFxObj * context.sampleScale);  
+}
 
-#ifdef TRACE_ENTITY_BIO
-  if (entityIndex != UINT_MAX) {
-    sgpEntityTracer::handleEntityEvaluated(entityIndex, fitness, info);
-    sgpEntityTracer::handleSetEntityClass(entityIndex, 
-      calcEntityClassForTargetFuncNI1O(fxVect, yVect));
-  } 
-#endif
+double sgpGpFitnessFun4Regression::calcObjRegIoDist(sgpRegrObjContext &context) const
+{
+  double regIoDist;
   
-  return res;
+  if (context.constOutput) {
+    regIoDist = CONST_OUT_REG_IO_DIST;
+  } else { 
+    regIoDist = context.blockScanner->calcRegIoDist();  
+  }  
+  
+  return 1.0 + regIoDist;
 }
 
 void sgpGpFitnessFun4Regression::handleProgramOutput(const sgpEntityForGasm &workInfo, const sgpGpEvalPrgOutput &prgOutput) const
 {
-  if (m_onHandleProgramOutput != SC_NULL)
+  if (m_onHandleProgramOutput != SC_NULL) {
+    boost::mutex::scoped_lock lock(m_calcMutex);
     m_onHandleProgramOutput->execute(workInfo, prgOutput);
+  }
 }
 
-void sgpGpFitnessFun4Regression::runProgramForSamplesSeq(
-  const scDataNode &code,
-  sgpFitDoubleVector &fxVect, sgpFitDoubleVector &yVect, 
-  uint &notNullCnt, long64 &totalCost, long64 &totalTypeDiff) const
+// returns <false> if run was stopped because entity lost race, 
+// <runSampleCount> - number of executed samples
+bool sgpGpFitnessFun4Regression::runProgramForSamplesSeq(
+  const sgpCompiledProgramTransporter &program,
+  sgpFitDoubleVector &fxVect, 
+  uint &notNullCnt, long64 &totalCost, long64 &totalTypeDiff, 
+  uint &runSampleCount) const
 {
-  setVMachineProgram(*m_vmachine, code);
+  uint sampleCount = getSampleCount();
+
+  getVMachine().setCompiledProgram(program);
+  runSampleCount = sampleCount;
+  
+  if (!isRacingActive()) {
+    runProgramForSamplesInRange(0, sampleCount - 1, 
+      fxVect, 
+      notNullCnt, totalCost, totalTypeDiff);
+    return true;
+  }
+    
+  uint chunkNotNullCnt;
+  long64 chunkCost, chunkTypeDiff;
+  double partialSse = 0.0;
+  double sampleScale = getSampleScale();
+  
+  notNullCnt = 0;
+  totalCost = 0;
+  totalTypeDiff = 0;
+  
+  for(uint first = 0; first < sampleCount; first += SGP_RACE_CHUNK_SIZE) {
+    uint last = std::min<uint>(first + SGP_RACE_CHUNK_SIZE, sampleCount) - 1;
+    
+    runProgramForSamplesInRange(first, last, 
+      fxVect, 
+      chunkNotNullCnt, chunkCost, chunkTypeDiff);
+      
+    notNullCnt += chunkNotNullCnt;
+    totalCost += chunkCost;
+    totalTypeDiff += chunkTypeDiff;
+    
+    // SSE cannot decrease with next samples
+    for(uint i = first; i <= last; i++)
+      partialSse += calcSampleErrorForSse(fxVect[i], m_targetValues[i]);
+      
+    if ((partialSse * sampleScale > m_survivalSseLimit) && (last + 1 < sampleCount)) {
+      boost::mutex::scoped_lock lock(m_calcMutex);
+      m_raceLostCount++;
+      m_raceSavedRunCount += (sampleCount - last - 1);
+      scCounter::inc("gp-race-saved-runs", sampleCount - last - 1);
+      runSampleCount = last + 1;
+      return false;
+    }  
+  }
   
-  runProgramForSamplesInRange(0, getSampleCount() - 1, 
-    fxVect, yVect, 
-    notNullCnt, totalCost, totalTypeDiff);
+  return true;
 }
 
-void sgpGpFitnessFun4Regression::calcOutputStats(const sgpFitDoubleVector &fxVect, const sgpFitDoubleVector &yVect, double &errorSse, double &errorSseAbs, double &errorSum, uint &hitCount, sgpFitDoubleVector &errors) const
+// Calculates all statistics of output in two passes over samples, without allocations:
+// 1) sums, 2) squared deviations from mean (stable for big values).
+// Standard deviations are sample deviations.
+void sgpGpFitnessFun4Regression::calcOutputStats(const sgpFitDoubleVector &fxVect, const sgpFitDoubleVector &yVect, 
+  sgpGpOutputStats &output) const
 {
-  double fx, y;
-  double sampleError, sampleErrorForSse;
+  uint sampleCount = fxVect.size();
+  double sse = 0.0, sseAbs = 0.0, errorSum = 0.0;
+  double sumFx = 0.0, sumY = 0.0, sumError = 0.0;
+  double varFx = 0.0, varY = 0.0, varError = 0.0, covYFx = 0.0;
+  uint hitCount = 0;
+  
+  output.errorSse = output.errorSseAbs = output.errorSum = 0.0;
+  output.fxStdDev = output.errorStdDev = output.correlYFx = 0.0;
+  output.hitCount = output.fxDistinctCnt = 0;
 
-  hitCount = 0;
-  errorSse = errorSseAbs = errorSum = 0;
+  if (sampleCount == 0)
+    return;
+    
+  const double *fx = &fxVect[0];
+  const double *y = &yVect[0];
+  double sampleError, dFx, dY, dError;
   
-  for(int i=0,epos = SAMPLE_COUNT; i != epos; i++)
+  for(uint i = 0; i != sampleCount; i++)
   {
-    fx = fxVect[i];
-    y = yVect[i];
-    
-    sampleError = (fx - y);
-    sampleErrorForSse = 1.0 + relativeErrorMinMax<double>(fx, y);
-    errorSse += (sampleErrorForSse * sampleErrorForSse);
-    errorSseAbs += (sampleError * sampleError);
+    sampleError = fx[i] - y[i];
+    sse += calcSampleErrorForSse(fx[i], y[i]);
+    sseAbs += sampleError * sampleError;
     errorSum += std::fabs(sampleError);
-    if (std::fabs(fx - y) < HIT_THRESHOLD * std::fabs(y))
-      hitCount++;
-    errors[i] = sampleError;
+    hitCount += (std::fabs(sampleError) < HIT_THRESHOLD * std::fabs(y[i])) ? 1 : 0;
+    sumFx += fx[i];
+    sumY += y[i];
+    sumError += sampleError;
   }  
+
+  double meanFx = sumFx / double(sampleCount);
+  double meanY = sumY / double(sampleCount);
+  double meanError = sumError / double(sampleCount);
+  
+  for(uint i = 0; i != sampleCount; i++)
+  {
+    dFx = fx[i] - meanFx;
+    dY = y[i] - meanY;
+    dError = (fx[i] - y[i]) - meanError;
+    varFx += dFx * dFx;
+    varY += dY * dY;
+    varError += dError * dError;
+    covYFx += dFx * dY;
+  }
+  
+  output.errorSse = sse;
+  output.errorSseAbs = sseAbs;
+  output.errorSum = errorSum;
+  output.hitCount = hitCount;
+  // sample standard deviation
+  if (sampleCount > 1) {
+    output.fxStdDev = sqrt(varFx / double(sampleCount - 1));
+    output.errorStdDev = sqrt(varError / double(sampleCount - 1));
+  }  
+  if ((varFx > 0.0) && (varY > 0.0))
+    output.correlYFx = covYFx / sqrt(varFx * varY);
+  output.fxDistinctCnt = countDistinctValues(fx, sampleCount, MIN_OUTPUT_DISTINCT_CNT);
 }
 
 // calculate how much output varies across samples
-void sgpGpFitnessFun4Regression::calcOutputVarRating(uint countNotNullOutput, uint fxDistinctCnt, double fxStdDev, double constToAllArgRatio, 
-  double regDistRead, double regDistWrite,
+void sgpGpFitnessFun4Regression::calcOutputVarRating(uint sampleCount, uint countNotNullOutput, uint fxDistinctCnt, double fxStdDev, 
+  double constToAllArgRatio, double regDistRead, double regDistWrite,
   double &variableOutputRating, bool &constOutput) const
 {
+  // small data sets cannot deliver MIN_OUTPUT_DISTINCT_CNT values
+  uint minDistinctCnt = std::min<uint>(MIN_OUTPUT_DISTINCT_CNT, sampleCount);
+
   constOutput = false;
-  variableOutputRating = double(1+countNotNullOutput) / double(SAMPLE_COUNT);;
+  variableOutputRating = double(1+countNotNullOutput) / double(sampleCount);
   
-  if ((fxDistinctCnt >= MIN_OUTPUT_DISTINCT_CNT) && !isnan(fxStdDev) && !isinf(fxStdDev)) {      
+  if ((fxDistinctCnt >= minDistinctCnt) && !isnan(fxStdDev) && !isinf(fxStdDev)) {      
     variableOutputRating += 2.0;    
   } else { // constant output 
     variableOutputRating += 1.0/constToAllArgRatio;
@@ -880,9 +1496,21 @@ void sgpGpFitnessFun4Regression::handleSamplesChanged()
 #endif        
   if (m_onSamplesChanged != SC_NULL)
     m_onSamplesChanged->execute(this);
+  adjustEvalCacheLimits();  
   prepareObjData();  
 }
 
+// keep memory used by caches of per-sample results constant for any number of samples
+void sgpGpFitnessFun4Regression::adjustEvalCacheLimits()
+{
+  uint sampleCount = std::max<uint>(getSampleCount(), 1);
+  
+  m_prgOutputCache.setLimit(
+    std::max<uint>(SGP_PRG_OUTPUT_CACHE_SAMPLE_BUDGET / sampleCount, 1));
+  m_checkpointCache.setLimit(
+    std::max<uint>(SGP_EVAL_CHECKPOINT_CACHE_SAMPLE_BUDGET / sampleCount, 1));
+}
+
 void sgpGpFitnessFun4Regression::prepareObjData()
 {  // empty here
 }
@@ -1038,7 +1666,7 @@ void sgpGpFitnessFun1I1O::generateInputValues()
 
 uint sgpGpFitnessFun1I1O::getSampleCount() const
 {
-  return SAMPLE_COUNT;
+  return m_inputValues.size();
 }  
 
 double sgpGpFitnessFun1I1O::calcStdErrorDeriveNForTargetFuncNI1O(const sgpFitDoubleVector &yVect, const sgpFitDoubleVector &fxVect, uint level) const
@@ -1058,11 +1686,14 @@ uint sgpGpFitnessFun1I1O::calcEntityClassForTargetFuncNI1O(const sgpFitDoubleVec
 
 void sgpGpFitnessFun1I1O::runProgramForSamplesInRange(
   uint first, uint last,
-  sgpFitDoubleVector &fxVect, sgpFitDoubleVector &yVect, 
+  sgpFitDoubleVector &fxVect, 
   uint &notNullCnt, long64 &totalCost, long64 &totalTypeDiff) const
 {  
-  double x, y, fx;
-  scDataNode input, output;
+  double x, fx;
+  scDataNode output, batchOutputs;
+  sgpBatchInputVector batchInputs;
+  sgpBatchCostVector batchCosts;
+  bool batchOk;
   uint typeDiff;
   const sgpFitDoubleVector &inputValues = m_inputValues; 
   
@@ -1070,20 +1701,30 @@ void sgpGpFitnessFun1I1O::runProgramForSamplesInRange(
   totalCost = 0;
   totalTypeDiff = 0;
     
-  sgpVMachine &vmachine = *const_cast<sgpVMachine *>(m_vmachine.get());
+  sgpVMachine &vmachine = getVMachine();
 
-  input.clear();
-  input.addChild(new scDataNode(float(0.0)));
+  // all samples executed at once
+  batchInputs.resize(last - first + 1);
+  for(uint i = first; i <= last; i++)
+    batchInputs[i - first] = inputValues[i];
+  // checkpoints are stored only for samples executed one by one
+  if (isCheckpointRunActive())
+    batchOk = false;
+  else  
+    batchOk = runProgramBatch(batchInputs, 1, batchOutputs, batchCosts, SGP_GASM_MAIN_BLOCK_INDEX);
 
   for(uint i = first; i <= last; i++)
   {
     x = inputValues[i];
-    y = calcTargetFunction(x); 
-    input.setFloat(0, x);
-    
-    runProgram(input, output, SGP_GASM_MAIN_BLOCK_INDEX);
+
+    if (batchOk) {
+      batchOutputs.getElement(i - first, output);
+      totalCost += batchCosts[i - first];
+    } else {  
+      runProgramNumeric(i, &x, 1, output, SGP_GASM_MAIN_BLOCK_INDEX);
+      totalCost += vmachine.getTotalCost();
+    }  
     
-    totalCost += vmachine.getTotalCost();
     typeDiff = sgpGasmScannerForFitUtils::calcTypeDiff(output.getValueType(), vt_float);
     totalTypeDiff += (typeDiff * typeDiff);
     
@@ -1093,7 +1734,6 @@ void sgpGpFitnessFun1I1O::runProgramForSamplesInRange(
       notNullCnt++;
     
     fxVect[i] = fx;
-    yVect[i] = y;
 
     output.clear();
   }
@@ -1101,7 +1741,7 @@ void sgpGpFitnessFun1I1O::runProgramForSamplesInRange(
 
 void sgpGpFitnessFun1I1O::prepareObjData()
 {
-  sgpFitDoubleVector yVect;
+  sgpFitDoubleVector &yVect = m_targetValues;
   sgpFitDoubleVector &xVect = m_inputValues;
   
   prepareTargetOutput(xVect, yVect);
@@ -1216,7 +1856,7 @@ void sgpGpFitnessFun2I1O::generateInputValues()
 
 uint sgpGpFitnessFun2I1O::getSampleCount() const
 {
-  return SAMPLE_COUNT;
+  return m_inputValuesX1.size();
 }  
 
 double sgpGpFitnessFun2I1O::calcStdErrorDeriveNForTargetFuncNI1O(const sgpFitDoubleVector &yVect, const sgpFitDoubleVector &fxVect, uint level) const
@@ -1237,35 +1877,31 @@ uint sgpGpFitnessFun2I1O::calcEntityClass(const sgpFitDoubleVector &input1, cons
 
 void sgpGpFitnessFun2I1O::runProgramForSamplesInRange(
   uint first, uint last,
-  sgpFitDoubleVector &fxVect, sgpFitDoubleVector &yVect,
+  sgpFitDoubleVector &fxVect, 
   uint &notNullCnt, long64 &totalCost, long64 &totalTypeDiff) const
 {  
-  double x1, x2, y, fx;
-  scDataNode input, output;
+  double x1, x2, fx;
+  double inputs[2];
+  scDataNode output;
   uint typeDiff;
   const sgpFitDoubleVector &inputValues1 = m_inputValuesX1; 
   const sgpFitDoubleVector &inputValues2 = m_inputValuesX2; 
   
-  sgpVMachine &vmachine = *const_cast<sgpVMachine *>(m_vmachine.get());
+  sgpVMachine &vmachine = getVMachine();
   notNullCnt = 0;
   totalCost = 0;
   totalTypeDiff = 0;
 
-  input.clear();
-  input.addChild(new scDataNode(float(0.0)));
-  input.addChild(new scDataNode(float(0.0)));
-  
   for(uint i = first; i <= last; i++)
   {
     // aproximate f(x) = (x^2)/2
     x1 = inputValues1[i];
     x2 = inputValues2[i];
-    y = calcTargetFunction(x1, x2); 
     
-    input.setFloat(0, x1);
-    input.setFloat(1, x2);
+    inputs[0] = x1;
+    inputs[1] = x2;
     
-    runProgram(input, output, SGP_GASM_MAIN_BLOCK_INDEX);
+    runProgramNumeric(i, inputs, 2, output, SGP_GASM_MAIN_BLOCK_INDEX);
 
     totalCost += vmachine.getTotalCost();
     typeDiff = sgpGasmScannerForFitUtils::calcTypeDiff(output.getValueType(), vt_float);
@@ -1302,7 +1938,6 @@ void sgpGpFitnessFun2I1O::runProgramForSamplesInRange(
 #endif      
     
     fxVect[i] = fx;
-    yVect[i] = y;
     output.clear();
   }
 }  
@@ -1324,7 +1959,7 @@ void sgpGpFitnessFun2I1O::fillObjectiveSet()
 
 void sgpGpFitnessFun2I1O::prepareObjData()
 {
-  sgpFitDoubleVector yVect;  
+  sgpFitDoubleVector &yVect = m_targetValues;  
   prepareTargetOutput(m_inputValuesX1, m_inputValuesX2, yVect);
 
   prepareObjExtremeCount(yVect, m_objCacheExtremeCount);
@@ -1346,3 +1981,420 @@ void sgpGpFitnessFun2I1O::prepareTargetOutput(const sgpFitDoubleVector &xVect1,
     yVect[i] = y;
   }
 }
+
+// ----------------------------------------------------------------------------
+// sgpFitDataSet
+// ----------------------------------------------------------------------------
+const char SGP_DATASET_FILE_MAGIC[] = "SGPDSET1";
+const uint SGP_DATASET_FILE_MAGIC_SIZE = 8;
+
+struct sgpFitDataSetFileHeader {
+  char magic[SGP_DATASET_FILE_MAGIC_SIZE];
+  uint columnCount;  ///<-- input columns + target column
+  uint reserved;     ///<-- keeps values aligned to 8 bytes
+  ulong64 rowCount;
+};
+
+/// memory-mapped data set file
+class sgpFitDataSetMapping {
+public:
+  boost::iostreams::mapped_file_source file;
+};
+
+sgpFitDataSet::sgpFitDataSet()
+{
+  m_values = SC_NULL;
+  m_columnCount = 0;
+  m_rowCount = 0;
+}
+
+sgpFitDataSet::~sgpFitDataSet()
+{
+  clear();
+}
+
+uint sgpFitDataSet::getInputCount() const
+{
+  return (m_columnCount > 0) ? (m_columnCount - 1) : 0;
+}
+
+uint sgpFitDataSet::getRowCount() const
+{
+  return m_rowCount;
+}
+
+bool sgpFitDataSet::empty() const
+{
+  return (m_rowCount == 0) || (m_columnCount < 2);
+}
+
+const double *sgpFitDataSet::getInputColumn(uint inputNo) const
+{
+  assert(inputNo < getInputCount());
+  return m_values + static_cast<ulong64>(inputNo) * m_rowCount;
+}
+
+const double *sgpFitDataSet::getTargetColumn() const
+{
+  assert(m_columnCount > 0);
+  return m_values + static_cast<ulong64>(m_columnCount - 1) * m_rowCount;
+}
+
+void sgpFitDataSet::clear()
+{
+  m_mapping.reset();
+  m_ownedValues.clear();  
+  m_values = SC_NULL;
+  m_columnCount = 0;
+  m_rowCount = 0;
+}
+
+void sgpFitDataSet::loadFromFile(const scString &fileName)
+{
+  sgpFitDataSetFileHeader header;
+  // file is closed on error by destructor
+  std::auto_ptr<sgpFitDataSetMapping> mapping(new sgpFitDataSetMapping());
+  
+  clear();
+  
+  try {
+    mapping->file.open(fileName);
+  }
+  catch(const std::exception& e) {
+    throw scError(scString("Data set file cannot be mapped: ")+fileName+", details: "+e.what());
+  }
+  
+  if (mapping->file.size() < sizeof(header))
+    throw scError(scString("Data set file too short: ")+fileName);
+    
+  memcpy(&header, mapping->file.data(), sizeof(header));
+  
+  if (memcmp(header.magic, SGP_DATASET_FILE_MAGIC, SGP_DATASET_FILE_MAGIC_SIZE) != 0)
+    throw scError(scString("Unknown data set file format: ")+fileName);
+    
+  // size is divided, not multiplied - header values can overflow
+  ulong64 valuesSize = mapping->file.size() - sizeof(header);
+  ulong64 valueCount = valuesSize / sizeof(double);
+  
+  if ((header.columnCount < 2) || (header.rowCount > std::numeric_limits<uint>::max()) ||
+      (valuesSize % sizeof(double) != 0) || 
+      (valueCount % header.columnCount != 0) || (valueCount / header.columnCount != header.rowCount)) 
+  {
+    throw scError(scString("Incorrect size of data set file: ")+fileName);
+  }
+  
+  m_values = reinterpret_cast<const double *>(mapping->file.data() + sizeof(header));
+  m_columnCount = header.columnCount;
+  m_rowCount = static_cast<uint>(header.rowCount);
+  m_mapping = mapping;
+}
+
+// import CSV file with numeric values only, last column is target
+void sgpFitDataSet::importFromCsv(const scString &fileName, bool hasHeader, char separator)
+{
+  std::ifstream input(fileName.c_str());
+  std::string line;
+  std::vector<double> rowValues;
+  uint lineNo = 0;
+  uint columnCount = 0;
+  uint rowCount = 0;
+  uint colNo;
+  const char *cursor;
+  char *valueEnd;
+
+  if (!input.is_open()) 
+    throw scError(scString("Data set file cannot be opened: ")+fileName);
+  
+  clear();
+
+  while(std::getline(input, line)) {
+    lineNo++;
+    if ((lineNo == 1) && hasHeader)
+      continue;
+    if (line.find_first_not_of(" \t\r") == std::string::npos)
+      continue;
+      
+    colNo = 0;  
+    cursor = line.c_str();
+    for(;;) {
+      // strtod skips leading white space, including separator of empty value
+      if (*cursor == separator)
+        throw scError(scString("Empty value in line ")+toString(lineNo)+" of data set file: "+fileName);
+      rowValues.push_back(strtod(cursor, &valueEnd));
+      if (valueEnd == cursor)
+        throw scError(scString("Non-numeric value in line ")+toString(lineNo)+" of data set file: "+fileName);
+      colNo++;
+      cursor = valueEnd;
+      // white space can be a separator (TSV)
+      while(((*cursor == ' ') || (*cursor == '\t') || (*cursor == '\r')) && (*cursor != separator))
+        cursor++;
+      if (*cursor != separator)
+        break;
+      cursor++;  
+    }
+    
+    if (*cursor != '\0')
+      throw scError(scString("Incorrect value in line ")+toString(lineNo)+" of data set file: "+fileName);
+    
+    if (columnCount == 0)
+      columnCount = colNo;
+    else if (colNo != columnCount)
+      throw scError(scString("Incorrect number of columns in line ")+toString(lineNo)+" of data set file: "+fileName);
+    rowCount++;  
+  }
+  
+  if (columnCount < 2)
+    throw scError(scString("Data set requires at least one input and target column: ")+fileName);
+  
+  // rows -> columns
+  m_ownedValues.resize(rowValues.size());
+  for(uint row = 0; row != rowCount; row++)
+    for(uint col = 0; col != columnCount; col++)
+      m_ownedValues[static_cast<ulong64>(col) * rowCount + row] = 
+        rowValues[static_cast<ulong64>(row) * columnCount + col];
+  
+  m_values = &m_ownedValues[0];
+  m_columnCount = columnCount;
+  m_rowCount = rowCount;
+}
+
+void sgpFitDataSet::saveToFile(const scString &fileName) const
+{
+  sgpFitDataSetFileHeader header;
+  std::ofstream output(fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  
+  if (!output.is_open()) 
+    throw scError(scString("Data set file cannot be created: ")+fileName);
+
+  memcpy(header.magic, SGP_DATASET_FILE_MAGIC, SGP_DATASET_FILE_MAGIC_SIZE);
+  header.columnCount = m_columnCount;
+  header.reserved = 0;
+  header.rowCount = m_rowCount;
+  
+  output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  if (m_values != SC_NULL)
+    output.write(reinterpret_cast<const char *>(m_values), 
+      static_cast<std::streamsize>(static_cast<ulong64>(m_rowCount) * m_columnCount * sizeof(double)));
+  
+  if (!output.good())
+    throw scError(scString("Data set file write failed: ")+fileName);
+}
+
+// ----------------------------------------------------------------------------
+// sgpGpFitnessFunDataset
+// ----------------------------------------------------------------------------
+uint sgpGpFitnessFunDataset::getInputCount()
+{
+  return getInputArgCount();
+}
+
+uint sgpGpFitnessFunDataset::getInputArgCount() const
+{
+  if (!m_dataSet)
+    return 0;
+  return m_dataSet->getInputCount();
+}
+
+void sgpGpFitnessFunDataset::setDataSet(const sgpFitDataSetTransporter &value)
+{
+  m_dataSet = value;
+  m_sampleRows.clear();
+  m_rowsByTarget.clear();
+  m_fitDataVersion++;
+  if (m_dataSet && !m_dataSet->empty())
+    handleSamplesChanged();
+}
+
+const sgpFitDataSet *sgpGpFitnessFunDataset::getDataSet() const
+{
+  return m_dataSet.get();
+}
+
+void sgpGpFitnessFunDataset::initInputValues()
+{ // samples are not copied - buffers for outputs are sized on evaluation
+}
+
+// samples are fixed, only verify them
+void sgpGpFitnessFunDataset::generateInputValues()
+{
+  if (!m_dataSet || m_dataSet->empty())
+    throw scError("Data set for fitness function not assigned");
+  handleSamplesChanged();
+}
+
+uint sgpGpFitnessFunDataset::getSampleCount() const
+{
+  if (!m_sampleRows.empty())
+    return m_sampleRows.size();
+  return getTotalSampleCount();
+}  
+
+uint sgpGpFitnessFunDataset::getTotalSampleCount() const
+{
+  if (!m_dataSet)
+    return 0;
+  return m_dataSet->getRowCount();
+}  
+
+bool sgpGpFitnessFunDataset::selectSampleRows(uint rowLimit, bool stratified)
+{
+  if (!m_dataSet || m_dataSet->empty())
+    return false;
+    
+  m_sampleRows.clear();
+  
+  if ((rowLimit > 0) && (rowLimit < m_dataSet->getRowCount())) {
+    if (stratified)
+      selectStratifiedRows(rowLimit, m_sampleRows);
+    else  
+      selectRandomRows(rowLimit, m_sampleRows);
+  }
+      
+  handleSamplesChanged();
+  return true;
+}
+
+// select <rowLimit> distinct rows (Floyd's algorithm), in increasing order
+void sgpGpFitnessFunDataset::selectRandomRows(uint rowLimit, sgpSampleRowList &output) const
+{
+  std::set<uint> rows;
+  uint rowCount = m_dataSet->getRowCount();
+  uint rowNo;
+  
+  for(uint j = rowCount - rowLimit; j != rowCount; j++) {
+    rowNo = randomUInt(0, j);
+    if (rows.find(rowNo) == rows.end())
+      rows.insert(rowNo);
+    else  
+      rows.insert(j);
+  }
+  
+  output.assign(rows.begin(), rows.end());
+}
+
+// select one row from each of <rowLimit> strata of target values, in increasing order
+void sgpGpFitnessFunDataset::selectStratifiedRows(uint rowLimit, sgpSampleRowList &output)
+{
+  uint rowCount = m_dataSet->getRowCount();
+  const double *target = m_dataSet->getTargetColumn();
+  ulong64 first, last;
+  
+  if (m_rowsByTarget.size() != rowCount) {
+    std::vector<std::pair<double, uint> > targetRows(rowCount);
+    for(uint i = 0; i != rowCount; i++)
+      targetRows[i] = std::make_pair(target[i], i);
+    std::sort(targetRows.begin(), targetRows.end());
+    m_rowsByTarget.resize(rowCount);
+    for(uint i = 0; i != rowCount; i++)
+      m_rowsByTarget[i] = targetRows[i].second;
+  }
+  
+  output.resize(rowLimit);
+  for(uint i = 0; i != rowLimit; i++) {
+    first = static_cast<ulong64>(i) * rowCount / rowLimit;
+    last = static_cast<ulong64>(i + 1) * rowCount / rowLimit - 1;
+    output[i] = m_rowsByTarget[randomUInt(static_cast<uint>(first), static_cast<uint>(last))];
+  }
+  
+  std::sort(output.begin(), output.end());
+}
+
+double sgpGpFitnessFunDataset::calcStdErrorDeriveNForTargetFuncNI1O(const sgpFitDoubleVector &yVect, const sgpFitDoubleVector &fxVect, uint level) const
+{ // rows are not ordered by inputs
+  return 0.0;
+}
+
+uint sgpGpFitnessFunDataset::calcEntityClassForTargetFuncNI1O(const sgpFitDoubleVector &fxVect, const sgpFitDoubleVector &yVect) const
+{
+  return 0;
+}
+
+void sgpGpFitnessFunDataset::fillObjectiveSet()
+{
+  m_objectiveSet.clear();
+  for(uint i=0, epos = getObjectiveCount(); i != epos; i++)
+    m_objectiveSet.push_back(true);
+
+  m_objectiveSet[FUN_REGR_OBJ_IDX_ERROR_StdDevDiffDfx] = false;
+  m_objectiveSet[FUN_REGR_OBJ_IDX_ERROR_StdDevDiffD2fx] = false;
+}
+
+void sgpGpFitnessFunDataset::prepareObjData()
+{
+  sgpFitDoubleVector &yVect = m_targetValues;
+  uint rowCount = getSampleCount();
+  const double *target = m_dataSet->getTargetColumn();
+  
+  yVect.resize(rowCount);
+  for(uint i = 0; i != rowCount; i++)
+    yVect[i] = target[getSampleRowNo(i)];
+
+  prepareObjExtremeCount(yVect, m_objCacheExtremeCount);
+  prepareObjFreqY(yVect, m_objCacheFreqY); 
+  prepareObjAmpliY(yVect, m_objCacheAmpliY); 
+}
+
+// rows are read directly from columns of data set, in batches of SGP_DATASET_BATCH_LANES rows
+void sgpGpFitnessFunDataset::runProgramForSamplesInRange(
+  uint first, uint last,
+  sgpFitDoubleVector &fxVect, 
+  uint &notNullCnt, long64 &totalCost, long64 &totalTypeDiff) const
+{  
+  scDataNode output, batchOutputs;
+  sgpBatchInputVector batchInputs;
+  sgpBatchCostVector batchCosts;
+  bool batchOk;
+  uint typeDiff, laneCount, chunkLast;
+  uint inputCount = m_dataSet->getInputCount();
+  std::vector<const double *> columns(inputCount);
+  std::vector<double> rowInputs(inputCount);
+  // checkpoints are stored only for samples executed one by one
+  bool batchEnabled = !isCheckpointRunActive();
+  
+  for(uint j = 0; j != inputCount; j++)
+    columns[j] = m_dataSet->getInputColumn(j);
+
+  notNullCnt = 0;
+  totalCost = 0;
+  totalTypeDiff = 0;
+    
+  sgpVMachine &vmachine = getVMachine();
+
+  for(uint chunkFirst = first; chunkFirst <= last; chunkFirst = chunkLast + 1)
+  {
+    chunkLast = std::min<uint>(last, chunkFirst + SGP_DATASET_BATCH_LANES - 1);
+    laneCount = chunkLast - chunkFirst + 1;
+    
+    batchOk = false;
+    if (batchEnabled) {
+      batchInputs.resize(laneCount * inputCount);
+      for(uint lane = 0; lane != laneCount; lane++)
+        for(uint j = 0; j != inputCount; j++)
+          batchInputs[lane * inputCount + j] = columns[j][getSampleRowNo(chunkFirst + lane)];
+      batchOk = runProgramBatch(batchInputs, inputCount, batchOutputs, batchCosts, SGP_GASM_MAIN_BLOCK_INDEX);
+    }  
+
+    for(uint i = chunkFirst; i <= chunkLast; i++)
+    {
+      if (batchOk) {
+        batchOutputs.getElement(i - chunkFirst, output);
+        totalCost += batchCosts[i - chunkFirst];
+      } else {  
+        for(uint j = 0; j != inputCount; j++)
+          rowInputs[j] = columns[j][getSampleRowNo(i)];
+        runProgramNumeric(i, &rowInputs[0], inputCount, output, SGP_GASM_MAIN_BLOCK_INDEX);
+        totalCost += vmachine.getTotalCost();
+      }  
+    
+      typeDiff = sgpGasmScannerForFitUtils::calcTypeDiff(output.getValueType(), vt_float);
+      totalTypeDiff += (typeDiff * typeDiff);
+    
+      if (!output.isNull()) 
+        notNullCnt++;
+    
+      fxVect[i] = readPrgOutputAsFloat(output, 0.0);
+
+      output.clear();
+    }
+  }  
+}  